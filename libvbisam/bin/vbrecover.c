@@ -18,19 +18,30 @@
  */
 
 #include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
 #include	"vbisam.h"
+#include	"isrecover.h"
 
 int
 main (int iargc, char **ppcargv)
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
-	int	iresult;
+	int	iresult, iarg = 1;
 
-	if (iargc != 2) {
-		printf ("Usage: %s <LOGFILE>\n", ppcargv [0]);
+	/* -j <WORKERS> replays the tables in parallel, see issetrecoverworkers () */
+	if (iargc == 4 && !strcmp (ppcargv[1], "-j")) {
+		if (issetrecoverworkers (atoi (ppcargv[2]))) {
+			printf ("Invalid number of workers: %s\n", ppcargv[2]);
+			return 1;
+		}
+		iarg = 3;
+	}
+	if (iargc != iarg + 1) {
+		printf ("Usage: %s [-j <WORKERS>] <LOGFILE>\n", ppcargv [0]);
 		return 1;
 	}
-	iresult = islogopen ((VB_CHAR*)ppcargv[1]);
+	iresult = islogopen ((VB_CHAR*)ppcargv[iarg]);
 	if (iresult < 0) {
 		fprintf (stdout, "Error opening log: %d\n", vb_rtd->iserrno);
 		return 1;
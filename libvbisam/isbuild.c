@@ -253,69 +253,577 @@ idelnodes (const int ihandle, const int ikeynumber, off_t trootnode)
     return iresult;
 }
 
+/*
+ * Bulk index build.  The key of every live row is extracted and sorted on
+ * its normalized form (see vvbkeynormalize ()) and then row number, so the
+ * duplicate numbers come out as they would from inserting the rows in row
+ * order.  Up to tsortmemory bytes of keys are sorted at a time and, should
+ * there be more, each sorted run is spilled to a temporary file and the runs
+ * are merged, VB_MERGEWAY at a time.  The nodes are then laid out bottom-up
+ * from the final merge, each filled to ifillfactor percent, and written as
+ * ivbnodesave () would have written them, the top one over the root node.
+ */
+
+/* Most sorted runs merged in one pass */
+#define VB_MERGEWAY 32
+
+/* Most levels a bulk built index can have */
+#define VB_LOADLEVELS   64
+
+/* Each sorted entry, followed by the normalized key and then the key itself */
+struct VBSORTROW {
+    off_t   trownumber;
+    int     ilength;    /* Length of the normalized key */
+};
+
+struct VBLOADLEVEL {
+    struct VBNODEPACK spack;
+    VB_CHAR     cnode[MAX_NODE_LENGTH];
+    VB_UCHAR    ckey[VB_MAX_KEYLEN];    /* The last entry, held back by iloadpush () */
+    off_t       tdupnumber;
+    off_t       trownode;
+    int         iisheld;
+    int         ikeys;      /* Entries packed into cnode */
+    off_t       tnodes;     /* Nodes written at this level */
+};
+
+struct VBLOAD {
+    int         ihandle;
+    struct keydesc  *pskeydesc;
+    size_t      trowsize;   /* Bytes per sorted entry */
+    int         ifilllimit; /* Node length at which a node is ended */
+    int         ifulllimit; /* Node length that may never be exceeded */
+    int         imaxkeylen; /* Most bytes any one entry takes up */
+    int         ilevels;
+    struct VBLOADLEVEL  *pslevel[VB_LOADLEVELS];
+    int         iiskey;     /* cprevnormal holds the previous key */
+    off_t       tdupnumber;
+    VB_UCHAR    cprevnormal[VB_MAX_KEYLEN];
+    VB_CHAR     *pcrows;    /* Entries gathered, not yet sorted */
+    size_t      trows;
+    FILE        *psspill;   /* The run pvloadsort () writes them to */
+    int         ierrno;     /* How pvloadsort () fared */
+    FILE        **ppsrun;   /* The spilled runs */
+    int         iruns;
+    int         irunsalloc;
+};
+
+static int
+isortcompare (const void *pvrow1, const void *pvrow2)
+{
+    const struct VBSORTROW *psrow1 = pvrow1, *psrow2 = pvrow2;
+    int     iresult;
+
+    iresult = memcmp (psrow1 + 1, psrow2 + 1, (size_t)psrow1->ilength);
+    if (iresult) {
+        return iresult;
+    }
+    if (psrow1->trownumber < psrow2->trownumber) {
+        return -1;
+    }
+    return psrow1->trownumber > psrow2->trownumber;
+}
+
+static int iloadflush (struct VBLOAD *psload, const int ilevel, const int iisroot);
+
+/*
+ * Add an entry to the node being built at ilevel.  The last entry of an
+ * index node is its high key, so each entry is held back until the next
+ * one shows whether it still fits in the node or ends it.
+ */
+static int
+iloadpush (struct VBLOAD *psload, const int ilevel, VB_UCHAR *pckey,
+           off_t tdupnumber, off_t trownode)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBLOADLEVEL  *pslevel;
+    int     ikeylen, ilimit;
+
+    if (ilevel == psload->ilevels) {
+        vb_rtd->iserrno = EBADFILE;
+        if (ilevel >= VB_LOADLEVELS) {
+            return -1;
+        }
+        pslevel = pvvbmalloc (sizeof (struct VBLOADLEVEL));
+        vb_rtd->iserrno = errno;
+        if (!pslevel) {
+            return -1;
+        }
+        vvbnodepackstart (psload->ihandle, &pslevel->spack, pslevel->cnode, ilevel);
+        psload->pslevel[ilevel] = pslevel;
+        psload->ilevels++;
+    }
+    pslevel = psload->pslevel[ilevel];
+    if (pslevel->iisheld) {
+        /* Room for the held entry and whatever follows it? */
+        ikeylen = ivbnodepacklength (psload->pskeydesc, &pslevel->spack,
+                                     pslevel->ckey, 0);
+        ilimit = pslevel->ikeys ? psload->ifilllimit : psload->ifulllimit;
+        if ((pslevel->spack.pcnodeptr - pslevel->spack.pcnode) + ikeylen
+            + psload->imaxkeylen <= ilimit) {
+            vvbnodepackkey (psload->pskeydesc, &pslevel->spack, pslevel->ckey,
+                            pslevel->tdupnumber, pslevel->trownode);
+            pslevel->ikeys++;
+        } else if (iloadflush (psload, ilevel, 0)) {
+            return -1;
+        }
+    }
+    memcpy (pslevel->ckey, pckey, (size_t)psload->pskeydesc->k_len);
+    pslevel->tdupnumber = tdupnumber;
+    pslevel->trownode = trownode;
+    pslevel->iisheld = 1;
+    return 0;
+}
+
+/*
+ * End the node being built at ilevel and write it out.  Unless it's the
+ * root, its last entry then goes up a level to point at it.
+ */
+static int
+iloadflush (struct VBLOAD *psload, const int ilevel, const int iisroot)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBLOADLEVEL  *pslevel;
+    off_t   tnodenumber;
+
+    pslevel = psload->pslevel[ilevel];
+    if (pslevel->iisheld) {
+        ivbnodepacklength (psload->pskeydesc, &pslevel->spack, pslevel->ckey, ilevel);
+        vvbnodepackkey (psload->pskeydesc, &pslevel->spack, pslevel->ckey,
+                        pslevel->tdupnumber, pslevel->trownode);
+        pslevel->ikeys++;
+    }
+    inl_stint ((int)(pslevel->spack.pcnodeptr - pslevel->spack.pcnode), pslevel->cnode);
+    if (iisroot) {
+        tnodenumber = psload->pskeydesc->k_rootnode;
+    } else {
+        tnodenumber = tvbnodeallocate (psload->ihandle);
+        if (tnodenumber == -1) {
+            return -1;
+        }
+    }
+    vb_rtd->iserrno = ivbblockwrite (psload->ihandle, 1, tnodenumber, pslevel->cnode);
+    if (vb_rtd->iserrno) {
+        return -1;
+    }
+    pslevel->tnodes++;
+    pslevel->iisheld = 0;
+    pslevel->ikeys = 0;
+    if (!iisroot && iloadpush (psload, ilevel + 1, pslevel->ckey,
+                               pslevel->tdupnumber, tnodenumber)) {
+        return -1;
+    }
+    vvbnodepackstart (psload->ihandle, &pslevel->spack, pslevel->cnode, ilevel);
+    return 0;
+}
+
+/*
+ * Write out what's left at each level, the first level that ends up with a
+ * single node being the root
+ */
+static int
+iloadfinish (struct VBLOAD *psload)
+{
+    int     ilevel;
+
+    for (ilevel = 0; ilevel < psload->ilevels; ilevel++) {
+        if (ilevel == psload->ilevels - 1 && !psload->pslevel[ilevel]->tnodes) {
+            return iloadflush (psload, ilevel, 1);
+        }
+        if (iloadflush (psload, ilevel, 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Number the next entry of the sorted stream and add it to the leaf level */
+static int
+iloadrow (struct VBLOAD *psload, struct VBSORTROW *psrow)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    VB_UCHAR    *pcnormal;
+
+    pcnormal = (VB_UCHAR *)(psrow + 1);
+    if (psload->iiskey && !memcmp (pcnormal, psload->cprevnormal, (size_t)psrow->ilength)) {
+        if (!(psload->pskeydesc->k_flags & ISDUPS)) {
+            vb_rtd->iserrno = EDUPL;
+            return -1;
+        }
+        psload->tdupnumber++;
+    } else {
+        memcpy (psload->cprevnormal, pcnormal, (size_t)psrow->ilength);
+        psload->iiskey = 1;
+        psload->tdupnumber = 0;
+    }
+    return iloadpush (psload, 0, pcnormal + psrow->ilength, psload->tdupnumber,
+                      psrow->trownumber);
+}
+
+/*
+ * Sort the entries gathered for one index and, if psspill is set, write
+ * them out to it as a new run.  This may run on a worker thread, so it
+ * leaves vb_rtd alone and reports any failure in ierrno.
+ */
+static void *
+pvloadsort (void *pvload)
+{
+    struct VBLOAD   *psload = pvload;
+
+    qsort (psload->pcrows, psload->trows, psload->trowsize, isortcompare);
+    if (psload->psspill
+        && (fwrite (psload->pcrows, psload->trowsize, psload->trows, psload->psspill)
+            != psload->trows || fflush (psload->psspill))) {
+        psload->ierrno = errno;
+    }
+    return NULL;
+}
+
+/*
+ * Sort what's been gathered for each of the inloads indexes, a thread apiece
+ * when there's more than one.  The entries of an index that has spilled
+ * before, or of every index if ispill is set, go out as a new run.
+ */
+static int
+iloadsort (struct VBLOAD *psloads, const int inloads, const int ispill)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBLOAD   *psload;
+    FILE    **ppsrun;
+    int     iloop;
+#if	HAVE_PTHREAD_CREATE
+    pthread_t   athread[MAXSUBS];
+    VB_CHAR     cstarted[MAXSUBS];
+#endif	/* HAVE_PTHREAD_CREATE */
+
+    for (iloop = 0; iloop < inloads; iloop++) {
+        psload = psloads + iloop;
+        psload->psspill = NULL;
+        psload->ierrno = 0;
+        if (!psload->trows || !(ispill || psload->iruns)) {
+            continue;
+        }
+        if (psload->iruns == psload->irunsalloc) {
+            ppsrun = pvvbmalloc (sizeof (FILE *) * (size_t)(psload->irunsalloc + VB_MERGEWAY));
+            vb_rtd->iserrno = errno;
+            if (!ppsrun) {
+                return -1;
+            }
+            if (psload->ppsrun) {
+                memcpy (ppsrun, psload->ppsrun, sizeof (FILE *) * (size_t)psload->iruns);
+                vvbfree (psload->ppsrun, sizeof (FILE *) * (size_t)psload->irunsalloc);
+            }
+            psload->ppsrun = ppsrun;
+            psload->irunsalloc += VB_MERGEWAY;
+        }
+        psload->psspill = tmpfile ();
+        if (!psload->psspill) {
+            vb_rtd->iserrno = errno;
+            return -1;
+        }
+        psload->ppsrun[psload->iruns++] = psload->psspill;
+    }
+    for (iloop = 0; iloop < inloads; iloop++) {
+        psload = psloads + iloop;
+#if	HAVE_PTHREAD_CREATE
+        /* The last one is sorted here while the others run */
+        cstarted[iloop] = psload->trows && iloop < inloads - 1
+            && !pthread_create (&athread[iloop], NULL, pvloadsort, psload);
+        if (cstarted[iloop]) {
+            continue;
+        }
+#endif	/* HAVE_PTHREAD_CREATE */
+        if (psload->trows) {
+            pvloadsort (psload);
+        }
+    }
+#if	HAVE_PTHREAD_CREATE
+    for (iloop = 0; iloop < inloads - 1; iloop++) {
+        if (cstarted[iloop]) {
+            pthread_join (athread[iloop], NULL);
+        }
+    }
+#endif	/* HAVE_PTHREAD_CREATE */
+    for (iloop = 0; iloop < inloads; iloop++) {
+        psload = psloads + iloop;
+        if (psload->ierrno) {
+            vb_rtd->iserrno = psload->ierrno;
+            return -1;
+        }
+        if (psload->psspill) {
+            rewind (psload->psspill);
+            psload->trows = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Merge the first iruns runs, into psout or, if that's NULL, into the index.
+ * The head entry of each run is kept in a heap, smallest on top.
+ */
 static int
-imakekeysfromdata (const int ihandle, const int ikeynumber)
+iloadmerge (struct VBLOAD *psload, int iruns, FILE *psout)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    VB_CHAR *pcheads;
+    int     *piheap, iheap, iparent, ichild, itemp, iresult = -1;
+    size_t  tsize;
+
+    tsize = (size_t)iruns * (psload->trowsize + sizeof (int));
+    pcheads = pvvbmalloc (tsize);
+    vb_rtd->iserrno = errno;
+    if (!pcheads) {
+        return -1;
+    }
+    piheap = (int *)(pcheads + (size_t)iruns * psload->trowsize);
+#define	HEAD(irun)	(pcheads + (size_t)(irun) * psload->trowsize)
+    iheap = 0;
+    for (ichild = 0; ichild < iruns; ichild++) {
+        if (fread (HEAD (ichild), psload->trowsize, 1, psload->ppsrun[ichild]) != 1) {
+            continue;
+        }
+        /* Sift the new head up */
+        for (itemp = iheap++; itemp; itemp = iparent) {
+            iparent = (itemp - 1) / 2;
+            if (isortcompare (HEAD (piheap[iparent]), HEAD (ichild)) <= 0) {
+                break;
+            }
+            piheap[itemp] = piheap[iparent];
+        }
+        piheap[itemp] = ichild;
+    }
+    while (iheap) {
+        if (psout) {
+            if (fwrite (HEAD (piheap[0]), psload->trowsize, 1, psout) != 1) {
+                vb_rtd->iserrno = errno;
+                goto mergeexit;
+            }
+        } else if (iloadrow (psload, (struct VBSORTROW *)HEAD (piheap[0]))) {
+            goto mergeexit;
+        }
+        itemp = piheap[0];
+        if (fread (HEAD (itemp), psload->trowsize, 1, psload->ppsrun[itemp]) != 1) {
+            itemp = piheap[--iheap];
+        }
+        /* Sift the replacement down from the top */
+        for (iparent = 0; (ichild = iparent * 2 + 1) < iheap; iparent = ichild) {
+            if (ichild + 1 < iheap
+                && isortcompare (HEAD (piheap[ichild + 1]), HEAD (piheap[ichild])) < 0) {
+                ichild++;
+            }
+            if (isortcompare (HEAD (itemp), HEAD (piheap[ichild])) <= 0) {
+                break;
+            }
+            piheap[iparent] = piheap[ichild];
+        }
+        if (iheap) {
+            piheap[iparent] = itemp;
+        }
+    }
+#undef	HEAD
+    iresult = 0;
+    if (psout && fflush (psout)) {
+        vb_rtd->iserrno = errno;
+        iresult = -1;
+    }
+mergeexit:
+    vvbfree (pcheads, tsize);
+    return iresult;
+}
+
+/* Global functions */
+
+/*
+ * Build the indexes from ifirstkey onwards out of the rows already in the
+ * table.  The data is read just the once, each row adding its key for every
+ * one of those indexes to that index's share of the sort memory.
+ */
+int
+ivbkeysfromdata (const int ihandle, const int ifirstkey)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbptr;
-    struct VBKEY    *pskey;
-    off_t           tdupnumber, tloop;
-    int             ideleted, iresult;
-    VB_UCHAR        ckeyvalue[VB_MAX_KEYLEN];
+    struct VBLOAD   *psloads, *psload;
+    struct VBSORTROW *psrow;
+    struct keydesc  *pskeydesc;
+    FILE            *psout;
+    off_t           tloop;
+    size_t          tmaxrows = 0, trow, tloadsize = 0;
+    int             ideleted, ikeynumber, iload, iloop, iheader, inloads = 0,
+                    iresult = -1, ierrno, ifillfactor;
+    VB_UCHAR        ckeyvalue[VB_MAX_KEYLEN], cnullchar;
 
     psvbptr = vb_rtd->psvbfile[ihandle];
-    /* Don't have to insert if the key is a NULL key! */
-    if ( psvbptr->pskeydesc[ikeynumber]->k_nparts == 0 ) {
+    if ( ifirstkey >= psvbptr->inkeys ) {
         return 0;
     }
+    psloads = pvvbmalloc (sizeof (struct VBLOAD) * (size_t)(psvbptr->inkeys - ifirstkey));
+    vb_rtd->iserrno = errno;
+    if ( !psloads ) {
+        return -1;
+    }
+    memset (psloads, 0, sizeof (struct VBLOAD) * (size_t)(psvbptr->inkeys - ifirstkey));
+#if	ISAMMODE == 1
+    iheader = INTSIZE + QUADSIZE;
+#else	/* ISAMMODE == 1 */
+    iheader = INTSIZE;
+#endif	/* ISAMMODE == 1 */
+    /* A fill factor that was never set would leave one key per node */
+    ifillfactor = vb_rtd->ifillfactor;
+    if ( ifillfactor < 1 ) {
+        ifillfactor = VB_FILLFACTOR;
+    }
+    for ( ikeynumber = ifirstkey; ikeynumber < psvbptr->inkeys; ikeynumber++ ) {
+        pskeydesc = psvbptr->pskeydesc[ikeynumber];
+        /* Don't have to insert if the key is a NULL key! */
+        if ( pskeydesc->k_nparts == 0 ) {
+            continue;
+        }
+        /* Whatever is held of the index is about to be written over */
+        vvbtreeallfree (ihandle, ikeynumber, psvbptr->pstree[ikeynumber]);
+        psvbptr->pstree[ikeynumber] = NULL;
+        psvbptr->pskeycurr[ikeynumber] = NULL;
+        psload = psloads + inloads++;
+        psload->ihandle = ihandle;
+        psload->pskeydesc = pskeydesc;
+        psload->trowsize = sizeof (struct VBSORTROW) + 2 * (size_t)pskeydesc->k_len;
+        psload->trowsize = (psload->trowsize + sizeof (off_t) - 1) & ~(sizeof (off_t) - 1);
+        /* ivbnodesave () splits a node once a key would reach inodesize - 3 */
+        psload->ifulllimit = psvbptr->inodesize - 4;
+        psload->ifilllimit = iheader
+            + (psload->ifulllimit - iheader) * ifillfactor / 100;
+        psload->imaxkeylen = pskeydesc->k_len + 2 * INTSIZE + 2 * QUADSIZE;
+        tloadsize += psload->trowsize;
+    }
+    if ( !inloads ) {
+        iresult = 0;
+        goto loadexit;
+    }
 
-    for ( tloop = 1; tloop < inl_ldquad (psvbptr->sdictnode.cdatacount); tloop++ ) {
-        /*
-         * Step 1:
-         *      Read in the existing data row (Just the min rowlength)
-         */
+    /* Every index gets an entry per row, so the buffers fill up together */
+    tmaxrows = (size_t)(vb_rtd->tsortmemory / (vbisam_off_t)tloadsize);
+    if ( tmaxrows < VB_MERGEWAY ) {
+        tmaxrows = VB_MERGEWAY;
+    }
+    for ( iload = 0; iload < inloads; iload++ ) {
+        psloads[iload].pcrows = pvvbmalloc (tmaxrows * psloads[iload].trowsize);
+        vb_rtd->iserrno = errno;
+        if ( !psloads[iload].pcrows ) {
+            goto loadexit;
+        }
+    }
+    /*
+     * Step 1:
+     *      Extract the keys, spilling sorted runs whenever a buffer fills
+     */
+    for ( tloop = 1; tloop <= inl_ldquad (psvbptr->sdictnode.cdatacount); tloop++ ) {
         vb_rtd->iserrno = ivbdataread (ihandle, (void *)psvbptr->ppcrowbuffer,
                                &ideleted, tloop);
         if ( vb_rtd->iserrno ) {
-            return -1;
+            goto loadexit;
         }
         if ( ideleted ) {
             continue;
         }
-        /*
-         * Step 2:
-         *      Check the index for a potential ISNODUPS error (EDUPL)
-         *      Also, calculate the duplicate number as needed
-         */
-        vvbmakekey (psvbptr->pskeydesc[ikeynumber], psvbptr->ppcrowbuffer, ckeyvalue);
-        iresult = ivbkeysearch (ihandle, ISGREAT, ikeynumber, 0, ckeyvalue, (off_t)0);
-        tdupnumber = 0;
-        if ( iresult >= 0 && !ivbkeyload (ihandle, ikeynumber, ISPREV, 0, &pskey)
-             && !memcmp (pskey->ckey, ckeyvalue,
-                         (size_t)psvbptr->pskeydesc[ikeynumber]->k_len) ) {
-            vb_rtd->iserrno = EDUPL;
-            if ( psvbptr->pskeydesc[ikeynumber]->k_flags & ISDUPS ) {
-                tdupnumber = pskey->tdupnumber + 1;
-            } else {
-                return -1;
+        for ( iload = 0; iload < inloads; iload++ ) {
+            psload = psloads + iload;
+            pskeydesc = psload->pskeydesc;
+            vvbmakekey (pskeydesc, psvbptr->ppcrowbuffer, ckeyvalue);
+            /* ivbkeyinsert () leaves out keys that are all NULL Character */
+            if ( pskeydesc->k_flags & NULLKEY ) {
+                cnullchar = (pskeydesc->k_type >> BYTESHFT) & BYTEMASK;
+                for ( iloop = 0; iloop < pskeydesc->k_len && ckeyvalue[iloop] == cnullchar;
+                      iloop++ ) ;
+                if ( iloop >= pskeydesc->k_len ) {
+                    continue;
+                }
+            }
+            if ( psload->trows == tmaxrows && iloadsort (psloads, inloads, 1) ) {
+                goto loadexit;
+            }
+            psrow = (struct VBSORTROW *)(psload->pcrows + psload->trows * psload->trowsize);
+            psrow->trownumber = tloop;
+            psrow->ilength = pskeydesc->k_len;
+            vvbkeynormalize (pskeydesc, psvbptr->collating_sequence, ckeyvalue,
+                             (VB_UCHAR *)(psrow + 1));
+            memcpy ((VB_UCHAR *)(psrow + 1) + pskeydesc->k_len, ckeyvalue,
+                    (size_t)pskeydesc->k_len);
+            psload->trows++;
+        }
+    }
+    /*
+     * Step 2:
+     *      Sort them and lay the nodes of each index out in key order
+     */
+    if ( iloadsort (psloads, inloads, 0) ) {
+        goto loadexit;
+    }
+    for ( iload = 0; iload < inloads; iload++ ) {
+        psload = psloads + iload;
+        if ( !psload->iruns ) {
+            for ( trow = 0; trow < psload->trows; trow++ ) {
+                if ( iloadrow (psload, (struct VBSORTROW *)(psload->pcrows
+                                                            + trow * psload->trowsize)) ) {
+                    goto loadexit;
+                }
+            }
+            continue;
+        }
+        while ( psload->iruns > VB_MERGEWAY ) {
+            psout = tmpfile ();
+            if ( !psout ) {
+                vb_rtd->iserrno = errno;
+                goto loadexit;
+            }
+            if ( iloadmerge (psload, VB_MERGEWAY, psout) ) {
+                fclose (psout);
+                goto loadexit;
             }
+            rewind (psout);
+            for ( iloop = 0; iloop < VB_MERGEWAY; iloop++ ) {
+                fclose (psload->ppsrun[iloop]);
+            }
+            psload->iruns -= VB_MERGEWAY;
+            memmove (psload->ppsrun, psload->ppsrun + VB_MERGEWAY,
+                     sizeof (FILE *) * (size_t)psload->iruns);
+            psload->ppsrun[psload->iruns++] = psout;
+        }
+        if ( iloadmerge (psload, psload->iruns, NULL) ) {
+            goto loadexit;
         }
+    }
+    iresult = 0;
 
-        /*
-         * Step 3:
-         * Perform the actual insertion into the index
-         */
-        iresult = ivbkeyinsert (ihandle, NULL, ikeynumber, ckeyvalue, tloop,
-                                tdupnumber, NULL);
-        if ( iresult ) {
-            return iresult;
+loadexit:
+    /* Even after a failure, the nodes written must hang off the roots */
+    ierrno = vb_rtd->iserrno;
+    for ( iload = 0; iload < inloads; iload++ ) {
+        psload = psloads + iload;
+        if ( iloadfinish (psload) && !iresult ) {
+            iresult = -1;
+            ierrno = vb_rtd->iserrno;
+        }
+        for ( iloop = 0; iloop < psload->ilevels; iloop++ ) {
+            vvbfree (psload->pslevel[iloop], sizeof (struct VBLOADLEVEL));
+        }
+        for ( iloop = 0; iloop < psload->iruns; iloop++ ) {
+            fclose (psload->ppsrun[iloop]);
+        }
+        if ( psload->ppsrun ) {
+            vvbfree (psload->ppsrun, sizeof (FILE *) * (size_t)psload->irunsalloc);
+        }
+        if ( psload->pcrows ) {
+            vvbfree (psload->pcrows, tmaxrows * psload->trowsize);
         }
     }
-    return 0;
+    vvbfree (psloads, sizeof (struct VBLOAD) * (size_t)(psvbptr->inkeys - ifirstkey));
+    if ( iresult ) {
+        vb_rtd->iserrno = ierrno;
+    }
+    return iresult;
 }
 
-/* Global functions */
-
 int
 isbuild (const VB_CHAR *pcfilename, int imaxrowlength, struct keydesc *pskey, int imode)
 {
@@ -396,6 +904,7 @@ isbuild (const VB_CHAR *pcfilename, int imaxrowlength, struct keydesc *pskey, in
         goto build_err;
     }
     memcpy (tvbptr->pskeydesc[0], pskey, sizeof (struct keydesc));
+    vvbkeycompareset (ihandle, 0);
     if ( ivbcheckkey (ihandle, pskey, 0, iminrowlength, 1) ) {
         return -1;
     }
@@ -630,7 +1139,8 @@ isaddindex (int ihandle, struct keydesc *pskeydesc)
         goto addindexexit;
     }
     memcpy (psvbptr->pskeydesc[ikeynumber], pskeydesc, sizeof (struct keydesc));
-    if ( imakekeysfromdata (ihandle, ikeynumber) ) {
+    vvbkeycompareset (ihandle, ikeynumber);
+    if ( ivbkeysfromdata (ihandle, ikeynumber) ) {
 /* BUG - Handle this better! */
         iresult = vb_rtd->iserrno;
         ivbexit (ihandle);
@@ -682,18 +1192,22 @@ isdelindex (int ihandle, struct keydesc *pskeydesc)
     if ( idelnodes (ihandle, ikeynumber, trootnode) ) {
         goto delindexexit;
     }
-    vvbfree (psvbfptr->pskeydesc[ikeynumber], sizeof (struct keydesc));
     vvbtreeallfree (ihandle, ikeynumber, psvbfptr->pstree[ikeynumber]);
     vvbkeyunmalloc (ihandle, ikeynumber);
-    for ( iloop = ikeynumber; iloop < MAXSUBS; iloop++ ) {
+    vvbfree (psvbfptr->pskeydesc[ikeynumber], sizeof (struct keydesc));
+    for ( iloop = ikeynumber; iloop < MAXSUBS - 1; iloop++ ) {
         psvbfptr->pskeydesc[iloop] = psvbfptr->pskeydesc[iloop + 1];
         psvbfptr->pstree[iloop] = psvbfptr->pstree[iloop + 1];
         psvbfptr->pskeyfree[iloop] = psvbfptr->pskeyfree[iloop + 1];
+        psvbfptr->skeyslab[iloop] = psvbfptr->skeyslab[iloop + 1];
+        psvbfptr->pfkeycompare[iloop] = psvbfptr->pfkeycompare[iloop + 1];
         psvbfptr->pskeycurr[iloop] = psvbfptr->pskeycurr[iloop + 1];
     }
     psvbfptr->pskeydesc[MAXSUBS - 1] = NULL;
     psvbfptr->pstree[MAXSUBS - 1] = NULL;
     psvbfptr->pskeyfree[MAXSUBS - 1] = NULL;
+    memset (&psvbfptr->skeyslab[MAXSUBS - 1], 0, sizeof (struct VBSLABPOOL));
+    psvbfptr->pfkeycompare[MAXSUBS - 1] = NULL;
     psvbfptr->pskeycurr[MAXSUBS - 1] = NULL;
     psvbfptr->inkeys--;
     inl_stint (psvbfptr->inkeys, psvbfptr->sdictnode.cindexcount);
@@ -707,8 +707,7 @@ vaddkeyforrow (int ihandle, int ikey, off_t trownumber)
     iresult = ivbkeysearch (ihandle, ISGREAT, ikey, 0, ckeyvalue, 0);
     tdupnumber = 0;
     if ( iresult >= 0 && !ivbkeyload (ihandle, ikey, ISPREV, 0, &psKey)
-         && !memcmp (psKey->ckey, ckeyvalue,
-                     psvbptr->pskeydesc[ikey]->k_len) ) {
+         && !ivbkeycompare (ihandle, ikey, 0, psKey->ckey, ckeyvalue) ) {
         vb_rtd->iserrno = EDUPL;
         if ( psvbptr->pskeydesc[ikey]->k_flags & ISDUPS ) {
             tdupnumber = psKey->tdupnumber + 1;
@@ -768,6 +767,7 @@ localaddindex (int ihandle, struct keydesc *pskeydesc, int ikey)
         goto addindexexit;
     }
     memcpy (psvbptr->pskeydesc[ikeynumber], pskeydesc, sizeof (struct keydesc));
+    vvbkeycompareset (ihandle, ikeynumber);
     vb_rtd->iserrno = 0;
     iresult = ivbtranscreateindex (ihandle, pskeydesc);
 
@@ -781,19 +781,98 @@ localaddindex (int ihandle, struct keydesc *pskeydesc, int ikey)
 #endif /* not used */
 
 
-static void
-vrebuildkeys (int ihandle)
+/*
+ * Create the empty table the live rows get copied into, with all of the
+ * indexes of the one being checked
+ */
+static int
+irebuildcreate (int ihandle, char *name)
 {
-    off_t           trownumber;
-    int             ideleted, ikey;
     vb_rtd_t        *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbptr;
-    int             iNewhandel;
+    int             iNewhandel, ikey;
+
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    iserase((VB_CHAR *)name);
+    vb_rtd->isreclen = psvbptr->iminrowlength;
+    iNewhandel = isbuild((VB_CHAR *)name, (size_t)psvbptr->imaxrowlength, psvbptr->pskeydesc[0], 
+                         ISINOUT | ISEXCLLOCK | (psvbptr->iminrowlength != psvbptr->imaxrowlength ? ISVARLEN : 0));
+    for ( ikey = 1; ikey < MAXSUBS; ikey++ ) {
+        if ( psvbptr->pskeydesc[ikey] ) {
+            vb_rtd->iserrno = 0;
+            isaddindex(iNewhandel,psvbptr->pskeydesc[ikey]);
+        }
+    } 
+    return iNewhandel;
+}
+
+/*
+ * Write the row in gpsdatarow to the new table.  With idataonly set only
+ * the data row is written and the indexes are left to ivbkeysfromdata (),
+ * otherwise it's a plain iswrite () so that a row duplicating a unique key
+ * is just reported and left out instead of failing the lot
+ */
+static int
+irebuildrow (int iNewhandel, int idataonly)
+{
+    vb_rtd_t        *vb_rtd =VB_GET_RTD;
+    off_t           tnewrow;
     int             ires;
-    char            name[256];
+
+    if ( !idataonly ) {
+        return iswrite (iNewhandel, gpsdatarow) < 0 ? -1 : 0;
+    }
+    tnewrow = tvbdataallocate (iNewhandel);
+    if ( tnewrow == -1 ) {
+        return -1;
+    }
+    vb_rtd->psvbfile[iNewhandel]->tvarlennode = 0;
+    ires = ivbdatawrite (iNewhandel, gpsdatarow, 0, tnewrow);
+    if ( ires ) {
+        vb_rtd->iserrno = ires;
+        ivbdatafree (iNewhandel, tnewrow);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Copy the *LIVE* data rows over to the new table, see irebuildrow ()
+ */
+static void
+vrebuildrows (int ihandle, int iNewhandel, int idataonly)
+{
+    off_t           trownumber;
+    int             ideleted;
+    vb_rtd_t        *vb_rtd =VB_GET_RTD;
     int             irowcnt = 0;
 
-    psvbptr = vb_rtd->psvbfile[ihandle];
+    for ( trownumber = 1; trownumber <= gtdatasize; trownumber++ ) {
+        if ( ivbdataread (ihandle, gpsdatarow, &ideleted, trownumber) ) {
+            printf ("Error %d reading data row %ld!\n", vb_rtd->iserrno,(long)trownumber);
+            continue;   /*  A data file read error! Leave it as free! */
+        }
+        if ( !ideleted ) {
+            if ( irebuildrow (iNewhandel, idataonly) ) {
+                printf ("Error %d writing data row %ld!\n", vb_rtd->iserrno,(long)trownumber);
+            } else {
+                irowcnt++;
+            }
+        }
+        if ( (trownumber % 1000) == 0 ) {
+            printf ("Current row : %ld\r", (long)trownumber);
+        }
+    }
+    printf ("  Total read row  : %ld    \n", (long)gtdatasize);
+    printf ("  Total added row : %d    \n", irowcnt);
+}
+
+static void
+vrebuildkeys (int ihandle)
+{
+    vb_rtd_t        *vb_rtd =VB_GET_RTD;
+    int             iNewhandel;
+    char            name[256];
 
     /*
     memset (skeydesc, 0, sizeof(skeydesc));
@@ -815,6 +894,7 @@ vrebuildkeys (int ihandle)
         psvbptr->pstree[ikey] = NULL;
         psvbptr->pskeyfree[ikey] = NULL;
         psvbptr->pskeycurr[ikey] = NULL;
+        psvbptr->pfkeycompare[ikey] = NULL;
     }
     psvbptr->inkeys = 0;
     if ( skeydesc[0]->k_nparts ) {
@@ -830,44 +910,36 @@ vrebuildkeys (int ihandle)
     } 
     */
     sprintf (name, "VBISAM_REBUILD_%d", getpid());
-    iserase((VB_CHAR *)name);
-    vb_rtd->isreclen = psvbptr->iminrowlength;
-    iNewhandel = isbuild((VB_CHAR *)name, (size_t)psvbptr->imaxrowlength, psvbptr->pskeydesc[0], 
-                         ISINOUT | ISEXCLLOCK | (psvbptr->iminrowlength != psvbptr->imaxrowlength ? ISVARLEN : 0));
-    for ( ikey = 1; ikey < MAXSUBS; ikey++ ) {
-        if ( psvbptr->pskeydesc[ikey] ) {
-            vb_rtd->iserrno = 0;
-            isaddindex(iNewhandel,psvbptr->pskeydesc[ikey]);
-        }
-    } 
+    iNewhandel = irebuildcreate (ihandle, name);
     printf("Creating new DB : %s\n", name);
+    if ( iNewhandel < 0 || ivbenter (iNewhandel, 1) ) {
+        printf ("Error %d creating %s!\n", vb_rtd->iserrno, name);
+        return;
+    }
 
-    /*  Mark the entries used by *LIVE* data rows */
-    for ( trownumber = 1; trownumber <= gtdatasize; trownumber++ ) {
-        if ( ivbdataread (ihandle, gpsdatarow, &ideleted, trownumber) ) {
-            printf ("Error %d reading data row %ld!\n", vb_rtd->iserrno,(long)trownumber);
-            continue;   /*  A data file read error! Leave it as free! */
-        }
-        if ( !ideleted ) {
-            irowcnt++;
-            ires = iswrite(iNewhandel, gpsdatarow);
-            if ( ires < 0 ) {
-                printf ("Error %d writing data row %ld!\n", vb_rtd->iserrno,(long)trownumber);
-                /*
-                    for ( ikey = 0; ikey < MAXSUBS; ikey++ ) {
-                    if ( psvbptr->pskeydesc[ikey] ) {
-                        vaddkeyforrow (ihandle, ikey, trownumber);
-                    }
-                    } 
-                */ 
+    /*
+     * Copy the *LIVE* data rows over as they are and then build all of
+     * the indexes together from the one pass through the new data
+     */
+    vrebuildrows (ihandle, iNewhandel, 1);
+    if ( ivbkeysfromdata (iNewhandel, 0) ) {
+        printf ("Error %d building the indexes!\n", vb_rtd->iserrno);
+        if ( vb_rtd->iserrno == EDUPL ) {
+            /*  Start again a row at a time, leaving out the duplicates */
+            ivbexit (iNewhandel);
+            isclose(iNewhandel);
+            printf ("Adding the rows one at a time instead\n");
+            iNewhandel = irebuildcreate (ihandle, name);
+            if ( iNewhandel < 0 ) {
+                printf ("Error %d creating %s!\n", vb_rtd->iserrno, name);
+                return;
             }
-        }
-        if ( (trownumber % 10) == 0 ) {
-            printf ("Current row : %ld\r", (long)trownumber);
+            vrebuildrows (ihandle, iNewhandel, 0);
+            isclose(iNewhandel);
+            return;
         }
     }
-    printf ("  Total read row  : %ld    \n", (long)gtdatasize);
-    printf ("  Total added row : %d    \n", irowcnt);
+    ivbexit (iNewhandel);
     isclose(iNewhandel);
     return;
 }
@@ -906,6 +978,8 @@ ipostamble (int ihandle){
         printf ("\n");
     }
     inl_stquad (gtlastuseddata, vb_rtd->psvbfile[ihandle]->sdictnode.cdatacount);
+    /*  Have the live row count recounted from the checked free list */
+    vb_rtd->psvbfile[ihandle]->sdictnode.crowcountok = 0;
     /*  Other stuff here */
     vvbfree (gpsdatarow, vb_rtd->psvbfile[ihandle]->imaxrowlength);
     vvbfree (cvbnodetmp, MAX_NODE_LENGTH);
@@ -29,6 +29,7 @@ irowdelete (const int ihandle, off_t trownumber)
     int             ikeynumber, iresult;
     struct DICTINFO *psvbfptr;
     off_t           tdupnumber[MAXSUBS];
+    VB_UCHAR        cpresent[MAXSUBS];
 
     psvbfptr = vb_rtd->psvbfile[ihandle];
     /*
@@ -40,6 +41,7 @@ irowdelete (const int ihandle, off_t trownumber)
             continue;
         }
         iresult = ivbkeylocaterow (ihandle, ikeynumber, trownumber);
+        cpresent[ikeynumber] = !iresult;
 		if (iresult		/* May not be present if key was SUPPRESSED */
 		&& psvbfptr->pskeydesc[ikeynumber]->k_flags & NULLKEY)
 			continue;
@@ -55,7 +57,8 @@ irowdelete (const int ihandle, off_t trownumber)
      *      Perform the actual deletion from each index
      */
     for (ikeynumber = 0; ikeynumber < psvbfptr->inkeys; ikeynumber++) {
-        if (psvbfptr->pskeydesc[ikeynumber]->k_nparts == 0) {
+        if (psvbfptr->pskeydesc[ikeynumber]->k_nparts == 0
+            || !cpresent[ikeynumber]) {
             continue;
         }
         iresult = ivbkeydelete (ihandle, ikeynumber);
@@ -17,22 +17,483 @@
  * Suite 330, Boston, MA 02111-1307 USA
  */
 
+#define NEED_VBINLINE_INT_LOAD 1
 #define NEED_VBINLINE_QUAD_LOAD 1
 #define NEED_VBINLINE_QUAD_STORE 1
 #include	"isinternal.h"
 
+/* Local functions */
+
+/*
+ * Add the node tnodenumber and everything below it to psinfo.  iprevlvl
+ * is the level of the node that pointed at it, as for ivbnodeload ().
+ */
+static int
+iindexfillnode (const int ihandle, const int ikeynumber, off_t tnodenumber,
+		int iprevlvl, struct indexfillinfo *psinfo)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+	struct VBTREE	stree;
+	int		iheader, iloop, iresult;
+	VB_CHAR		cvbnodetmp[MAX_NODE_LENGTH];
+
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	iresult = ivbblockread (ihandle, 1, tnodenumber, cvbnodetmp);
+	if (iresult) {
+		return iresult;
+	}
+#if	ISAMMODE == 1
+	iheader = INTSIZE + QUADSIZE;
+#else	/* ISAMMODE == 1 */
+	iheader = INTSIZE;
+#endif	/* ISAMMODE == 1 */
+	psinfo->fi_nodes++;
+	psinfo->fi_bytes += inl_ldint (cvbnodetmp) - iheader;
+	/* ivbnodesave () splits a node once a key would reach inodesize - 3 */
+	psinfo->fi_capacity += psvbptr->inodesize - 4 - iheader;
+	if (cvbnodetmp[psvbptr->inodesize - 2] == 0) {
+		psinfo->fi_leaves++;
+		return 0;
+	}
+	memset (&stree, 0, sizeof (stree));
+	stree.ttransnumber = -1;
+	iresult = ivbnodeload (ihandle, ikeynumber, &stree, tnodenumber, iprevlvl);
+	for (iloop = 0; !iresult && iloop < (int)stree.ikeysinnode; iloop++) {
+		if (!stree.pskeylist[iloop]->iisdummy) {
+			iresult = iindexfillnode (ihandle, ikeynumber,
+						 stree.pskeylist[iloop]->trownode,
+						 stree.ilevel, psinfo);
+		}
+	}
+	vvbkeyallfree (ihandle, ikeynumber, &stree);
+	return iresult;
+}
+
+/*
+ * Copy row trownumber of ihandle onto the end of the table inewhandle unless
+ * pcseen says it has been copied already.  Deleted rows are left behind.
+ */
+static int
+iclustercopy (const int ihandle, const int inewhandle, off_t trownumber,
+	      VB_UCHAR *pcseen, off_t tdatacount, off_t *ptcopied)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	VB_CHAR	*pcrow;
+	off_t	tnewrow;
+	int	ideleted, iresult;
+
+	if (trownumber < 1 || trownumber > tdatacount) {
+		return EBADFILE;
+	}
+	if (pcseen[(trownumber - 1) >> 3] & (1 << ((trownumber - 1) & 7))) {
+		return 0;
+	}
+	pcseen[(trownumber - 1) >> 3] |= 1 << ((trownumber - 1) & 7);
+	pcrow = vb_rtd->psvbfile[inewhandle]->ppcrowbuffer;
+	iresult = ivbdataread (ihandle, pcrow, &ideleted, trownumber);
+	if (iresult || ideleted) {
+		return iresult;
+	}
+	tnewrow = tvbdataallocate (inewhandle);
+	if (tnewrow == -1) {
+		return vb_rtd->iserrno;
+	}
+	vb_rtd->psvbfile[inewhandle]->tvarlennode = 0;
+	iresult = ivbdatawrite (inewhandle, pcrow, 0, tnewrow);
+	if (iresult) {
+		ivbdatafree (inewhandle, tnewrow);
+		return iresult;
+	}
+	(*ptcopied)++;
+	return 0;
+}
+
+/*
+ * Remove the copy pcnewname, .dat first.  A .dat without its .idx is half
+ * swapped in and is left for ivbclusterfinish ().
+ */
+static void
+vclusterremove (const VB_CHAR *pcnewname)
+{
+	struct stat	sstat;
+	VB_CHAR		cname[MAX_PATH_LENGTH + 5];
+
+	sprintf ((char *)cname, "%s.idx", pcnewname);
+	if (stat ((char *)cname, &sstat)) {
+		return;
+	}
+	sprintf ((char *)cname, "%s.dat", pcnewname);
+	unlink ((char *)cname);
+	sprintf ((char *)cname, "%s.idx", pcnewname);
+	unlink ((char *)cname);
+}
+
+/*
+ * Build pcnewname as a copy of ihandle with the rows in the order of index
+ * ikeynumber (row number order if -1) and every index built from scratch.
+ * The roots of the new indexes are returned in troot.
+ */
+static int
+iclusterbuild (const int ihandle, const int ikeynumber, VB_CHAR *pcnewname,
+	       off_t *troot)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr, *psnewptr;
+	struct VBKEY	*pskey;
+	struct stat	sstat;
+	VB_UCHAR	*pcseen;
+	off_t		tcopied = 0, tcount, tdatacount, tloop, tstamp;
+	size_t		tseensize;
+	int		ierror = 0, ikey, inewhandle, iresult;
+	VB_UCHAR	ckeyvalue[VB_MAX_KEYLEN];
+	VB_CHAR		cname[MAX_PATH_LENGTH + 5];
+	VB_CHAR		cvbnodetmp[MAX_NODE_LENGTH];
+
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	tdatacount = inl_ldquad (psvbptr->sdictnode.cdatacount);
+	tseensize = (size_t)(tdatacount / 8 + 1);
+	pcseen = pvvbmalloc (tseensize);
+	if (!pcseen) {
+		return EBADMEM;
+	}
+	memset (pcseen, 0, tseensize);
+
+	/* The copy is never logged: isrecover () replays the iscluster () */
+	vb_rtd->isreclen = psvbptr->iminrowlength;
+	inewhandle = isbuild (pcnewname, psvbptr->imaxrowlength, psvbptr->pskeydesc[0],
+			      ISINOUT | ISEXCLLOCK | ISNOLOG
+			      | (psvbptr->iminrowlength != psvbptr->imaxrowlength ? ISVARLEN : 0));
+	if (inewhandle < 0) {
+		vvbfree (pcseen, tseensize);
+		return vb_rtd->iserrno;
+	}
+	psnewptr = vb_rtd->psvbfile[inewhandle];
+	for (ikey = 1; !ierror && ikey < psvbptr->inkeys; ikey++) {
+		if (isaddindex (inewhandle, psvbptr->pskeydesc[ikey])) {
+			ierror = vb_rtd->iserrno;
+		}
+	}
+	if (!ierror && psvbptr->collating_sequence
+	    && issetcollate (inewhandle, psvbptr->collating_sequence)) {
+		ierror = vb_rtd->iserrno;
+	}
+	if (!ierror && ivbenter (inewhandle, 1)) {
+		ierror = vb_rtd->iserrno;
+	}
+	if (ierror) {
+		goto buildexit;
+	}
+
+	/* Firstly, the rows in index order (duplicates by duplicate number) */
+	if (ikeynumber >= 0) {
+		iresult = ivbkeysearch (ihandle, ISFIRST, ikeynumber, 0, ckeyvalue, (off_t)0);
+		if (iresult < 0) {
+			ierror = vb_rtd->iserrno ? vb_rtd->iserrno : EBADFILE;
+		} else if (iresult == 2 || psvbptr->pskeycurr[ikeynumber]->iisdummy) {
+			iresult = EENDFILE;
+		} else {
+			iresult = 0;
+		}
+		while (!ierror && !iresult) {
+			ierror = iclustercopy (ihandle, inewhandle,
+					       psvbptr->pskeycurr[ikeynumber]->trownode,
+					       pcseen, tdatacount, &tcopied);
+			if (!ierror) {
+				iresult = ivbkeyload (ihandle, ikeynumber, ISNEXT, 1, &pskey);
+			}
+			vvbtreetrim ();
+		}
+		if (!ierror && iresult != EENDFILE) {
+			ierror = iresult;
+		}
+	}
+	/* Then any rows the index left out (NULLKEY) in row number order */
+	tcount = tvbrowcount (ihandle);
+	for (tloop = 1; !ierror && tcopied != tcount && tloop <= tdatacount; tloop++) {
+		ierror = iclustercopy (ihandle, inewhandle, tloop, pcseen, tdatacount, &tcopied);
+	}
+	if (!ierror && ivbkeysfromdata (inewhandle, 0)) {
+		ierror = vb_rtd->iserrno;
+	}
+	ivbexit (inewhandle);
+	if (ierror) {
+		goto buildexit;
+	}
+
+	/* The table carries on from where the old one left off */
+	memcpy (psnewptr->sdictnode.cuniqueid, psvbptr->sdictnode.cuniqueid, QUADSIZE);
+	tstamp = inl_ldquad (psvbptr->sdictnode.ctransnumber);
+	if (tstamp < inl_ldquad (psnewptr->sdictnode.ctransnumber)) {
+		tstamp = inl_ldquad (psnewptr->sdictnode.ctransnumber);
+	}
+	inl_stquad (tstamp + 1, psnewptr->sdictnode.ctransnumber);
+	memset (cvbnodetmp, 0, MAX_NODE_LENGTH);
+	memcpy (cvbnodetmp, &psnewptr->sdictnode, sizeof (struct DICTNODE));
+	ierror = ivbblockwrite (inewhandle, 1, (off_t)1, cvbnodetmp);
+	psnewptr->iisdictlocked &= ~0x02;
+	for (ikey = 0; ikey < psnewptr->inkeys; ikey++) {
+		troot[ikey] = psnewptr->pskeydesc[ikey]->k_rootnode;
+	}
+	/* The new files are to survive a crash once they've been renamed */
+	if (!ierror && (fsync (vb_rtd->svbfile[psnewptr->iindexhandle].ihandle)
+			|| fsync (vb_rtd->svbfile[psnewptr->idatahandle].ihandle))) {
+		ierror = errno;
+	}
+	sprintf ((char *)cname, "%s.dat", psvbptr->cfilename);
+	if (!ierror && !stat ((char *)cname, &sstat)) {
+		sprintf ((char *)cname, "%s.dat", pcnewname);
+		chmod ((char *)cname, sstat.st_mode & 07777);
+		sprintf ((char *)cname, "%s.idx", pcnewname);
+		chmod ((char *)cname, sstat.st_mode & 07777);
+	}
+
+buildexit:
+	vvbfree (pcseen, tseensize);
+	isclose (inewhandle);
+	if (vb_rtd->psvbfile[inewhandle]->iisopen == 1) {
+		ivbclose2 (inewhandle);
+	}
+	ivbclose3 (inewhandle);
+	if (ierror) {
+		vclusterremove (pcnewname);
+	}
+	return ierror;
+}
+
 /* Global functions */
 
+/*
+ * Finish the swap of an iscluster () that stopped between its two renames.
+ * isbuild () creates the .idx first and the swap renames it first, while a
+ * copy is always removed .dat first, so a .dat without its .idx can only
+ * mean the new .idx is already in place.  Returns 0 or an errno.
+ */
 int
-iscluster (int ihandle, struct keydesc *pskeydesc)
+ivbclusterfinish (const VB_CHAR *pcfilename, const VB_CHAR *pcnewname)
+{
+	struct stat	sstat;
+	VB_CHAR		cfrom[MAX_PATH_LENGTH + 5], cto[MAX_PATH_LENGTH + 5];
+
+	if (strlen ((char *)pcnewname) > MAX_PATH_LENGTH) {
+		return 0;
+	}
+	sprintf ((char *)cfrom, "%s.idx", pcnewname);
+	if (!stat ((char *)cfrom, &sstat)) {
+		return 0;
+	}
+	sprintf ((char *)cfrom, "%s.dat", pcnewname);
+	if (stat ((char *)cfrom, &sstat)) {
+		return 0;
+	}
+	sprintf ((char *)cto, "%s.dat", pcfilename);
+	if (rename ((char *)cfrom, (char *)cto) && errno != ENOENT) {
+		return errno;
+	}
+	return 0;
+}
+
+/*
+ * Rewrite the table with its rows in the order of the index pskeydesc, so
+ * that reading it in that order reads the data file from front to back.
+ * The rows are renumbered and every index is rebuilt to match.  Any rows
+ * the index leaves out follow in their old order.  The handle stays open
+ * (exclusively) on the new table and is returned, as C-ISAM does.  The
+ * copy is built as pcnewname, or "<table>~" if that is NULL.  A table opened
+ * with ISTRANS gets a transaction of its own, committed once the swap has
+ * happened and rolled back if it never did.
+ */
+int
+ivbcluster (int ihandle, struct keydesc *pskeydesc, const VB_CHAR *pcnewname)
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
-	/* BUG Write iscluster() and don't forget to call ivbtranscluster */
-	if (ihandle < 0 || ihandle > vb_rtd->ivbmaxusedhandle) {
+	struct DICTINFO	*psvbptr, *psother;
+	off_t		troot[MAXSUBS];
+	int		ibegun = 0, iloop, ikey, ikeynumber, irenamed = 0;
+	int		iresult = -1, isaveerror;
+	VB_CHAR		cnewname[MAX_PATH_LENGTH], cfrom[MAX_PATH_LENGTH + 5];
+	VB_CHAR		cto[MAX_PATH_LENGTH + 5];
+
+	if (!pskeydesc) {
 		vb_rtd->iserrno = EBADARG;
 		return -1;
 	}
-	return 0;
+	if (ihandle >= 0 && ihandle <= vb_rtd->ivbmaxusedhandle
+	    && vb_rtd->psvbfile[ihandle] && vb_rtd->ivbintrans == VBNOTRANS
+	    && (vb_rtd->psvbfile[ihandle]->iopenmode & ISTRANS)) {
+		if (isbegin ()) {
+			return -1;
+		}
+		ibegun = 1;
+	}
+	if (ivbenter (ihandle, 1)) {
+		goto clusterend;
+	}
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	vb_rtd->iserrno = ENOTEXCL;
+	if (!(psvbptr->iopenmode & ISEXCLLOCK)) {
+		goto clusterexit;
+	}
+	ikeynumber = ivbcheckkey (ihandle, pskeydesc, 2, 0, 0);
+	if (ikeynumber == -1 && pskeydesc->k_nparts) {
+		goto clusterexit;
+	}
+	if (ikeynumber >= 0 && !psvbptr->pskeydesc[ikeynumber]->k_nparts) {
+		ikeynumber = -1;
+	}
+	/*
+	 * A rollback can't put the old row numbers back, so it mustn't happen
+	 * within a transaction of the caller's
+	 */
+	vb_rtd->iserrno = EBADARG;
+	if (!ibegun && vb_rtd->ivbintrans != VBNOTRANS && vb_rtd->ivbintrans != VBRECOVER) {
+		goto clusterexit;
+	}
+	vb_rtd->iserrno = EFNAME;
+	if (pcnewname) {
+		if (strlen ((char *)pcnewname) > MAX_PATH_LENGTH) {
+			goto clusterexit;
+		}
+		strcpy ((char *)cnewname, (char *)pcnewname);
+	} else {
+		if (strlen ((char *)psvbptr->cfilename) + 2 > MAX_PATH_LENGTH) {
+			goto clusterexit;
+		}
+		sprintf ((char *)cnewname, "%s~", psvbptr->cfilename);
+	}
+	/*
+	 * No other handle may be using the table.  One closed within the
+	 * transaction being recovered is closed properly now.
+	 */
+	vb_rtd->iserrno = ENOTEXCL;
+	for (iloop = 0; iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
+		psother = vb_rtd->psvbfile[iloop];
+		if (iloop == ihandle || !psother
+		    || strcmp ((char *)psother->cfilename, (char *)psvbptr->cfilename)) {
+			continue;
+		}
+		if (psother->iisopen == 0
+		    || (psother->iisopen == 1 && vb_rtd->ivbintrans != VBRECOVER)) {
+			goto clusterexit;
+		}
+	}
+	for (iloop = 0; iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
+		psother = vb_rtd->psvbfile[iloop];
+		if (iloop != ihandle && psother && psother->iisopen == 1
+		    && !strcmp ((char *)psother->cfilename, (char *)psvbptr->cfilename)) {
+			ivbclose2 (iloop);
+		}
+	}
+
+	vclusterremove (cnewname);
+	vb_rtd->iserrno = iclusterbuild (ihandle, ikeynumber, cnewname, troot);
+	if (vb_rtd->iserrno) {
+		goto clusterexit;
+	}
+	/* The log hears of the swap before the first rename */
+	if (ivbtranscluster (ihandle, pskeydesc, cnewname)) {
+		vclusterremove (cnewname);
+		goto clusterexit;
+	}
+
+	/* Swap the new files in under the old names, the .idx first */
+	isrelease (ihandle);
+	ivbclose (psvbptr->iindexhandle);
+	ivbclose (psvbptr->idatahandle);
+	for (; irenamed < 2; irenamed++) {
+		sprintf ((char *)cfrom, irenamed ? "%s.dat" : "%s.idx", cnewname);
+		sprintf ((char *)cto, irenamed ? "%s.dat" : "%s.idx", psvbptr->cfilename);
+		if (rename ((char *)cfrom, (char *)cto)) {
+			vb_rtd->iserrno = errno;
+			break;
+		}
+	}
+	/* Half way is no good to anyone, so have one more go at the .dat */
+	if (irenamed == 1 && !ivbclusterfinish (psvbptr->cfilename, cnewname)) {
+		irenamed = 2;
+	}
+	sprintf ((char *)cto, "%s.idx", psvbptr->cfilename);
+	psvbptr->iindexhandle = ivbopen (cto, O_RDWR | O_BINARY, 0);
+	sprintf ((char *)cto, "%s.dat", psvbptr->cfilename);
+	psvbptr->idatahandle = ivbopen (cto, O_RDWR | O_BINARY, 0);
+	if (psvbptr->iindexhandle < 0 || psvbptr->idatahandle < 0) {
+		vb_rtd->iserrno = EBADFILE;
+		goto clusterexit;
+	}
+	if (psvbptr->iopenmode & ISMMAP) {
+		ivbmapenable (psvbptr->iindexhandle);
+		ivbmapenable (psvbptr->idatahandle);
+	}
+	/* This also reads in the new dictionary node */
+	if (ivbfileopenlock (ihandle, 2)) {
+		vb_rtd->iserrno = EFLOCKED;
+		goto clusterexit;
+	}
+	if (irenamed == 0) {
+		/* Nothing has changed */
+		vclusterremove (cnewname);
+		goto clusterexit;
+	}
+	if (irenamed == 1) {
+		/* The next isopen () has another go at finishing it */
+		vb_rtd->iserrno = EBADFILE;
+		goto clusterexit;
+	}
+
+	/* Every cached node and row number is now meaningless */
+	for (iloop = 0; iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
+		psother = vb_rtd->psvbfile[iloop];
+		if (!psother || (iloop != ihandle
+				 && strcmp ((char *)psother->cfilename, (char *)psvbptr->cfilename))) {
+			continue;
+		}
+		for (ikey = 0; ikey < psother->inkeys; ikey++) {
+			vvbtreeallfree (iloop, ikey, psother->pstree[ikey]);
+			psother->pstree[ikey] = NULL;
+			psother->pskeycurr[ikey] = NULL;
+			if (ikey < psvbptr->inkeys) {
+				psother->pskeydesc[ikey]->k_rootnode = troot[ikey];
+			}
+		}
+		psother->trownumber = 0;
+		psother->tdupnumber = 0;
+		psother->trowstart = 0;
+	}
+	psvbptr->iisdictlocked &= ~0x02;
+	iresult = 0;
+
+clusterexit:
+	iresult |= ivbexit (ihandle);
+	if (!iresult && isstart (ihandle, psvbptr->pskeydesc[0], 0, NULL, ISFIRST)) {
+		iresult = -1;
+	}
+clusterend:
+	/*
+	 * Once the .idx is renamed the swap has happened (the next isopen ()
+	 * finishes a half done one), so isrecover () must replay it
+	 */
+	if (ibegun) {
+		isaveerror = vb_rtd->iserrno;
+		if (irenamed) {
+			if (iscommit ()) {
+				iresult = -1;
+				isaveerror = vb_rtd->iserrno;
+			}
+		} else {
+			isrollback ();
+		}
+		vb_rtd->iserrno = isaveerror;
+	}
+	if (iresult) {
+		return -1;
+	}
+	return ihandle;
+}
+
+int
+iscluster (int ihandle, struct keydesc *pskeydesc)
+{
+	return ivbcluster (ihandle, pskeydesc, NULL);
 }
 
 int
@@ -201,6 +662,192 @@ renameexit:
 	return -1;
 }
 
+/*
+ * Set the size (in bytes) of the block buffer pool shared by all the open
+ * tables.  Zero disables the pool.  The cached blocks are discarded and the
+ * pool is reallocated with the new size when next needed.
+ */
+int
+issetbuffers (int ibytes)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ibytes < 0) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vvbbufferfree ();
+	vb_rtd->ipoolsize = ibytes;
+	return 0;
+}
+
+/*
+ * Set the number of bytes of decoded index nodes and keys that may be kept
+ * in memory across calls, shared by all the open tables.  Once over budget
+ * the least recently used nodes are discarded, except for the roots and the
+ * path to each current key.
+ */
+int
+issetnodecache (int ibytes)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ibytes < 0) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vb_rtd->tnodecache = ibytes;
+	vvbtreetrim ();
+	return 0;
+}
+
+/*
+ * Set how full (as a percentage) isaddindex () packs each node of the index
+ * it builds.  The room left over takes later insertions without splitting.
+ */
+int
+issetfillfactor (int ipercent)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ipercent < 1 || ipercent > 100) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vb_rtd->ifillfactor = ipercent;
+	return 0;
+}
+
+/*
+ * Set how many bytes of log iscommit () lets pass before it tries to write a
+ * checkpoint, see ischeckpoint ().  0 leaves checkpoints to the application.
+ */
+int
+issetcheckpoint (int ibytes)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ibytes < 0) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vb_rtd->icheckpoint = ibytes;
+	vb_rtd->tnextcheckpoint = 0;
+	return 0;
+}
+
+/*
+ * Set the number of bytes of log records a transaction gathers before they
+ * are appended to the log in one write.  Everything still waiting goes out
+ * at iscommit () or isrollback ().  0 writes each record as it's made.
+ */
+int
+issetlogbuffer (int ibytes)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ibytes < 0) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vb_rtd->ilogbuffer = ibytes;
+	return 0;
+}
+
+/*
+ * Set whether iscommit () waits for the log to reach the disk.  Threads that
+ * commit at the same time share a single fdatasync ().
+ */
+int
+issetlogsync (int isync)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	vb_rtd->ilogsync = isync ? 1 : 0;
+	return 0;
+}
+
+/*
+ * Set the number of bytes of keys isaddindex () sorts in memory at a time.
+ * Larger tables are sorted in runs of that size, kept in temporary files.
+ */
+int
+issetsortmemory (int ibytes)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (ibytes < 0) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	vb_rtd->tsortmemory = ibytes;
+	return 0;
+}
+
+int
+isnodecacheinfo (struct nodecacheinfo *psinfo)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (!psinfo) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	psinfo->nc_budget = vb_rtd->tnodecache;
+	psinfo->nc_bytes = vb_rtd->tnodebytes;
+	psinfo->nc_peak = vb_rtd->tnodepeak;
+	psinfo->nc_evictions = vb_rtd->tnodeevictions;
+	psinfo->nc_nodes = vb_rtd->inodes;
+	psinfo->nc_keys = vb_rtd->ikeys;
+	return 0;
+}
+
+/*
+ * Walk the whole of index ikeynumber (1 = the primary key, as for
+ * isindexinfo ()) and report how full its nodes are.  This reads every
+ * node of the index so it's meant for monitoring, not the hot path.
+ */
+int
+isindexfill (int ihandle, int ikeynumber, struct indexfillinfo *psinfo)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+	struct keydesc	*pskeydesc;
+	int		iresult;
+	VB_CHAR		cvbnodetmp[MAX_NODE_LENGTH];
+
+	if (!psinfo) {
+		vb_rtd->iserrno = EBADARG;
+		return -1;
+	}
+	if (ivbenter (ihandle, 0)) {
+		return -1;
+	}
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	if (ikeynumber < 1 || ikeynumber > psvbptr->inkeys) {
+		vb_rtd->iserrno = EBADKEY;
+		ivbexit (ihandle);
+		return -1;
+	}
+	memset (psinfo, 0, sizeof (struct indexfillinfo));
+	pskeydesc = psvbptr->pskeydesc[ikeynumber - 1];
+	iresult = 0;
+	if (pskeydesc->k_nparts) {
+		iresult = ivbblockread (ihandle, 1, pskeydesc->k_rootnode, cvbnodetmp);
+	}
+	if (!iresult && pskeydesc->k_nparts) {
+		psinfo->fi_levels = cvbnodetmp[psvbptr->inodesize - 2] + 1;
+		iresult = iindexfillnode (ihandle, ikeynumber - 1,
+					  pskeydesc->k_rootnode, -1, psinfo);
+	}
+	if (psinfo->fi_capacity) {
+		psinfo->fi_fill = (int)(psinfo->fi_bytes * 100 / psinfo->fi_capacity);
+	}
+	vb_rtd->iserrno = iresult;
+	ivbexit (ihandle);
+	return iresult ? -1 : 0;
+}
+
 int
 issetunique (int ihandle, vbisam_off_t tuniqueid)
 {
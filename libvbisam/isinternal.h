@@ -58,6 +58,12 @@
 #ifdef  HAVE_FCNTL_H
     #include  <fcntl.h>
 #endif
+#if     HAVE_SYS_MMAN_H
+    #include  <sys/mman.h>
+#endif
+#if     HAVE_PTHREAD_CREATE
+    #include  <pthread.h>
+#endif
 #include  <stdlib.h>
 #include  <string.h>
 #include  <errno.h>
@@ -144,16 +150,20 @@ typedef unsigned short  mode_t;
     extern COB_THREAD vb_rtd_t vb_rtd_data;
 #else
 
+/*
+ * The very first use goes through vb_get_rtd () so that vb_init_rtd () sets
+ * the defaults, whether or not the application called vb_get_rtd () itself
+ */
 #ifdef HAVE__PTHREAD_ATTR
   extern __pthread vb_rtd_t vb_rtd_data;
   #undef VB_GET_RTD
-  #define VB_GET_RTD &vb_rtd_data
+  #define VB_GET_RTD (likely (vb_rtd_data.vb_isinit) ? &vb_rtd_data : vb_get_rtd ())
 
 #elif defined (HAVE_PTHREAD_H)
 #else
   extern vb_rtd_t vb_rtd_data;
   #undef VB_GET_RTD
-  #define VB_GET_RTD &vb_rtd_data
+  #define VB_GET_RTD (likely (vb_rtd_data.vb_isinit) ? &vb_rtd_data : vb_get_rtd ())
 
 #endif
 #endif
@@ -451,10 +461,17 @@ struct  VBKEY {
     VB_UCHAR   iisnew;     /* If this is a new entry (split use) */
     VB_UCHAR   iishigh;    /* Is this a GREATER THAN key? */
     VB_UCHAR   iisdummy;   /* A simple end of node marker */
-    VB_UCHAR   pspare[5];  /* Spare */
+    VB_UCHAR   pspare[3];  /* Spare */
+    unsigned short  islot;  /* Index into the psparent slot arrays */
     VB_UCHAR   ckey[1];    /* Placeholder for the key itself */
 };
 
+#if ISAMMODE == 1     /* Highly non-portable.. kind of */
+#define VB_NODE_MAXKEYS 512
+#else /* ISAMMODE == 1 */
+#define VB_NODE_MAXKEYS 256
+#endif  /* ISAMMODE == 1 */
+
 struct  VBTREE {
     struct  VBTREE  *psnext;    /* Used for the free list only! */
     struct  VBTREE  *psparent;  /* The next level up from this node */
@@ -465,15 +482,99 @@ struct  VBTREE {
     off_t       ttransnumber;   /* Transaction number stamp */
     unsigned int    ilevel;     /* The level number (0 = LEAF) */
     unsigned int    ikeysinnode;    /* # keys in pskeylist */
+    unsigned int    iepoch;     /* DICTINFO iepoch when last known valid */
     VB_UCHAR   iisroot;    /* 1 = This is the ROOT node */
     VB_UCHAR   iistof;     /* 1 = First entry in index */
     VB_UCHAR   iiseof;     /* 1 = Last entry in index */
-    VB_UCHAR   pspare[5];  /* Spare */
-#if ISAMMODE == 1     /* Highly non-portable.. kind of */
-    struct  VBKEY   *pskeylist[512];
-#else /* ISAMMODE == 1 */
-    struct  VBKEY   *pskeylist[256];
-#endif  /* ISAMMODE == 1 */
+    VB_UCHAR   iisretained;    /* 1 = On the retained node LRU list */
+    VB_UCHAR   pspare[4];  /* Spare */
+    int     ihandle;    /* The table this node belongs to */
+    struct  VBTREE  *pslrunewer;    /* Retained node LRU list links */
+    struct  VBTREE  *pslruolder;
+    /*
+     * The keys of the node laid out side by side for searching, in one
+     * allocation of islots entries.  ivbtreeslots () builds them when a node
+     * is loaded or reshaped, single inserts and deletes only move the slots
+     * after the one that changed.  The VBKEY list stays the owner of the keys.
+     * The slot copies are normalized (see vvbkeynormalize ()) so that they
+     * collate with a plain memcmp (), the high key sorting last of all.
+     */
+    unsigned int    islots;     /* Entries allocated */
+    size_t      tslotsize;  /* Bytes allocated */
+    off_t       *ptrownode; /* Row number (leaf) / child node number */
+    off_t       *ptdupnumber;   /* Duplicate number */
+    long long   *ptprefix;  /* Leading bytes of each slot, see tvbkeyprefix () */
+    struct  VBKEY   **pskeylist;    /* The VBKEY of each slot */
+    VB_UCHAR   *pckeyslots;    /* Normalized key values, k_len bytes apart */
+};
+
+/*
+ * Where ivbnodepacklength () / vvbnodepackkey () are up to while laying out
+ * the keys of a node image, see vvbnodepackstart ()
+ */
+struct  VBNODEPACK {
+    VB_UCHAR   *pcnode;    /* Start of the node image */
+    VB_UCHAR   *pcnodeptr; /* Where the next key goes */
+    int     iisfirst;   /* 1 = No key has been written in full yet */
+    int     icountlc;   /* Leading compression of the key sized last */
+    int     icounttc;   /* Trailing compression of the key sized last */
+    int     iprevtc;    /* Trailing compression of the previous key */
+    int     ikeylen;    /* Bytes the key sized last takes up */
+    VB_UCHAR   cprevkey[VB_MAX_KEYLEN];    /* Last key written in full */
+};
+
+struct  VBSLAB {
+    struct  VBSLAB  *psnext;    /* The next (older) chunk */
+    off_t       tspare;     /* Keeps the objects that follow aligned */
+};
+
+/* Compares two contiguous key values of the given key, see vvbkeycompareset () */
+typedef int (*VBKEYCOMPARE) (struct keydesc *pskeydesc, VB_UCHAR *pccollate,
+                             int ilength, VB_UCHAR *pckey1, VB_UCHAR *pckey2);
+
+/* Normalized key bytes held in each VBTREE ptprefix entry */
+#define VB_PREFIXLEN    8
+
+/* Approximate size (in bytes) of each VBSLABPOOL chunk */
+#define VB_SLABSIZE 8192
+
+/* Default size (in bytes) of the retained node budget, see issetnodecache () */
+#define VB_NODECACHE (1024 * MAX_NODE_LENGTH)
+
+/* Default size (in bytes) of the block buffer pool, see issetbuffers () */
+#define VB_POOLSIZE (256 * MAX_NODE_LENGTH)
+
+/* Default memory (in bytes) for sorting keys in bulk, see issetsortmemory () */
+#define VB_SORTMEMORY (8192 * MAX_NODE_LENGTH)
+
+/* Default percentage of each node filled in a bulk build, see issetfillfactor () */
+#define VB_FILLFACTOR 90
+
+/* Default size (in bytes) of a transaction's staged log records, see issetlogbuffer () */
+#define VB_LOGBUFFER (64 * 1024)
+
+/* Size (in bytes) of the chunks isrecover () reads the log in, see issetrecoverworkers () */
+#define VB_RCVCHUNK (256 * 1024)
+
+/* Largest block (in bytes) a rollback reads the log backwards in */
+#define VB_LOGBLOCK (256 * 1024)
+
+struct  VBBUFFER {
+    struct  VBBUFFER *psnext;   /* Next buffer in the same hash chain */
+    off_t       tblocknumber;   /* The block held (0 = buffer is unused) */
+    int     ifilehandle;    /* The svbfile[] slot of the .idx or .dat */
+    VB_UCHAR   iisreferenced;  /* CLOCK second chance flag */
+    VB_UCHAR   pspare[3];  /* Spare */
+    VB_CHAR    cblock[MAX_NODE_LENGTH];
+};
+
+struct  VBPOOL {
+    struct  VBBUFFER **pshash;  /* Hash chains keyed on file and block */
+    struct  VBBUFFER *psbuffer; /* The ibuffers buffers themselves */
+    int     ibuffers;   /* Number of buffers in the pool */
+    int     ihashmask;  /* Number of hash chains - 1 */
+    int     iclockhand; /* Next buffer to be considered for reuse */
+    off_t       ttransnumber[VB_MAX_FILES * 3]; /* Dict.Trans the blocks of each file are valid for */
 };
 
 struct  DICTNODE {                     /* Offset      32Val   64Val */
@@ -499,7 +600,7 @@ struct  DICTNODE {                     /* Offset      32Val   64Val */
     VB_CHAR    cuniqueid[QUADSIZE];    /* 0x2d  0x45  Varies  Same */
     VB_CHAR    cnodeaudit[QUADSIZE];   /* 0x31  0x4d  Varies  Same */
     VB_CHAR    clockmethod[INTSIZE];   /* 0x35  0x55  0x0008  Same */
-    VB_CHAR    crfu4[QUADSIZE];        /* 0x37  0x57  0x00... Same */
+    VB_CHAR    crowcount[QUADSIZE];    /* 0x37  0x57  Varies  Same */
     VB_CHAR    cmaxrowlength[INTSIZE]; /* 0x3b  0x5f  Varies  Same */
     VB_CHAR    cvarleng0[QUADSIZE];    /* 0x3d  0x61  Varies  Same */
     VB_CHAR    cvarleng1[QUADSIZE];    /* 0x41  0x69  Varies  Same */
@@ -513,8 +614,13 @@ struct  DICTNODE {                     /* Offset      32Val   64Val */
     VB_CHAR    cvarleng8[QUADSIZE];    /* 0xa1  Varies  Same */
 #endif  /* ISAMMODE == 1 */
     VB_CHAR    crfulocalindex[36]; /* 0x51  0xa9  0x00... Same */
+    /*
+     * Older versions only write the bytes above and zero the rest of the
+     * node, so any change they make to the table leaves crowcount stale
+     */
+    VB_CHAR    crowcountok;            /* 0x75  0xcd  0x00/01 Same */
     /*       ---- ---- */
-    /* Length Total    0x75 0xcd */
+    /* Length Total    0x76 0xce */
 };
 
 struct  DICTINFO {
@@ -533,7 +639,7 @@ struct  DICTINFO {
     int iopenmode;  /* The type of open which was used */
     int ivarlenlength;  /* Length of varlen component */
     int ivarlenslot;    /* The slot number within tvarlennode */
-    int dspare1;
+    unsigned int iepoch; /* Bumped when another process changed the index */
     off_t   trownumber; /* Which data row is "CURRENT" 0 if none */
     off_t   tdupnumber; /* Which duplicate number is "CURRENT" (0=First) */
     off_t   trowstart;  /* ONLY set to nonzero by isstart() */
@@ -566,12 +672,17 @@ struct  DICTINFO {
     struct  VBTREE      *pstree[MAXSUBS]; /* Linked list of index nodes */
     struct  VBKEY       *pskeyfree[MAXSUBS]; /* An array of linked lists of free VBKEYs */
     struct  VBKEY       *pskeycurr[MAXSUBS]; /* An array of 'current' VBKEY pointers */
+    struct  VBTREE      *pstreefree;    /* Linked list of free VBTREEs */
+    struct  VBSLABPOOL  streeslab;  /* Where the VBTREEs come from */
+    struct  VBSLABPOOL  skeyslab[MAXSUBS];  /* Where the VBKEYs of each key come from */
+    VBKEYCOMPARE        pfkeycompare[MAXSUBS];  /* Comparator chosen for each key */
 };
 
 #define VBL_BUILD ("BU")
 #define VBL_BEGIN ("BW")
 #define VBL_CREINDEX  ("CI")
 #define VBL_CLUSTER ("CL")
+#define VBL_CHECKPOINT  ("CP")
 #define VBL_COMMIT  ("CW")
 #define VBL_DELETE  ("DE")
 #define VBL_DELINDEX  ("DI")
@@ -582,6 +693,7 @@ struct  DICTINFO {
 #define VBL_RENAME  ("RE")
 #define VBL_ROLLBACK  ("RW")
 #define VBL_SETUNIQUE ("SU")
+#define VBL_TABLESTAMP ("TS")
 #define VBL_UNIQUEID  ("UN")
 #define VBL_UPDATE  ("UP")
 
@@ -599,6 +711,11 @@ struct  SLOGHDR {
 
 /* isbuild.c */
 VB_HIDDEN extern int    VBiaddkeydescriptor (const int ihandle, struct keydesc *pskeydesc);
+VB_HIDDEN extern int    ivbkeysfromdata (const int ihandle, const int ifirstkey);
+
+/* ishelper.c */
+VB_HIDDEN extern int    ivbcluster (int ihandle, struct keydesc *pskeydesc, const VB_CHAR *pcnewname);
+VB_HIDDEN extern int    ivbclusterfinish (const VB_CHAR *pcfilename, const VB_CHAR *pcnewname);
 
 /* isopen.c */
 VB_HIDDEN extern int    ivbclose2 (const int ihandle);
@@ -612,7 +729,8 @@ VB_HIDDEN extern int    ivbcheckkey (const int ihandle, struct keydesc *pskey,
 VB_HIDDEN extern int    ivbtransbuild (const VB_CHAR *pcfilename, const int iminrowlen, const int imaxrowlen,
                                        struct keydesc *pskeydesc, const int imode);
 VB_HIDDEN extern int    ivbtranscreateindex (int ihandle, struct keydesc *pskeydesc);
-VB_HIDDEN extern int    ivbtranscluster (void);
+VB_HIDDEN extern int    ivbtranscluster (int ihandle, struct keydesc *pskeydesc,
+                                         const VB_CHAR *pcnewname);
 VB_HIDDEN extern int    ivbtransdelete (int ihandle, off_t trownumber, int irowlength);
 VB_HIDDEN extern int    ivbtransdeleteindex (int ihandle, struct keydesc *pskeydesc);
 VB_HIDDEN extern int    ivbtranserase (VB_CHAR *pcfilename);
@@ -625,6 +743,8 @@ VB_HIDDEN extern int    ivbtranssetunique (int ihandle, off_t tuniqueid);
 VB_HIDDEN extern int    ivbtransuniqueid (int ihandle, off_t tuniqueid);
 VB_HIDDEN extern int    ivbtransupdate (int ihandle, off_t trownumber, int ioldrowlen,
                                         int inewrowlen, VB_CHAR *pcrow);
+VB_HIDDEN extern off_t  tvblastcheckpoint (off_t tend);
+VB_HIDDEN extern off_t  tvbtablestamp (VB_CHAR *pcfilename);
 
 /* iswrite.c */
 VB_HIDDEN extern int    ivbwriterow (const int ihandle, VB_CHAR *pcrow, off_t trownumber);
@@ -642,10 +762,18 @@ VB_HIDDEN extern int    ivbdatafree (const int ihandle, off_t trownumber);
 VB_HIDDEN extern off_t  tvbnodeallocate (const int ihandle);
 VB_HIDDEN extern off_t  tvbdataallocate (const int ihandle);
 VB_HIDDEN extern int    ivbforcedataallocate (const int ihandle, off_t trownumber);
+VB_HIDDEN extern off_t  tvbrowcount (const int ihandle);
 
 /* vbkeysio.c */
 VB_HIDDEN extern void   vvbmakekey (const struct keydesc *pskeydesc,
                                     VB_CHAR *pcrow_buffer, VB_UCHAR *pckeyvalue);
+VB_HIDDEN extern void   vvbunmakekey (const struct keydesc *pskeydesc,
+                                      VB_UCHAR *pckeyvalue, VB_CHAR *pcrow_buffer);
+VB_HIDDEN extern void   vvbkeynormalize (const struct keydesc *pskeydesc,
+                                         VB_UCHAR *pccollate, VB_UCHAR *pckeyvalue,
+                                         VB_UCHAR *pcnormal);
+VB_HIDDEN extern int    ivbkeynormlength (const struct keydesc *pskeydesc, int ilength);
+VB_HIDDEN extern long long  tvbkeyprefix (VB_UCHAR *pcnormal, int ilength);
 VB_HIDDEN extern int    ivbkeysearch (const int ihandle, const int imode,
                                       const int ikeynumber, int ilength,
                                       VB_UCHAR *pckeyvalue, off_t tdupnumber);
@@ -661,6 +789,7 @@ VB_HIDDEN extern int    ivbkeyinsert (const int ihandle, struct VBTREE *pstree,
 VB_HIDDEN extern int    ivbkeydelete (const int ihandle, const int ikeynumber);
 VB_HIDDEN extern int    ivbkeycompare (const int ihandle, const int ikeynumber, int ilength,
                                        VB_UCHAR *pckey1, VB_UCHAR *pckey2);
+VB_HIDDEN extern void   vvbkeycompareset (const int ihandle, const int ikeynumber);
 #ifdef  VBDEBUG
 VB_HIDDEN extern int    idumptree (int ihandle, int ikeynumber);
 VB_HIDDEN extern int    ichktree (int ihandle, int ikeynumber);
@@ -685,10 +814,27 @@ VB_HIDDEN extern ssize_t    tvbwrite (const int ihandle, void *pvbuffer, const s
     #define tvbwrite(x,y,z) write(vb_rtd->svbfile[(x)].ihandle,(void *)(y),(size_t)(z))
 #endif
 
+/* Positional I/O, leaves the file offset alone */
+#if defined(VBDEBUG) || defined(_WIN32)
+VB_HIDDEN extern ssize_t    tvbpread (const int ihandle, void *pvbuffer, const size_t tcount,
+                                      off_t toffset);
+VB_HIDDEN extern ssize_t    tvbpwrite (const int ihandle, void *pvbuffer, const size_t tcount,
+                                       off_t toffset);
+#else
+    #define tvbpread(x,y,z,o)   pread(vb_rtd->svbfile[(x)].ihandle,(void *)(y),(size_t)(z),(off_t)(o))
+    #define tvbpwrite(x,y,z,o)  pwrite(vb_rtd->svbfile[(x)].ihandle,(void *)(y),(size_t)(z),(off_t)(o))
+#endif
+
 VB_HIDDEN extern int    ivbblockread (const int ihandle, const int iisindex,
                                       off_t tblocknumber, VB_CHAR *cbuffer);
 VB_HIDDEN extern int    ivbblockwrite (const int ihandle, const int iisindex,
                                        off_t tblocknumber, VB_CHAR *cbuffer);
+VB_HIDDEN extern int    ivbmapenable (const int ifilehandle);
+VB_HIDDEN extern VB_CHAR    *pcvbmapped (const int ifilehandle, off_t toffset, const size_t tlength);
+VB_HIDDEN extern VB_CHAR    *pcvbdictmapped (const int ifilehandle);
+VB_HIDDEN extern void   vvbbufferinvalidate (const int ifilehandle);
+VB_HIDDEN extern void   vvbbuffersync (const int ihandle, const int iownchange);
+VB_HIDDEN extern void   vvbbufferfree (void);
 VB_HIDDEN extern int    ivblock (const int ihandle, off_t toffset, off_t tlength, const int imode);
 
 /* vbmemio.c */
@@ -697,12 +843,26 @@ VB_HIDDEN extern void           vvblockfree (struct VBLOCK *pslock);
 VB_HIDDEN extern struct VBTREE  *psvbtreeallocate (const int ihandle);
 VB_HIDDEN extern void           vvbtreeallfree (const int ihandle, const int ikeynumber,
                                                 struct VBTREE *pstree);
+VB_HIDDEN extern void           vvbtreetouch (struct VBTREE *pstree);
+VB_HIDDEN extern int            ivbtreeslots (const int ihandle, const int ikeynumber,
+                                              struct VBTREE *pstree);
+VB_HIDDEN extern int            ivbtreeslotsall (const int ihandle, const int ikeynumber,
+                                                 struct VBTREE *pstree);
+VB_HIDDEN extern int            ivbtreeslotinsert (const int ihandle, const int ikeynumber,
+                                                   struct VBTREE *pstree, struct VBKEY *pskey);
+VB_HIDDEN extern void           vvbtreeslotdelete (const int ihandle, const int ikeynumber,
+                                                   struct VBTREE *pstree, struct VBKEY *pskey);
+VB_HIDDEN extern void           vvbtreeslotupdate (const int ihandle, const int ikeynumber,
+                                                   struct VBTREE *pstree, struct VBKEY *pskey);
+VB_HIDDEN extern void           vvbtreetrim (void);
 VB_HIDDEN extern struct VBKEY   *psvbkeyallocate (const int ihandle, const int ikeynumber);
 VB_HIDDEN extern void           vvbkeyallfree (const int ihandle, const int ikeynumber,
                                                struct VBTREE *pstree);
 VB_HIDDEN extern void           vvbkeyfree (const int ihandle, const int ikeynumber,
                                             struct VBKEY *pskey);
 VB_HIDDEN extern void           vvbkeyunmalloc (const int ihandle, const int ikeynumber);
+VB_HIDDEN extern void           vvbtableunmalloc (const int ihandle);
+VB_HIDDEN extern void           vvblockunmalloc (void);
 #ifdef  VBDEBUG
 VB_HIDDEN extern void           *pvvbmalloc (const size_t tlength);
 VB_HIDDEN extern void           vvbfree (void *pvpointer, size_t tlength);
@@ -713,11 +873,19 @@ VB_HIDDEN extern void           vvbunmalloc (void);
 #endif  /* VBDEBUG */
 
 /* vbnodememio.c */
+VB_HIDDEN extern void   vvbtreeedges (struct VBTREE *pstree);
 VB_HIDDEN extern int    ivbnodeload (const int ihandle, const int ikeynumber,
                                      struct VBTREE *pstree, off_t tnodenumber,
                                      int iprevlvl);
 VB_HIDDEN extern int    ivbnodesave (const int ihandle, const int ikeynumber,
                                      struct VBTREE *pstree, off_t tnodenumber , int imode,
                                      int iposn);
+VB_HIDDEN extern void   vvbnodepackstart (const int ihandle, struct VBNODEPACK *pspack,
+                                          VB_CHAR *pcnode, int ilevel);
+VB_HIDDEN extern int    ivbnodepacklength (struct keydesc *pskeydesc,
+                                           struct VBNODEPACK *pspack,
+                                           VB_UCHAR *pckey, int iishigh);
+VB_HIDDEN extern void   vvbnodepackkey (struct keydesc *pskeydesc, struct VBNODEPACK *pspack,
+                                        VB_UCHAR *pckey, off_t tdupnumber, off_t trownode);
 
 #endif  /* VB_LIBVBISAM_H */
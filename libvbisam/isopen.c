@@ -50,33 +50,6 @@ ivbforceexit (const int ihandle)
     return 0;
 }
 
-#ifdef NEED_COUNT_ROWS
-static off_t
-tcountrows (const int ihandle)
-{
-    vb_rtd_t *vb_rtd =VB_GET_RTD;
-    off_t       tnodenumber, tdatacount;
-    int         inodeused;
-    VB_CHAR     cvbnodetmp[MAX_NODE_LENGTH];
-
-    tnodenumber = inl_ldquad ((VB_CHAR *)vb_rtd->psvbfile[ihandle]->sdictnode.cdatafree);
-    tdatacount = inl_ldquad ((VB_CHAR *)vb_rtd->psvbfile[ihandle]->sdictnode.cdatacount);
-    printf("COUNT: INIT: %zd\n", tdatacount);
-    while (tnodenumber) {
-        if (ivbblockread (ihandle, 1, tnodenumber, cvbnodetmp)) {
-            return -1;
-        }
-        inodeused = inl_ldint (cvbnodetmp);
-        inodeused -= INTSIZE + QUADSIZE;
-        tdatacount -= (inodeused / QUADSIZE);
-        tnodenumber = inl_ldquad (cvbnodetmp + INTSIZE);
-        printf("COUNT: CALC: %zd\n", tdatacount);
-    }
-    printf("COUNT: FINI: %zd\n", tdatacount);
-    return tdatacount;
-}
-#endif
-
 /* Global functions */
 
 /* Comments:
@@ -140,10 +113,9 @@ ivbclose3 (const int ihandle)
     if (!psvbptr) {
         return;
     }
+    vvbtableunmalloc (ihandle);
     for (iloop = 0; iloop < MAXSUBS; iloop++) {
-        vvbtreeallfree (ihandle, iloop, psvbptr->pstree[iloop]);
         if (psvbptr->pskeydesc[iloop]) {
-            vvbkeyunmalloc (ihandle, iloop);
             vvbfree (psvbptr->pskeydesc[iloop], sizeof (struct keydesc));
         }
     }
@@ -185,6 +157,8 @@ iscleanup (void)
             iresult2 = vb_rtd->iserrno;
         }
     }
+    vvbbufferfree ();
+    vvblockunmalloc ();
     return iresult2;
 }
 
@@ -268,11 +242,7 @@ isindexinfo (int ihandle, void *pskeydesc, int ikeynumber)
     }
     sdict.di_recsize = psvbfptr->imaxrowlength;
     sdict.di_idxsize = psvbfptr->inodesize;
-#ifdef NEED_COUNT_ROWS
-    sdict.di_nrecords = tcountrows (ihandle);
-#else
-    sdict.di_nrecords = 0;
-#endif
+    sdict.di_nrecords = tvbrowcount (ihandle);
     vb_rtd->isreclen = psvbfptr->iminrowlength;
     memcpy (pskeydesc, &sdict, sizeof (struct dictinfo));
 
@@ -309,6 +279,12 @@ isopen (const VB_CHAR *pcfilename, int imode)
         vb_rtd->iserrno = EFNAME;
         return -1;
     }
+    /* An iscluster () may have stopped half way through its swap */
+    sprintf ((char*)tmpfname, "%s~", pcfilename);
+    vb_rtd->iserrno = ivbclusterfinish (pcfilename, tmpfname);
+    if (vb_rtd->iserrno) {
+        return -1;
+    }
     /*
      * The following for loop deals with the concept of re-opening a file
      * that was closed within the SAME transaction.  Since we were not
@@ -337,6 +313,10 @@ isopen (const VB_CHAR *pcfilename, int imode)
                         goto open_err;
                     }
                 }
+                if (imode & ISMMAP) {
+                    ivbmapenable (psfile->iindexhandle);
+                    ivbmapenable (psfile->idatahandle);
+                }
                 psfile->iisopen = 0;
                 if (imode & ISREBUILD) {
                     if (psfile->imaxrowlength != psfile->iminrowlength) {
@@ -401,6 +381,11 @@ isopen (const VB_CHAR *pcfilename, int imode)
     if (psfile->idatahandle < 0) {
         goto open_err;
     }
+    if (imode & ISMMAP) {
+        /* If the files cannot be mapped, we simply read them as usual */
+        ivbmapenable (psfile->iindexhandle);
+        ivbmapenable (psfile->idatahandle);
+    }
     psfile->iisopen = 0;
 
     psfile->inodesize = MAX_NODE_LENGTH;
@@ -524,6 +509,7 @@ isopen (const VB_CHAR *pcfilename, int imode)
                 }
                 iindexpart++;
             }
+            vvbkeycompareset (ihandle, iindexnumber);
             iindexnumber++;
         }
         if (ilengthused < 0) {
@@ -584,10 +570,22 @@ open_err:
 int issetcollate (int ihandle, VB_UCHAR *collating_sequence)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *psvbptr;
+    int     ikey;
+
     if (unlikely(ihandle < 0 || ihandle > vb_rtd->ivbmaxusedhandle)) {
         vb_rtd->iserrno = EBADARG;
         return -1;
     }
-    vb_rtd->psvbfile[ihandle]->collating_sequence = collating_sequence;
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    psvbptr->collating_sequence = collating_sequence;
+    /* The cached nodes hold keys normalized for the old sequence */
+    for (ikey = 0; ikey < psvbptr->inkeys; ikey++) {
+        vvbkeycompareset (ihandle, ikey);
+        vb_rtd->iserrno = ivbtreeslotsall (ihandle, ikey, psvbptr->pstree[ikey]);
+        if (vb_rtd->iserrno) {
+            return -1;
+        }
+    }
     return 0;
 }
@@ -245,8 +245,14 @@ ivbcheckkey (const int ihandle, struct keydesc *pskey, const int imode,
     return -1;
 }
 
-int
-isread (int ihandle, VB_CHAR *pcrow, int imode)
+/*
+ * The body of isread () once ivbenter () has succeeded, shared with
+ * isreadbatch () so that a batch can read many rows under one enter.
+ * If ikeyonly is set, only the key columns of pcrow are filled in and
+ * taken straight from the leaf, the data row itself is never read.
+ */
+static int
+ireadrow (const int ihandle, VB_CHAR *pcrow, const int imode, const int ikeyonly)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct VBKEY    *pskey;
@@ -255,10 +261,6 @@ isread (int ihandle, VB_CHAR *pcrow, int imode)
     int             ireadmode, iresult = -1;
     VB_UCHAR        ckeyvalue[VB_MAX_KEYLEN];
 
-    if (ivbenter (ihandle, 0)) {
-        return -1;
-    }
-
     vb_rtd->iserrno = EBADKEY;
     psvbfptr = vb_rtd->psvbfile[ihandle];
     ikeynumber = psvbfptr->iactivekey;
@@ -277,10 +279,13 @@ isread (int ihandle, VB_CHAR *pcrow, int imode)
          */
         iresult = istartrownumber (ihandle, ireadmode, 1);
         if (!iresult) {
-            memcpy (pcrow, psvbfptr->ppcrowbuffer, (size_t)psvbfptr->iminrowlength);
+            /* The row number index has no key columns to fill in */
+            if (!ikeyonly) {
+                memcpy (pcrow, psvbfptr->ppcrowbuffer, (size_t)psvbfptr->iminrowlength);
+            }
             psvbfptr->iisdisjoint = 0;
         }
-        goto read_exit;
+        return iresult;
     }
     vb_rtd->iserrno = 0;
     vb_rtd->isrecnum = 0;
@@ -337,8 +342,8 @@ isread (int ihandle, VB_CHAR *pcrow, int imode)
                 }
                 vb_rtd->iserrno = 0;
             }
-            if (memcmp (ckeyvalue, psvbfptr->pskeycurr[ikeynumber]->ckey,
-                        (size_t)psvbfptr->pskeydesc[ikeynumber]->k_len)) {
+            if (ivbkeycompare (ihandle, ikeynumber, 0, ckeyvalue,
+                               psvbfptr->pskeycurr[ikeynumber]->ckey)) {
                 iresult = -1;
                 vb_rtd->iserrno = ENOREC;
             } else {
@@ -455,7 +460,10 @@ isread (int ihandle, VB_CHAR *pcrow, int imode)
 		}
             }
         }
-        if (!ilockresult) {
+        if (!ilockresult && ikeyonly) {
+            vvbunmakekey (psvbfptr->pskeydesc[ikeynumber],
+                          psvbfptr->pskeycurr[ikeynumber]->ckey, pcrow);
+        } else if (!ilockresult) {
             iresult = ivbdataread (ihandle, pcrow, &ideleted,
                                    psvbfptr->pskeycurr[ikeynumber]->trownode);
         }
@@ -465,10 +473,151 @@ isread (int ihandle, VB_CHAR *pcrow, int imode)
             psvbfptr->iisdisjoint = 0;
         }
     }
+    return iresult;
+}
+
+int
+isread (int ihandle, VB_CHAR *pcrow, int imode)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    int             iresult;
+
+    if (ivbenter (ihandle, 0)) {
+        return -1;
+    }
+
+    iresult = ireadrow (ihandle, pcrow, imode, 0);
+
+    vb_rtd->psvbfile[ihandle]->iisdictlocked |= 0x04;
+    ivbexit (ihandle);
+    if(vb_rtd->iserrno == ELOCKED)
+	    return 1;
+    return iresult;
+}
+
+/*
+ * isreadkey () positions exactly as isread () does, but only fills in
+ * the key columns of pcrow (the rest of it is left untouched) from the
+ * index leaf, saving the data file read when the key is all that's needed.
+ * isrecnum and the current row are set as for isread ().
+ */
+int
+isreadkey (int ihandle, VB_CHAR *pcrow, int imode)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    int             iresult;
+
+    if (ivbenter (ihandle, 0)) {
+        return -1;
+    }
+
+    iresult = ireadrow (ihandle, pcrow, imode, 1);
+
+    vb_rtd->psvbfile[ihandle]->iisdictlocked |= 0x04;
+    ivbexit (ihandle);
+    if(vb_rtd->iserrno == ELOCKED)
+	    return 1;
+    return iresult;
+}
+
+/*
+ * isreadbatch () fills pcbuffer with up to imaxrows consecutive rows.
+ * Each entry is a vbisam_off_t row number, an int holding the length of
+ * the row read (isreclen for that row) and then room for iminrowlength
+ * bytes of row data (imaxrowlength for a variable length table), so
+ * entries are VB_BATCHENTRY (that length) bytes apart and neither number
+ * is necessarily aligned.  The first row is positioned exactly as
+ * isread (imode) would, the remainder follow it as ISPREV would after
+ * ISLAST / ISPREV and as ISNEXT would otherwise.  The whole batch is read under a single
+ * ivbenter () and, unless locking was requested, subsequent rows step
+ * the leaf cursor directly instead of relocating the previous row.
+ * On return *pinrows holds the number of entries filled.  If at least
+ * one row was read the result is 0 and iserrno says why the batch
+ * stopped short (eg. EENDFILE), or is 0 when it was filled.
+ */
+int
+isreadbatch (int ihandle, VB_CHAR *pcbuffer, int imaxrows, int imode, int *pinrows)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBKEY    *pskey;
+    struct DICTINFO *psvbfptr;
+    VB_CHAR         *pcentry;
+    vbisam_off_t    trownode;
+    size_t          tstride;
+    int             ideleted, idirection, ikeynumber, ilocking;
+    int             iresult;
+
+    if (!pinrows) {
+        vb_rtd->iserrno = EBADARG;
+        return -1;
+    }
+    *pinrows = 0;
+    if (!pcbuffer || imaxrows < 1) {
+        vb_rtd->iserrno = EBADARG;
+        return -1;
+    }
+    if (ivbenter (ihandle, 0)) {
+        return -1;
+    }
+
+    psvbfptr = vb_rtd->psvbfile[ihandle];
+    ikeynumber = psvbfptr->iactivekey;
+    ilocking = (imode & (ISLOCK | ISSKIPLOCK))
+               || (psvbfptr->iopenmode & ISAUTOLOCK);
+    switch (imode & BYTEMASK) {
+    case ISLAST:
+    case ISPREV:
+        idirection = ISPREV;
+        break;
+    default:
+        idirection = ISNEXT;
+    }
+    if (psvbfptr->iopenmode & ISVARLEN) {
+        tstride = VB_BATCHENTRY (psvbfptr->imaxrowlength);
+    } else {
+        tstride = VB_BATCHENTRY (psvbfptr->iminrowlength);
+    }
+
+    pcentry = pcbuffer;
+    iresult = ireadrow (ihandle, pcentry + VB_BATCHHEADER, imode, 0);
+    while (!iresult) {
+        trownode = vb_rtd->isrecnum;
+        memcpy (pcentry, &trownode, sizeof (vbisam_off_t));
+        memcpy (pcentry + sizeof (vbisam_off_t), &vb_rtd->isreclen, sizeof (int));
+        pcentry += tstride;
+        if (++*pinrows == imaxrows) {
+            break;
+        }
+        if (ilocking || ikeynumber == -1
+            || !psvbfptr->pskeydesc[ikeynumber]->k_nparts) {
+            /* Locks and the row number index take the long way round */
+            iresult = ireadrow (ihandle, pcentry + VB_BATCHHEADER,
+                                idirection | (imode & ~BYTEMASK), 0);
+            continue;
+        }
+        /*
+         * The previous row is still current on its leaf as nobody can
+         * have altered the index since we entered, so just step to the
+         * neighbouring key without ivbkeylocaterow ()
+         */
+        vb_rtd->iserrno = ivbkeyload (ihandle, ikeynumber, idirection, 1, &pskey);
+        if (vb_rtd->iserrno) {
+            break;
+        }
+        iresult = ivbdataread (ihandle, pcentry + VB_BATCHHEADER,
+                               &ideleted, pskey->trownode);
+        if (!iresult) {
+            vb_rtd->isrecnum = pskey->trownode;
+            psvbfptr->trownumber = vb_rtd->isrecnum;
+            psvbfptr->iisdisjoint = 0;
+        }
+    }
 
-    read_exit:
     psvbfptr->iisdictlocked |= 0x04;
     ivbexit (ihandle);
+    if (*pinrows) {
+        return 0;
+    }
     if(vb_rtd->iserrno == ELOCKED)
 	    return 1;
     return iresult;
@@ -482,7 +631,6 @@ isstart (int ihandle, struct keydesc *pskeydesc, int ilength, VB_CHAR *pcrow, in
     struct DICTINFO *psvbfptr;
     int             ikeynumber, iresult;
     VB_UCHAR        ckeyvalue[VB_MAX_KEYLEN];
-    VB_UCHAR        ckeyvalue2[VB_MAX_KEYLEN];
 
     if (ivbenter (ihandle, 0)) {
         return -1;
@@ -536,11 +684,10 @@ isstart (int ihandle, struct keydesc *pskeydesc, int ilength, VB_CHAR *pcrow, in
 
     case ISEQUAL:
         psvbfptr->iisdisjoint = 1;
-        vvbmakekey (psvbfptr->pskeydesc[ikeynumber], pcrow, ckeyvalue2);
-        memset (ckeyvalue, 0, sizeof (ckeyvalue));
-        memcpy (ckeyvalue, ckeyvalue2, (size_t)ilength);
+        vvbmakekey (psvbfptr->pskeydesc[ikeynumber], pcrow, ckeyvalue);
         if (ilength < pskeydesc->k_len) {
-            iresult = ivbkeysearch (ihandle, ISGTEQ, ikeynumber, 0, ckeyvalue, (off_t)0);
+            /* The first key whose leading ilength bytes are not lower */
+            iresult = ivbkeysearch (ihandle, ISGTEQ, ikeynumber, ilength, ckeyvalue, (off_t)-1);
         } else {
             iresult = ivbkeysearch (ihandle, ISEQUAL, ikeynumber, ilength, ckeyvalue, (off_t)0);
         }
@@ -552,9 +699,8 @@ isstart (int ihandle, struct keydesc *pskeydesc, int ilength, VB_CHAR *pcrow, in
         if (iresult == 1) {
             iresult = 0;
         } else if (iresult == 0
-                   && memcmp (ckeyvalue,
-                              psvbfptr->pskeycurr[psvbfptr->iactivekey]->ckey,
-                              (size_t)ilength)) {
+                   && ivbkeycompare (ihandle, psvbfptr->iactivekey, ilength, ckeyvalue,
+                                     psvbfptr->pskeycurr[psvbfptr->iactivekey]->ckey)) {
             vb_rtd->iserrno = ENOREC;
             iresult = -1;
         }
@@ -563,14 +709,9 @@ isstart (int ihandle, struct keydesc *pskeydesc, int ilength, VB_CHAR *pcrow, in
     case ISGREAT:
     case ISGTEQ:
         psvbfptr->iisdisjoint = 1;
-        vvbmakekey (psvbfptr->pskeydesc[ikeynumber], pcrow, ckeyvalue2);
-        if (ilength < pskeydesc->k_len && imode == ISGREAT) {
-            memset (ckeyvalue, 255, sizeof (ckeyvalue));
-        } else {
-            memset (ckeyvalue, 0, sizeof (ckeyvalue));
-        }
-        memcpy (ckeyvalue, ckeyvalue2, (size_t)ilength);
-        iresult = ivbkeysearch (ihandle, imode, ikeynumber, 0, ckeyvalue, (off_t)0);
+        vvbmakekey (psvbfptr->pskeydesc[ikeynumber], pcrow, ckeyvalue);
+        /* Only the leading ilength bytes take part in the search */
+        iresult = ivbkeysearch (ihandle, imode, ikeynumber, ilength, ckeyvalue, (off_t)-1);
         if (vb_rtd->iserrno == EENDFILE) {
             vb_rtd->iserrno = ENOREC;
             iresult = -1;
@@ -604,3 +745,193 @@ isstart (int ihandle, struct keydesc *pskeydesc, int ilength, VB_CHAR *pcrow, in
     ivbexit (ihandle);
     return iresult;
 }
+
+/* One key of an isreadmany () request */
+struct VBPROBE {
+    VB_UCHAR        *pckey;     /* Caller's key */
+    VB_UCHAR        *pcnormal;  /* Its normalized form, for sorting */
+    int             ilength;    /* Length of pcnormal */
+    int             iorigin;    /* Position in the caller's arrays */
+    int             ireclen;    /* Length of the row read */
+    vbisam_off_t    trownode;   /* Row found, 0 if none */
+};
+
+static int
+iprobekeycompare (const void *pvprobe1, const void *pvprobe2)
+{
+    const struct VBPROBE *psprobe1 = pvprobe1, *psprobe2 = pvprobe2;
+    int     iresult;
+
+    iresult = memcmp (psprobe1->pcnormal, psprobe2->pcnormal,
+                      (size_t)psprobe1->ilength);
+    if (iresult) {
+        return iresult;
+    }
+    return psprobe1->iorigin - psprobe2->iorigin;
+}
+
+static int
+iproberowcompare (const void *pvprobe1, const void *pvprobe2)
+{
+    const struct VBPROBE *psprobe1 = pvprobe1, *psprobe2 = pvprobe2;
+
+    if (psprobe1->trownode != psprobe2->trownode) {
+        return psprobe1->trownode < psprobe2->trownode ? -1 : 1;
+    }
+    return psprobe1->iorigin - psprobe2->iorigin;
+}
+
+/*
+ * isreadmany () looks up inkeys keys on the active index in one go, as
+ * many isread (ISEQUAL) calls would.  pckeys holds the keys back to back,
+ * each k_len bytes laid out as the key parts would be extracted from a
+ * row.  ptrownumbers [n] receives the row number matching key n, or 0 if
+ * there is none (the first duplicate wins).  If pcrows isn't NULL, row n
+ * is read into pcrows at n * isreclen (the maximum row length for a
+ * variable length table) and, if pirowlengths isn't NULL either, its
+ * length goes in pirowlengths [n] (0 when there's no row).  The keys are
+ * probed in index order so that neighbouring keys share the descent
+ * through the tree, and the rows are then read in row number order, all
+ * under a single ivbenter ().
+ * No row locks are taken and the current row is left on the last key
+ * found in index order.
+ */
+int
+isreadmany (int ihandle, int inkeys, VB_CHAR *pckeys, VB_CHAR *pcrows,
+            vbisam_off_t *ptrownumbers, int *pirowlengths)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBKEY    *pskey;
+    struct DICTINFO *psvbfptr;
+    struct keydesc  *pskeydesc = NULL;
+    struct VBPROBE  *psprobe, *psprobes = NULL;
+    VB_UCHAR        *pcnormal = NULL;
+    size_t          tstride;
+    int             ideleted, ikeynumber, iloop, iresult = -1;
+
+    if (inkeys < 0 || (inkeys && (!pckeys || !ptrownumbers))) {
+        vb_rtd->iserrno = EBADARG;
+        return -1;
+    }
+    if (ivbenter (ihandle, 0)) {
+        return -1;
+    }
+
+    psvbfptr = vb_rtd->psvbfile[ihandle];
+    ikeynumber = psvbfptr->iactivekey;
+    if (ikeynumber == -1 || !psvbfptr->pskeydesc[ikeynumber]->k_nparts) {
+        vb_rtd->iserrno = EBADKEY;
+        goto many_exit;
+    }
+    vb_rtd->iserrno = 0;
+    if (!inkeys) {
+        iresult = 0;
+        goto many_exit;
+    }
+    pskeydesc = psvbfptr->pskeydesc[ikeynumber];
+    if (psvbfptr->iopenmode & ISVARLEN) {
+        tstride = (size_t)psvbfptr->imaxrowlength;
+    } else {
+        tstride = (size_t)psvbfptr->iminrowlength;
+    }
+    psprobes = pvvbmalloc (sizeof (struct VBPROBE) * (size_t)inkeys);
+    pcnormal = pvvbmalloc ((size_t)pskeydesc->k_len * (size_t)inkeys);
+    if (!psprobes || !pcnormal) {
+        vb_rtd->iserrno = errno;
+        goto many_exit;
+    }
+
+    /* Sort the keys into index order, keeping the caller's order for ties */
+    for (iloop = 0; iloop < inkeys; iloop++) {
+        psprobe = psprobes + iloop;
+        psprobe->pckey = (VB_UCHAR *)pckeys + (size_t)iloop * pskeydesc->k_len;
+        psprobe->pcnormal = pcnormal + (size_t)iloop * pskeydesc->k_len;
+        psprobe->ilength = pskeydesc->k_len;
+        psprobe->iorigin = iloop;
+        psprobe->trownode = 0;
+        psprobe->ireclen = 0;
+        vvbkeynormalize (pskeydesc, psvbfptr->collating_sequence,
+                         psprobe->pckey, psprobe->pcnormal);
+    }
+    qsort (psprobes, (size_t)inkeys, sizeof (struct VBPROBE), iprobekeycompare);
+
+    /*
+     * Probe in that order, itreeload () starts from the current leaf when
+     * the key belongs there so only jumps between leaves descend afresh
+     */
+    for (iloop = 0; iloop < inkeys; iloop++) {
+        psprobe = psprobes + iloop;
+        if (iloop && !memcmp (psprobe->pcnormal, psprobe[-1].pcnormal,
+                              (size_t)psprobe->ilength)) {
+            psprobe->trownode = psprobe[-1].trownode;
+            continue;
+        }
+        iresult = ivbkeysearch (ihandle, ISGTEQ, ikeynumber, 0,
+                                psprobe->pckey, (off_t)0);
+        if (iresult < 0) {
+            goto many_exit;
+        }
+        if (iresult != 1) {
+            if (psvbfptr->pskeycurr[ikeynumber]->iisdummy) {
+                iresult = ivbkeyload (ihandle, ikeynumber, ISNEXT, 1, &pskey);
+                if (iresult == EENDFILE) {
+                    /* Every later key is beyond the end too */
+                    break;
+                }
+                if (iresult) {
+                    vb_rtd->iserrno = iresult;
+                    iresult = -1;
+                    goto many_exit;
+                }
+            }
+            if (ivbkeycompare (ihandle, ikeynumber, 0, psprobe->pckey,
+                               psvbfptr->pskeycurr[ikeynumber]->ckey)) {
+                continue;
+            }
+        }
+        psprobe->trownode = psvbfptr->pskeycurr[ikeynumber]->trownode;
+        vb_rtd->isrecnum = psprobe->trownode;
+        psvbfptr->trownumber = vb_rtd->isrecnum;
+        psvbfptr->trowstart = 0;
+        psvbfptr->iisdisjoint = 0;
+    }
+    vb_rtd->iserrno = 0;
+    iresult = 0;
+
+    /* Then fetch the rows in the order they lie in the data file */
+    if (pcrows) {
+        qsort (psprobes, (size_t)inkeys, sizeof (struct VBPROBE), iproberowcompare);
+    }
+    for (iloop = 0; iloop < inkeys; iloop++) {
+        psprobe = psprobes + iloop;
+        ptrownumbers[psprobe->iorigin] = psprobe->trownode;
+        if (pcrows && psprobe->trownode) {
+            if (iloop && psprobe->trownode == psprobe[-1].trownode) {
+                memcpy (pcrows + (size_t)psprobe->iorigin * tstride,
+                        pcrows + (size_t)psprobe[-1].iorigin * tstride, tstride);
+                psprobe->ireclen = psprobe[-1].ireclen;
+            } else {
+                iresult = ivbdataread (ihandle, pcrows + (size_t)psprobe->iorigin * tstride,
+                                       &ideleted, (off_t)psprobe->trownode);
+                if (iresult) {
+                    goto many_exit;
+                }
+                psprobe->ireclen = vb_rtd->isreclen;
+            }
+        }
+        if (pcrows && pirowlengths) {
+            pirowlengths[psprobe->iorigin] = psprobe->ireclen;
+        }
+    }
+
+    many_exit:
+    if (psprobes) {
+        vvbfree (psprobes, sizeof (struct VBPROBE) * (size_t)inkeys);
+    }
+    if (pcnormal) {
+        vvbfree (pcnormal, (size_t)pskeydesc->k_len * (size_t)inkeys);
+    }
+    psvbfptr->iisdictlocked |= 0x04;
+    ivbexit (ihandle);
+    return iresult;
+}
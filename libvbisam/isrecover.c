@@ -21,6 +21,10 @@
 #define NEED_VBINLINE_INT_STORE 1
 #define NEED_VBINLINE_QUAD_LOAD 1
 #include	"isinternal.h"
+#include	"isrecover.h"
+#ifndef	_WIN32
+#include	<sys/wait.h>
+#endif
 
 struct RCV_HDL {
     struct RCV_HDL  *psnext;
@@ -43,6 +47,7 @@ static struct   SLOGHDR *psvblogheader;
 static struct   RCV_HDL *psrecoverhandle[VB_MAX_FILES + 1];
 static VB_CHAR          *clclbuffer = NULL;
 static VB_CHAR          *cvbrtransbuffer = NULL;
+static int              ircvworkers = 0;            /* See issetrecoverworkers () */
 
 /* Local functions */
 
@@ -86,6 +91,7 @@ vcloseall (void)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbptr;
+    struct RCV_HDL  *psrcv;
     int     iloop;
 
     for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
@@ -93,6 +99,10 @@ vcloseall (void)
         if (psvbptr && psvbptr->iisopen == 0) {
             isclose (iloop);
         }
+        while ((psrcv = psrecoverhandle[iloop]) != NULL) {
+            psrecoverhandle[iloop] = psrcv->psnext;
+            vvbfree (psrcv, sizeof (struct RCV_HDL));
+        }
     }
 }
 
@@ -275,16 +285,50 @@ ircvcreateindex (VB_CHAR *pcbuffer)
 static int
 ircvcluster (VB_CHAR *pcbuffer)
 {
-    int ipid;
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    int     ihandle, iloop, ipid, isaveerror = 0;
+    struct keydesc  skeydesc;
 
+    ihandle = inl_ldint (pcbuffer);
     ipid = inl_ldint (psvblogheader->cpid);
     if (iignore (ipid)) {
         return 0;
     }
-/* RXW
-    fprintf (stderr, "ircvcluster not yet implemented!\n");
-*/
-    return 0;
+    ihandle = igetrcvhandle (ihandle, ipid);
+    if (ihandle == -1) {
+        return ENOTOPEN;
+    }
+    skeydesc.k_flags = inl_ldint (pcbuffer + INTSIZE);
+    skeydesc.k_nparts = inl_ldint (pcbuffer + (INTSIZE * 2));
+    pcbuffer += (INTSIZE * 4);
+    for (iloop = 0; iloop < skeydesc.k_nparts; iloop++) {
+        skeydesc.k_part[iloop].kp_start = inl_ldint (pcbuffer + (iloop * 3 * INTSIZE));
+        skeydesc.k_part[iloop].kp_leng =
+        inl_ldint (pcbuffer + INTSIZE + (iloop * 3 * INTSIZE));
+        skeydesc.k_part[iloop].kp_type =
+        inl_ldint (pcbuffer + (INTSIZE * 2) + +(iloop * 3 * INTSIZE));
+    }
+    /*
+     * The rows are put in the same order as they were the first time, so
+     * the row numbers in the records that follow still match.  The copy
+     * goes by the name the log gave it.
+     */
+    vb_rtd->iserrno = ivbfileopenlock (ihandle, 2);
+    if (vb_rtd->iserrno) {
+        return vb_rtd->iserrno;
+    }
+    vb_rtd->psvbfile[ihandle]->iopenmode |= ISEXCLLOCK;
+    if (ivbcluster (ihandle, &skeydesc,
+                    pcbuffer + (skeydesc.k_nparts * 3 * INTSIZE)) < 0) {
+        isaveerror = vb_rtd->iserrno;
+    }
+    /* iscluster () leaves the dictionary node clean but still 'locked' */
+    vb_rtd->psvbfile[ihandle]->iisdictlocked = 0;
+    /* Demote the file open lock back to SHARED */
+    vb_rtd->psvbfile[ihandle]->iopenmode &= ~ISEXCLLOCK;
+    ivbfileopenlock (ihandle, 0);
+    ivbfileopenlock (ihandle, 1);
+    return isaveerror;
 }
 
 static int
@@ -407,11 +451,12 @@ ircvfileclose (VB_CHAR *pcbuffer)
     struct RCV_HDL  *psrcv;
     int     ihandle, ipid;
 
+    /*
+     * Opens and closes are followed even in ignored transactions: the file
+     * stayed open (or closed) after a rollback all the same
+     */
     ihandle = inl_ldint (pcbuffer);
     ipid = inl_ldint (psvblogheader->cpid);
-    if (iignore (ipid)) {
-        return 0;
-    }
     psrcv = psrecoverhandle[ihandle];
     while (psrcv && psrcv->ipid != ipid) {
         psrcv = psrcv->psnext;
@@ -429,6 +474,7 @@ ircvfileclose (VB_CHAR *pcbuffer)
     if (psrcv->psnext) {
         psrcv->psnext->psprev = psrcv->psprev;
     }
+    vvbfree (psrcv, sizeof (struct RCV_HDL));
 
     return vb_rtd->iserrno;
 }
@@ -443,9 +489,7 @@ ircvfileopen (VB_CHAR *pcbuffer)
     ihandle = inl_ldint (pcbuffer);
     ivarlenflag = inl_ldint (pcbuffer + INTSIZE);
     ipid = inl_ldint (psvblogheader->cpid);
-    if (iignore (ipid)) {
-        return 0;
-    }
+    /* See ircvfileclose () */
     if (igetrcvhandle (ihandle, ipid) != -1) {
         return ENOTOPEN;    /* It was already open! */
     }
@@ -599,15 +643,692 @@ ircvupdate (VB_CHAR *pcbuffer)
     return vb_rtd->iserrno;
 }
 
+/*
+ * Everything in the log that changes a table, as opposed to starting or
+ * ending a transaction
+ */
+static int
+ircvtable (VB_CHAR *pcbuffer)
+{
+    if (!memcmp (psvblogheader->coperation, VBL_BUILD, 2)) {
+        return ircvbuild (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_CREINDEX, 2)) {
+        return ircvcreateindex (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_CLUSTER, 2)) {
+        return ircvcluster (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_DELETE, 2)) {
+        return ircvdelete (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_DELINDEX, 2)) {
+        return ircvdeleteindex (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_FILEERASE, 2)) {
+        return ircvfileerase (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_FILECLOSE, 2)) {
+        return ircvfileclose (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)) {
+        return ircvfileopen (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_INSERT, 2)) {
+        return ircvinsert (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_RENAME, 2)) {
+        return ircvfilerename (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_SETUNIQUE, 2)) {
+        return ircvsetunique (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_UNIQUEID, 2)) {
+        return ircvuniqueid (pcbuffer);
+    } else if (!memcmp (psvblogheader->coperation, VBL_UPDATE, 2)) {
+        return ircvupdate (pcbuffer);
+    }
+    return EBADFILE;
+}
+
+/*
+ * The tables already checked while following a chain of checkpoints back
+ */
+struct RCV_STAMP {
+    struct RCV_STAMP *psnext;
+    VB_CHAR cfilename[MAX_PATH_LENGTH];
+};
+
+/*
+ * Whether the tables we were given were saved at the checkpoint at
+ * tcheckpoint.  A checkpoint only stamps the tables open at the time and
+ * the ones changed since the checkpoint before it, so a table's stamp is
+ * the one in the latest checkpoint up to tcheckpoint that mentions it,
+ * found by following the chain of checkpoints back for as far as the log
+ * goes.  Every such stamp has to match the table's Dict.Trans; a table that
+ * isn't there any more can't tell us anything.  Returns -1 when they all
+ * match, otherwise the position of the checkpoint whose stamp didn't
+ */
+static off_t
+trcvstampcheck (off_t tcheckpoint)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct RCV_STAMP *psstamp, *psstamphead = NULL;
+    VB_CHAR crecord[sizeof (struct SLOGHDR) + INTSIZE + INTSIZE + MAX_PATH_LENGTH
+                    + QUADSIZE + INTSIZE];
+    VB_CHAR *pcbuffer;
+    off_t   toffset, tstamp, tfailed = -1, tprev;
+    int     ifiles, ilength, iname, iat;
+
+    pcbuffer = crecord + sizeof (struct SLOGHDR);
+    while (tfailed == -1) {
+        ilength = sizeof (struct SLOGHDR) + INTSIZE + QUADSIZE + INTSIZE;
+        if (tvbpread (vb_rtd->ivblogfilehandle, crecord, (size_t)ilength, tcheckpoint)
+            != ilength || inl_ldint (crecord) != ilength
+            || memcmp (((struct SLOGHDR *)crecord)->coperation, VBL_CHECKPOINT, 2)) {
+            break;
+        }
+        tprev = inl_ldquad (pcbuffer + INTSIZE);
+        toffset = tcheckpoint + ilength;
+        for (ifiles = inl_ldint (pcbuffer); ifiles; ifiles--) {
+            if (tvbpread (vb_rtd->ivblogfilehandle, crecord, INTSIZE, toffset) != INTSIZE) {
+                break;
+            }
+            ilength = inl_ldint (crecord);
+            if (ilength > (int)sizeof (crecord)
+                || tvbpread (vb_rtd->ivblogfilehandle, crecord, (size_t)ilength, toffset)
+                   != ilength) {
+                break;
+            }
+            toffset += ilength;
+            /* A VBL_TABLESTAMP is just the name and the Dict.Trans */
+            iat = memcmp (((struct SLOGHDR *)crecord)->coperation, VBL_FILEOPEN, 2)
+                  ? 0 : INTSIZE + INTSIZE;
+            iname = strlen ((char *)pcbuffer + iat) + 1;
+            if ((int)sizeof (struct SLOGHDR) + iat + iname + QUADSIZE + INTSIZE > ilength) {
+                break;
+            }
+            /* A later checkpoint has the say on a table it mentions too */
+            for (psstamp = psstamphead; psstamp; psstamp = psstamp->psnext) {
+                if (!strcmp ((char *)psstamp->cfilename, (char *)pcbuffer + iat)) {
+                    break;
+                }
+            }
+            if (psstamp) {
+                continue;
+            }
+            tstamp = tvbtablestamp (pcbuffer + iat);
+            if (tstamp != -1 && tstamp != inl_ldquad (pcbuffer + iat + iname)) {
+                break;
+            }
+            psstamp = pvvbmalloc (sizeof (struct RCV_STAMP));
+            if (!psstamp) {
+                break;
+            }
+            strncpy ((char *)psstamp->cfilename, (char *)pcbuffer + iat, MAX_PATH_LENGTH - 1);
+            psstamp->cfilename[MAX_PATH_LENGTH - 1] = 0;
+            psstamp->psnext = psstamphead;
+            psstamphead = psstamp;
+        }
+        if (ifiles) {
+            tfailed = tcheckpoint;
+        }
+        /* The first checkpoint links back to -1, a discarded one to nowhere */
+        if (tprev < 0 || tprev >= tcheckpoint) {
+            break;
+        }
+        tcheckpoint = tprev;
+    }
+    while (psstamphead) {
+        psstamp = psstamphead->psnext;
+        vvbfree (psstamphead, sizeof (struct RCV_STAMP));
+        psstamphead = psstamp;
+    }
+    return tfailed;
+}
+
+/*
+ * The latest checkpoint that the tables we were given were saved at (see
+ * trcvstampcheck ()).  When a stamp doesn't match, no checkpoint from there
+ * up to the one being tried can do any better.  Without such a checkpoint,
+ * it's the whole log
+ */
+static off_t
+trcvstart (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    off_t   tcheckpoint, tfailed;
+
+    tcheckpoint = tvblastcheckpoint (tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END));
+    while (tcheckpoint != -1) {
+        tfailed = trcvstampcheck (tcheckpoint);
+        if (tfailed == -1) {
+            return tcheckpoint;
+        }
+        tcheckpoint = tvblastcheckpoint (tfailed);
+    }
+    return 0;
+}
+
+#ifndef	_WIN32
+/*
+ * Parallel replay, see issetrecoverworkers ()
+ *
+ * Records for different tables never touch the same files, so the log is
+ * split up by table and each part is replayed by a worker of its own.  The
+ * workers are processes rather than threads because everything else in
+ * vbisam (the open tables, iserrno, the locks) belongs to the process.  The
+ * log is read in large chunks, and the records of each table go down a pipe
+ * to its worker, which replays them in log order just as isrecover () would.
+ * Whether a transaction is to be ignored is found in a first pass over the
+ * log, so nothing but a table's own records ever reach its worker.
+ */
+
+struct RCV_READER {
+    VB_CHAR *pcbuffer;  /* VB_RCVCHUNK bytes */
+    int     ifd;
+    size_t  tused;      /* Bytes read into pcbuffer */
+    size_t  tnext;      /* Where the next record starts in pcbuffer */
+};
+
+struct RCV_PID {
+    struct RCV_PID  *psnext;
+    int     ipid;
+    int     ibegin;     /* The open transaction's BW while scanning, or -1 */
+    int     iintrans;
+    int     iignoreme;
+};
+
+struct RCV_TABLE {
+    struct RCV_TABLE *psnext;
+    int     iworker;
+    VB_CHAR cfilename[MAX_PATH_LENGTH];
+};
+
+struct RCV_ROUTE {
+    struct RCV_ROUTE *psnext;
+    int     ipid;
+    int     ihandle;
+    int     iworker;
+};
+
+struct RCV_WORKER {
+    pid_t   tpid;       /* 0 until the worker is started */
+    int     ifd;        /* The write end of its pipe */
+    size_t  tused;
+    VB_CHAR *pcbuffer;  /* Records not yet written down the pipe */
+};
+
+/*
+ * The next whole record in the stream, or NULL at the end of it.  *pierror
+ * is EBADFILE if the stream stopped part way through a record
+ */
+static VB_CHAR *
+pcrcvnext (struct RCV_READER *psreader, int *pierror)
+{
+    ssize_t tread;
+    size_t  tlength;
+
+    while (1) {
+        if (psreader->tused - psreader->tnext >= INTSIZE) {
+            tlength = inl_ldint (psreader->pcbuffer + psreader->tnext);
+            if (tlength < sizeof (struct SLOGHDR) + INTSIZE) {
+                *pierror = EBADFILE;
+                return NULL;
+            }
+            if (psreader->tused - psreader->tnext >= tlength) {
+                psreader->tnext += tlength;
+                return psreader->pcbuffer + psreader->tnext - tlength;
+            }
+        }
+        memmove (psreader->pcbuffer, psreader->pcbuffer + psreader->tnext,
+                 psreader->tused - psreader->tnext);
+        psreader->tused -= psreader->tnext;
+        psreader->tnext = 0;
+        tread = read (psreader->ifd, psreader->pcbuffer + psreader->tused,
+                      VB_RCVCHUNK - psreader->tused);
+        if (tread < 0 && errno == EINTR) {
+            continue;
+        }
+        if (tread <= 0) {
+            if (tread < 0 || psreader->tused) {
+                *pierror = EBADFILE;
+            }
+            return NULL;
+        }
+        psreader->tused += (size_t)tread;
+    }
+}
+
+static struct RCV_PID *
+psrcvpid (struct RCV_PID **ppspidhead, const int ipid)
+{
+    struct RCV_PID  *pspid;
+
+    for (pspid = *ppspidhead; pspid; pspid = pspid->psnext) {
+        if (pspid->ipid == ipid) {
+            return pspid;
+        }
+    }
+    pspid = pvvbmalloc (sizeof (struct RCV_PID));
+    if (pspid) {
+        memset (pspid, 0, sizeof (struct RCV_PID));
+        pspid->psnext = *ppspidhead;
+        pspid->ipid = ipid;
+        pspid->ibegin = -1;
+        *ppspidhead = pspid;
+    }
+    return pspid;
+}
+
+static void
+vrcvfreepids (struct RCV_PID *pspid)
+{
+    struct RCV_PID  *psnext;
+
+    for (; pspid; pspid = psnext) {
+        psnext = pspid->psnext;
+        vvbfree (pspid, sizeof (struct RCV_PID));
+    }
+}
+
+/*
+ * The first pass: for every BW from tstart onwards, in order, whether
+ * ircvchecktrans () would have the transaction ignored.  *pirename is set if
+ * a table is renamed, which would move its records from one part to another
+ */
+static int
+ircvscan (struct RCV_READER *psreader, VB_CHAR **ppcignore, int *pisize,
+          int *pirename)
+{
+    struct RCV_PID  *pspidhead = NULL, *pspid;
+    struct SLOGHDR  *psheader;
+    VB_CHAR *pcignore = NULL, *pcnew;
+    int     ibegins = 0, isize = 0, ierror = 0;
+
+    while ((psheader = (struct SLOGHDR *)pcrcvnext (psreader, &ierror)) != NULL) {
+        if (!memcmp (psheader->coperation, VBL_RENAME, 2)) {
+            *pirename = 1;
+        }
+        if (memcmp (psheader->coperation, VBL_BEGIN, 2)
+            && memcmp (psheader->coperation, VBL_COMMIT, 2)
+            && memcmp (psheader->coperation, VBL_ROLLBACK, 2)) {
+            continue;
+        }
+        pspid = psrcvpid (&pspidhead, inl_ldint (psheader->cpid));
+        if (!pspid) {
+            ierror = EBADMEM;
+            break;
+        }
+        if (pspid->ibegin != -1) {
+            if (!memcmp (psheader->coperation, VBL_ROLLBACK, 2)
+                || (!memcmp (psheader->coperation, VBL_BEGIN, 2)
+                    && (ivbrecvmode & RECOV_VB))) {
+                pcignore[pspid->ibegin] = 1;
+            }
+            pspid->ibegin = -1;
+        }
+        if (memcmp (psheader->coperation, VBL_BEGIN, 2)) {
+            continue;
+        }
+        if (ibegins == isize) {
+            pcnew = pvvbmalloc ((size_t)(isize + 1024));
+            if (!pcnew) {
+                ierror = EBADMEM;
+                break;
+            }
+            if (pcignore) {
+                memcpy (pcnew, pcignore, (size_t)isize);
+                vvbfree (pcignore, (size_t)isize);
+            }
+            pcignore = pcnew;
+            isize += 1024;
+        }
+        pcignore[ibegins] = 0;
+        pspid->ibegin = ibegins++;
+    }
+    vrcvfreepids (pspidhead);
+    *ppcignore = pcignore;
+    *pisize = isize;
+    return ierror;
+}
+
+/*
+ * A worker: replays the records that come down the pipe.  After an error it
+ * still reads to the end, so the writes in ircvparallel () never find the
+ * pipe closed
+ */
+static int
+ircvworker (struct RCV_READER *psreader)
+{
+    VB_CHAR *pcrecord;
+    int     ierror = 0, iresult = 0;
+
+    while ((pcrecord = pcrcvnext (psreader, &iresult)) != NULL) {
+        if (ierror) {
+            continue;
+        }
+        psvblogheader = (struct SLOGHDR *)pcrecord;
+        ierror = ircvtable (pcrecord + sizeof (struct SLOGHDR));
+    }
+    vcloseall ();
+    return ierror ? ierror : iresult;
+}
+
+static int
+ircvflush (struct RCV_WORKER *psworker)
+{
+    VB_CHAR *pcbuffer = psworker->pcbuffer;
+    ssize_t twritten;
+
+    while (psworker->tused) {
+        twritten = write (psworker->ifd, pcbuffer, psworker->tused);
+        if (twritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        pcbuffer += twritten;
+        psworker->tused -= (size_t)twritten;
+    }
+    return 0;
+}
+
+static int
+ircvspawn (struct RCV_WORKER *psworkers, const int iworker, const int iworkers)
+{
+    struct RCV_READER sreader;
+    int     afd[2], iloop;
+
+    memset (&sreader, 0, sizeof (sreader));
+    sreader.pcbuffer = pvvbmalloc (VB_RCVCHUNK);
+    psworkers[iworker].pcbuffer = pvvbmalloc (VB_RCVCHUNK);
+    if (!sreader.pcbuffer || !psworkers[iworker].pcbuffer || pipe (afd)) {
+        if (sreader.pcbuffer) {
+            vvbfree (sreader.pcbuffer, VB_RCVCHUNK);
+        }
+        if (psworkers[iworker].pcbuffer) {
+            vvbfree (psworkers[iworker].pcbuffer, VB_RCVCHUNK);
+        }
+        return EBADMEM;
+    }
+    psworkers[iworker].tpid = fork ();
+    if (psworkers[iworker].tpid == 0) {
+        /* Our siblings must see the end of their pipes when we're done */
+        for (iloop = 0; iloop < iworkers; iloop++) {
+            if (psworkers[iloop].tpid > 0) {
+                close (psworkers[iloop].ifd);
+            }
+        }
+        close (afd[1]);
+        sreader.ifd = afd[0];
+        _exit (ircvworker (&sreader));
+    }
+    vvbfree (sreader.pcbuffer, VB_RCVCHUNK);
+    close (afd[0]);
+    if (psworkers[iworker].tpid == -1) {
+        psworkers[iworker].tpid = 0;
+        close (afd[1]);
+        vvbfree (psworkers[iworker].pcbuffer, VB_RCVCHUNK);
+        return EBADMEM;
+    }
+    psworkers[iworker].ifd = afd[1];
+    psworkers[iworker].tused = 0;
+    return 0;
+}
+
+/*
+ * The worker for a table, which is started when its first table turns up.
+ * Tables are dealt out to the workers in turn
+ */
+static int
+ircvroute (struct RCV_TABLE **ppstablehead, struct RCV_WORKER *psworkers,
+           const int iworkers, VB_CHAR *pcfilename, int *piworker)
+{
+    struct RCV_TABLE *pstable;
+    int     itables = 0;
+
+    for (pstable = *ppstablehead; pstable; pstable = pstable->psnext) {
+        if (!strcmp ((char *)pstable->cfilename, (char *)pcfilename)) {
+            *piworker = pstable->iworker;
+            return 0;
+        }
+        itables++;
+    }
+    if (strlen ((char *)pcfilename) >= MAX_PATH_LENGTH) {
+        return EFNAME;
+    }
+    pstable = pvvbmalloc (sizeof (struct RCV_TABLE));
+    if (!pstable) {
+        return EBADMEM;
+    }
+    pstable->iworker = itables % iworkers;
+    strcpy ((char *)pstable->cfilename, (char *)pcfilename);
+    pstable->psnext = *ppstablehead;
+    *ppstablehead = pstable;
+    *piworker = pstable->iworker;
+    if (psworkers[pstable->iworker].tpid) {
+        return 0;
+    }
+    return ircvspawn (psworkers, pstable->iworker, iworkers);
+}
+
+/*
+ * Replays the log from tstart on iworkers workers.  Returns -1 if the log
+ * can't be split up by table, so it has to be replayed by isrecover () itself
+ */
+static int
+ircvparallel (off_t tstart, const int iworkers)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct RCV_READER sreader;
+    struct RCV_WORKER *psworkers;
+    struct RCV_TABLE *pstablehead = NULL, *pstable;
+    struct RCV_ROUTE *psroutehead = NULL, *psroute, **ppsroute;
+    struct RCV_PID  *pspidhead = NULL, *pspid;
+    VB_CHAR *pcrecord, *pcbuffer, *pcignore = NULL;
+    off_t   toffset = tstart, trecord;
+    int     ibegins = 0, isize = 0, irename = 0, ierror = 0, iresult;
+    int     iloop, istatus, iworker, ilength, ihandle, ipid, iskip = 0, irestate = 0;
+
+    memset (&sreader, 0, sizeof (sreader));
+    sreader.ifd = vb_rtd->svbfile[vb_rtd->ivblogfilehandle].ihandle;
+    sreader.pcbuffer = pvvbmalloc (VB_RCVCHUNK);
+    psworkers = pvvbmalloc (sizeof (struct RCV_WORKER) * iworkers);
+    if (!sreader.pcbuffer || !psworkers) {
+        ierror = EBADMEM;
+        goto rcvparallel_exit;
+    }
+    memset (psworkers, 0, sizeof (struct RCV_WORKER) * iworkers);
+    if (tvblseek (vb_rtd->ivblogfilehandle, tstart, SEEK_SET) != tstart) {
+        ierror = EBADFILE;
+        goto rcvparallel_exit;
+    }
+    ierror = ircvscan (&sreader, &pcignore, &isize, &irename);
+    if (ierror || irename) {
+        goto rcvparallel_exit;
+    }
+    sreader.tused = sreader.tnext = 0;
+    if (tvblseek (vb_rtd->ivblogfilehandle, tstart, SEEK_SET) != tstart) {
+        ierror = EBADFILE;
+        goto rcvparallel_exit;
+    }
+    while ((pcrecord = pcrcvnext (&sreader, &ierror)) != NULL) {
+        psvblogheader = (struct SLOGHDR *)pcrecord;
+        pcbuffer = pcrecord + sizeof (struct SLOGHDR);
+        ilength = inl_ldint (pcrecord);
+        trecord = toffset;
+        toffset += ilength;
+        ipid = inl_ldint (psvblogheader->cpid);
+        if (iskip) {
+            /* See isrecover () */
+            iskip--;
+            if (!irestate || memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)) {
+                continue;
+            }
+        } else if (!memcmp (psvblogheader->coperation, VBL_CHECKPOINT, 2)) {
+            iskip = inl_ldint (pcbuffer);
+            irestate = trecord == tstart;
+            continue;
+        } else if (!memcmp (psvblogheader->coperation, VBL_BEGIN, 2)
+                   || !memcmp (psvblogheader->coperation, VBL_COMMIT, 2)
+                   || !memcmp (psvblogheader->coperation, VBL_ROLLBACK, 2)) {
+            pspid = psrcvpid (&pspidhead, ipid);
+            if (!pspid) {
+                ierror = EBADMEM;
+                break;
+            }
+            if (!memcmp (psvblogheader->coperation, VBL_BEGIN, 2)) {
+                pspid->iintrans = 1;
+                pspid->iignoreme = ibegins < isize ? pcignore[ibegins++] : 0;
+                continue;
+            }
+            if (!pspid->iintrans) {
+                ierror = EBADLOG;
+                break;
+            }
+            pspid->iintrans = 0;
+            pspid->iignoreme = 0;
+            continue;
+        }
+        /* Files are opened and closed even in ignored transactions */
+        if (memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)
+            && memcmp (psvblogheader->coperation, VBL_FILECLOSE, 2)) {
+            for (pspid = pspidhead; pspid && pspid->ipid != ipid; pspid = pspid->psnext) {
+                ;
+            }
+            if (pspid && pspid->iignoreme) {
+                continue;
+            }
+        }
+        if (!memcmp (psvblogheader->coperation, VBL_BUILD, 2)) {
+            ierror = ircvroute (&pstablehead, psworkers, iworkers,
+                                pcbuffer + (INTSIZE * 6)
+                                + (inl_ldint (pcbuffer + (INTSIZE * 4)) * 3 * INTSIZE),
+                                &iworker);
+        } else if (!memcmp (psvblogheader->coperation, VBL_FILEERASE, 2)) {
+            ierror = ircvroute (&pstablehead, psworkers, iworkers, pcbuffer, &iworker);
+        } else {
+            ihandle = inl_ldint (pcbuffer);
+            for (ppsroute = &psroutehead; *ppsroute; ppsroute = &(*ppsroute)->psnext) {
+                if ((*ppsroute)->ipid == ipid && (*ppsroute)->ihandle == ihandle) {
+                    break;
+                }
+            }
+            psroute = *ppsroute;
+            if (!memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)) {
+                ierror = ircvroute (&pstablehead, psworkers, iworkers,
+                                    pcbuffer + INTSIZE + INTSIZE, &iworker);
+                if (!ierror && !psroute) {
+                    psroute = pvvbmalloc (sizeof (struct RCV_ROUTE));
+                    if (!psroute) {
+                        ierror = EBADMEM;
+                        break;
+                    }
+                    psroute->ipid = ipid;
+                    psroute->ihandle = ihandle;
+                    psroute->iworker = iworker;
+                    psroute->psnext = psroutehead;
+                    psroutehead = psroute;
+                }
+            } else if (!psroute) {
+                ierror = ENOTOPEN;
+            } else {
+                iworker = psroute->iworker;
+                if (!memcmp (psvblogheader->coperation, VBL_FILECLOSE, 2)) {
+                    *ppsroute = psroute->psnext;
+                    vvbfree (psroute, sizeof (struct RCV_ROUTE));
+                }
+            }
+        }
+        if (ierror) {
+            break;
+        }
+        if (psworkers[iworker].tused + ilength > VB_RCVCHUNK) {
+            ierror = ircvflush (&psworkers[iworker]);
+            if (ierror) {
+                break;
+            }
+        }
+        memcpy (psworkers[iworker].pcbuffer + psworkers[iworker].tused, pcrecord,
+                (size_t)ilength);
+        psworkers[iworker].tused += ilength;
+    }
+
+    /* Let every worker finish, and keep the first error */
+    for (iloop = 0; iloop < iworkers; iloop++) {
+        if (!psworkers[iloop].tpid) {
+            continue;
+        }
+        iresult = ircvflush (&psworkers[iloop]);
+        if (!ierror) {
+            ierror = iresult;
+        }
+        close (psworkers[iloop].ifd);
+        vvbfree (psworkers[iloop].pcbuffer, VB_RCVCHUNK);
+    }
+    for (iloop = 0; iloop < iworkers; iloop++) {
+        if (!psworkers[iloop].tpid) {
+            continue;
+        }
+        while (waitpid (psworkers[iloop].tpid, &istatus, 0) == -1 && errno == EINTR) {
+            ;
+        }
+        if (!WIFEXITED (istatus)) {
+            iresult = EBADFILE;
+        } else {
+            iresult = WEXITSTATUS (istatus);
+        }
+        if (!ierror) {
+            ierror = iresult;
+        }
+    }
+
+rcvparallel_exit:
+    while ((pstable = pstablehead) != NULL) {
+        pstablehead = pstable->psnext;
+        vvbfree (pstable, sizeof (struct RCV_TABLE));
+    }
+    while ((psroute = psroutehead) != NULL) {
+        psroutehead = psroute->psnext;
+        vvbfree (psroute, sizeof (struct RCV_ROUTE));
+    }
+    vrcvfreepids (pspidhead);
+    if (pcignore) {
+        vvbfree (pcignore, (size_t)isize);
+    }
+    if (psworkers) {
+        vvbfree (psworkers, sizeof (struct RCV_WORKER) * iworkers);
+    }
+    if (sreader.pcbuffer) {
+        vvbfree (sreader.pcbuffer, VB_RCVCHUNK);
+    }
+    if (irename && !ierror) {
+        return -1;
+    }
+    return ierror;
+}
+#endif	/* _WIN32 */
+
 /* Global functions */
 
+/*
+ * Set how many workers isrecover () replays the log on, each one taking its
+ * share of the tables.  0 or 1 (the default) replays everything in the
+ * calling process.  The workers are fork ()ed and carry on running vbisam,
+ * which is only safe in a single-threaded program, so this is declared in
+ * isrecover.h rather than vbisam.h and is only for vbrecover -j.
+ */
+int
+issetrecoverworkers (int iworkers)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+    if (iworkers < 0) {
+        vb_rtd->iserrno = EBADARG;
+        return -1;
+    }
+    ircvworkers = iworkers;
+    return 0;
+}
+
 int
 isrecover ()
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     VB_CHAR *pcbuffer;
-    off_t   tlength, tlength2, toffset;
-    int iloop, isaveerror;
+    off_t   tlength, tlength2, toffset, tstart;
+    int iloop, isaveerror, iskip = 0, irestate = 0;
 
     /* Initialize by stating that *ALL* tables must be closed! */
     for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
@@ -620,9 +1341,23 @@ isrecover ()
     for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
         psrecoverhandle[iloop] = NULL;
     }
-    /* Begin by reading the header of the first transaction */
+    /*
+     * Begin by reading the header of the first transaction, or of the
+     * checkpoint the tables were saved at
+     */
     vb_rtd->iserrno = EBADFILE;
-    if (tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_SET) != 0) {
+    tstart = trcvstart ();
+#ifndef	_WIN32
+    if (ircvworkers > 1) {
+        isaveerror = ircvparallel (tstart, ircvworkers);
+        if (isaveerror != -1) {
+            vb_rtd->ivbintrans = VBNOTRANS;
+            vb_rtd->iserrno = isaveerror;
+            return isaveerror ? -1 : 0;
+        }
+    }
+#endif
+    if (tvblseek (vb_rtd->ivblogfilehandle, tstart, SEEK_SET) != tstart) {
         return -1;
     }
     cvbrtransbuffer = pvvbmalloc (MAX_BUFFER_LENGTH);
@@ -634,7 +1369,7 @@ isrecover ()
     if (tvbread (vb_rtd->ivblogfilehandle, cvbrtransbuffer, INTSIZE) != INTSIZE) {
         return 0;   /* Nothing to do if the file is empty */
     }
-    toffset = 0;
+    toffset = tstart;
     tlength = inl_ldint (cvbrtransbuffer);
     /* Now, recurse forwards */
     while (1) {
@@ -656,39 +1391,30 @@ isrecover ()
 #endif
         fflush (stdout);
 #endif	/* VBDEBUG */
-        if (!memcmp (psvblogheader->coperation, VBL_BUILD, 2)) {
-            vb_rtd->iserrno = ircvbuild (pcbuffer);
+        if (iskip) {
+            /*
+             * The files a checkpoint restates as open.  They're only news
+             * to us when we started at that checkpoint, and one erased
+             * since then doesn't matter.  The tables it stamps are closed
+             */
+            iskip--;
+            if (irestate && !memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)) {
+                ircvfileopen (pcbuffer);
+            }
+            vb_rtd->iserrno = 0;
         } else if (!memcmp (psvblogheader->coperation, VBL_BEGIN, 2)) {
             vb_rtd->iserrno = ircvbegin (pcbuffer,
                                          inl_ldint (cvbrtransbuffer + tlength - INTSIZE));
-        } else if (!memcmp (psvblogheader->coperation, VBL_CREINDEX, 2)) {
-            vb_rtd->iserrno = ircvcreateindex (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_CLUSTER, 2)) {
-            vb_rtd->iserrno = ircvcluster (pcbuffer);
+        } else if (!memcmp (psvblogheader->coperation, VBL_CHECKPOINT, 2)) {
+            iskip = inl_ldint (pcbuffer);
+            irestate = toffset == tstart;
+            vb_rtd->iserrno = 0;
         } else if (!memcmp (psvblogheader->coperation, VBL_COMMIT, 2)) {
             vb_rtd->iserrno = ircvcommit (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_DELETE, 2)) {
-            vb_rtd->iserrno = ircvdelete (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_DELINDEX, 2)) {
-            vb_rtd->iserrno = ircvdeleteindex (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_FILEERASE, 2)) {
-            vb_rtd->iserrno = ircvfileerase (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_FILECLOSE, 2)) {
-            vb_rtd->iserrno = ircvfileclose (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_FILEOPEN, 2)) {
-            vb_rtd->iserrno = ircvfileopen (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_INSERT, 2)) {
-            vb_rtd->iserrno = ircvinsert (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_RENAME, 2)) {
-            vb_rtd->iserrno = ircvfilerename (pcbuffer);
         } else if (!memcmp (psvblogheader->coperation, VBL_ROLLBACK, 2)) {
             vb_rtd->iserrno = ircvrollback ();
-        } else if (!memcmp (psvblogheader->coperation, VBL_SETUNIQUE, 2)) {
-            vb_rtd->iserrno = ircvsetunique (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_UNIQUEID, 2)) {
-            vb_rtd->iserrno = ircvuniqueid (pcbuffer);
-        } else if (!memcmp (psvblogheader->coperation, VBL_UPDATE, 2)) {
-            vb_rtd->iserrno = ircvupdate (pcbuffer);
+        } else {
+            vb_rtd->iserrno = ircvtable (pcbuffer);
         }
         if (vb_rtd->iserrno) {
             break;
@@ -706,6 +1432,7 @@ isrecover ()
         isaveerror = vb_rtd->iserrno;
     }
     vcloseall ();
+    vb_rtd->ivbintrans = VBNOTRANS;
     vb_rtd->iserrno = isaveerror;
     vvbfree (cvbrtransbuffer, MAX_BUFFER_LENGTH);
     if (vb_rtd->iserrno) {
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2003 Trevor van Bremen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1,
+ * or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; see the file COPYING.LIB.  If
+ * not, write to the Free Software Foundation, Inc., 59 Temple Place,
+ * Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef	_ISRECOVER_H
+#define	_ISRECOVER_H
+
+/*
+ * Not in vbisam.h, the workers isrecover () forks are only safe in a
+ * single-threaded program such as vbrecover
+ */
+extern int	issetrecoverworkers (int iworkers);
+
+#endif	/* _ISRECOVER_H */
@@ -122,8 +122,8 @@ irowupdate (const int ihandle, VB_CHAR *pcrow, off_t trownumber)
 			iresult = ivbkeyload (ihandle, ikeynumber, ISPREV, 1, &pskey);
 			if (!iresult) {
 				if (pskeyptr->k_flags & ISDUPS
-				    && !memcmp (pskey->ckey, ckeyvalue,
-						(size_t)pskeyptr->k_len)) {
+				    && !ivbkeycompare (ihandle, ikeynumber, 0,
+						       pskey->ckey, ckeyvalue)) {
 					tdupnumber = pskey->tdupnumber + 1;
 				}
 				psvbfptr->pskeycurr[ikeynumber] =
@@ -23,6 +23,9 @@
 #define NEED_VBINLINE_QUAD_LOAD 1
 #define NEED_VBINLINE_QUAD_STORE 1
 #include	"isinternal.h"
+#ifndef	_WIN32
+#include	<signal.h>
+#endif
 
 /* Globals */
 
@@ -57,6 +60,7 @@ vinitpiduid (void)
  *			VBL_BEGIN
  *			VBL_CREINDEX
  *			VBL_CLUSTER
+ *			VBL_CHECKPOINT
  *			VBL_COMMIT
  *			VBL_DELETE
  *			VBL_DELINDEX
@@ -67,6 +71,7 @@ vinitpiduid (void)
  *			VBL_RENAME
  *			VBL_ROLLBACK
  *			VBL_SETUNIQUE
+ *			VBL_TABLESTAMP
  *			VBL_UNIQUEID
  *			VBL_UPDATE
  * Prerequisites:
@@ -90,6 +95,241 @@ vtranshdr (const VB_CHAR *pctranstype)
     inl_stint (0, vb_rtd->psvblogheader->crfu1);    /* BUG - WTF is this? */
 }
 
+#if	HAVE_PTHREAD_CREATE
+/*
+ * Group commit state, shared by every thread of the process.  Each thread
+ * has its own descriptor for the log but they all reach the same file, so
+ * one fdatasync () makes everything any of them has written so far safe.
+ */
+static pthread_mutex_t	slogsyncmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	slogsynccond = PTHREAD_COND_INITIALIZER;
+static long	tlogsyncdevice = -1;	/* The log the values below belong to */
+static long	tlogsyncinode = -1;
+static off_t	tlogsynced = 0;		/* The log is on disk up to here */
+static int	ilogsyncing = 0;	/* 1 = An fdatasync () is under way */
+/* fcntl () locks don't keep our own threads apart, this does */
+static pthread_mutex_t	slogappendmutex = PTHREAD_MUTEX_INITIALIZER;
+#endif	/* HAVE_PTHREAD_CREATE */
+
+/*
+ * Name:
+ *	static	off_t	tlogappendlock (void);
+ * Arguments:
+ *	NONE
+ * Prerequisites:
+ *	The log file is open
+ * Returns:
+ *	-1
+ *		Ooops, some problem occurred!
+ *	OTHER
+ *		The end of the log, where our records go
+ * Problems:
+ *	None known
+ * Comments:
+ *	Nobody else can append to the log until tlogappendunlock () is called
+ */
+static off_t
+tlogappendlock (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    off_t   tappend;
+
+#if	HAVE_PTHREAD_CREATE
+    pthread_mutex_lock (&slogappendmutex);
+#endif	/* HAVE_PTHREAD_CREATE */
+    if (ivblock (vb_rtd->ivblogfilehandle, (off_t)0, (off_t)0, VBWRLCKW)) {
+#if	HAVE_PTHREAD_CREATE
+        pthread_mutex_unlock (&slogappendmutex);
+#endif	/* HAVE_PTHREAD_CREATE */
+        return -1;
+    }
+    tappend = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
+    if (tappend == -1) {
+        ivblock (vb_rtd->ivblogfilehandle, (off_t)0, (off_t)0, VBUNLOCK);
+#if	HAVE_PTHREAD_CREATE
+        pthread_mutex_unlock (&slogappendmutex);
+#endif	/* HAVE_PTHREAD_CREATE */
+    }
+    return tappend;
+}
+
+/*
+ * Name:
+ *	static	int	ilogappendunlock (void);
+ * Arguments:
+ *	NONE
+ * Prerequisites:
+ *	tlogappendlock () succeeded
+ * Returns:
+ *	0
+ *		Success
+ *	ELOGWRIT
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ */
+static int
+ilogappendunlock (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    int     iresult;
+
+    iresult = ivblock (vb_rtd->ivblogfilehandle, (off_t)0, (off_t)0, VBUNLOCK);
+#if	HAVE_PTHREAD_CREATE
+    pthread_mutex_unlock (&slogappendmutex);
+#endif	/* HAVE_PTHREAD_CREATE */
+    return iresult ? ELOGWRIT : 0;
+}
+
+/*
+ * Name:
+ *	static	int	ilogsyncfd (void);
+ * Arguments:
+ *	NONE
+ * Prerequisites:
+ *	The log file is open
+ * Returns:
+ *	0	Success
+ *	-1	Failure (errno contains more info)
+ * Problems:
+ *	None known
+ */
+static int
+ilogsyncfd (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+#if	HAVE_FDATASYNC
+    return fdatasync (vb_rtd->svbfile[vb_rtd->ivblogfilehandle].ihandle);
+#else	/* HAVE_FDATASYNC */
+    return fsync (vb_rtd->svbfile[vb_rtd->ivblogfilehandle].ihandle);
+#endif	/* HAVE_FDATASYNC */
+}
+
+/*
+ * Name:
+ *	static	int	ilogsync (off_t tend);
+ * Arguments:
+ *	off_t	tend
+ *		The end of the last record we wrote to the log
+ * Prerequisites:
+ *	The log file is open
+ * Returns:
+ *	0
+ *		Success
+ *	ELOGWRIT
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ * Comments:
+ *	Committers arriving while an fdatasync () is under way wait for it
+ *	and then check whether it already covered their records.  The first
+ *	one still uncovered syncs on behalf of all the others that have
+ *	queued up behind it in the meantime, so a burst of commits costs one
+ *	fdatasync () per batch instead of one each.  Other processes using
+ *	the same log sync their own batches.
+ */
+static int
+ilogsync (off_t tend)
+{
+#if	HAVE_PTHREAD_CREATE
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBFILE   *psfile;
+    off_t   tsyncto;
+    int     iresult;
+
+    psfile = &vb_rtd->svbfile[vb_rtd->ivblogfilehandle];
+    pthread_mutex_lock (&slogsyncmutex);
+    if (tlogsyncdevice != psfile->tdevice || tlogsyncinode != psfile->tinode) {
+        if (ilogsyncing) {
+            /* Another log is being synced, don't wait on it */
+            pthread_mutex_unlock (&slogsyncmutex);
+            return ilogsyncfd () ? ELOGWRIT : 0;
+        }
+        tlogsyncdevice = psfile->tdevice;
+        tlogsyncinode = psfile->tinode;
+        tlogsynced = 0;
+    }
+    while (ilogsyncing && tlogsynced < tend) {
+        pthread_cond_wait (&slogsynccond, &slogsyncmutex);
+    }
+    if (tlogsynced >= tend) {
+        pthread_mutex_unlock (&slogsyncmutex);
+        return 0;
+    }
+    ilogsyncing = 1;
+    pthread_mutex_unlock (&slogsyncmutex);
+    /* Whatever has been appended by now goes out with our records */
+    tsyncto = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
+    iresult = ilogsyncfd ();
+    pthread_mutex_lock (&slogsyncmutex);
+    if (!iresult && tsyncto > tlogsynced) {
+        tlogsynced = tsyncto;
+    }
+    ilogsyncing = 0;
+    pthread_cond_broadcast (&slogsynccond);
+    pthread_mutex_unlock (&slogsyncmutex);
+    return iresult ? ELOGWRIT : 0;
+#else	/* HAVE_PTHREAD_CREATE */
+    return ilogsyncfd () ? ELOGWRIT : 0;
+#endif	/* HAVE_PTHREAD_CREATE */
+}
+
+/*
+ * Name:
+ *	static	int	ilogflush (void);
+ * Arguments:
+ *	NONE
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	0
+ *		Success
+ *	ELOGWRIT
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ * Comments:
+ *	Appends every record staged in vb_rtd->pclogbuffer with a single
+ *	write.  A staged record with crfu1 set is chained back to our previous
+ *	one (see iwritetrans ()) and only now is its position in the log
+ *	known, so clastposn is filled in here and crfu1 goes back to 0.
+ */
+static int
+ilogflush (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct SLOGHDR  *psheader;
+    off_t   tappend;
+    size_t  tposn;
+
+    if (!vb_rtd->tlogbufused) {
+        return 0;
+    }
+    /* We hold the log lock, so the end of the log can't move under us */
+    tappend = tlogappendlock ();
+    if (tappend == -1) {
+        return ELOGWRIT;
+    }
+    for (tposn = 0; tposn < vb_rtd->tlogbufused;
+         tposn += inl_ldint (psheader->clength)) {
+        psheader = (struct SLOGHDR *)(vb_rtd->pclogbuffer + tposn);
+        if (inl_ldint (psheader->crfu1)) {
+            inl_stint (0, psheader->crfu1);
+            inl_stint ((int)vb_rtd->toffset, psheader->clastposn);
+            vb_rtd->toffset = tappend + tposn;
+        }
+    }
+    if (tvbpwrite (vb_rtd->ivblogfilehandle, (void *)vb_rtd->pclogbuffer,
+                   vb_rtd->tlogbufused, tappend) != (ssize_t) vb_rtd->tlogbufused) {
+        ilogappendunlock ();
+        return ELOGWRIT;
+    }
+    vb_rtd->tlogend = tappend + vb_rtd->tlogbufused;
+    vb_rtd->tlogbufused = 0;
+    return ilogappendunlock ();
+}
+
 /*
  * Name:
  *	static	int	iwritetrans (int itranslength, int irollback);
@@ -113,43 +353,83 @@ vtranshdr (const VB_CHAR *pctranstype)
  *	When we begin to support rows > 32k, the buffer is too small.
  *	In that case, we'll need to perform SEVERAL writes and this means we
  *	will need to implement a crude locking scheme to guarantee atomicity.
+ * Comments:
+ *	Within a transaction the record is only staged in vb_rtd->pclogbuffer.
+ *	It reaches the log with the rest of the transaction at iscommit () or
+ *	isrollback (), or sooner once vb_rtd->ilogbuffer bytes are waiting.
+ *	That's safe as the record of a change is only made once the data and
+ *	index files hold it, so recovery never relied on the log being ahead.
+ *	Anything else is appended straight away, after whatever was staged.
  */
 static int
 iwritetrans (int itranslength, const int irollback)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
+    VB_CHAR *pcbuffer;
+    off_t   tappend;
+    size_t  tsize;
     int     iresult;
 
     itranslength += sizeof (struct SLOGHDR) + INTSIZE;
     inl_stint (itranslength, vb_rtd->cvbtransbuffer);
     inl_stint (itranslength, vb_rtd->cvbtransbuffer + itranslength - INTSIZE);
-    iresult = ivblock (vb_rtd->ivblogfilehandle, (off_t)0, (off_t)0, VBWRLCKW);
-    if (iresult) {
-        return ELOGWRIT;
-    }
     vb_rtd->psvblogheader = (struct SLOGHDR *)vb_rtd->cvbtransbuffer;
     if (irollback) {
-        inl_stint ((int)vb_rtd->toffset, vb_rtd->psvblogheader->clastposn);
         inl_stint (vb_rtd->iprevlen, vb_rtd->psvblogheader->clastlength);
-        vb_rtd->toffset = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
-        if (vb_rtd->toffset == -1) {
-            return ELOGWRIT;
-        }
         vb_rtd->iprevlen = itranslength;
     } else {
         inl_stint (0, vb_rtd->psvblogheader->clastposn);
         inl_stint (0, vb_rtd->psvblogheader->clastlength);
-        if (tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END) == -1) {
+    }
+    if (vb_rtd->ivbintrans >= VBNEEDFLUSH && vb_rtd->ivbintrans <= VBCOMMIT
+        && itranslength <= vb_rtd->ilogbuffer) {
+        if (vb_rtd->tlogbufused + itranslength > (size_t)vb_rtd->ilogbuffer) {
+            iresult = ilogflush ();
+            if (iresult) {
+                return iresult;
+            }
+        }
+        if (vb_rtd->tlogbufsize < (size_t)vb_rtd->ilogbuffer) {
+            tsize = (size_t)vb_rtd->ilogbuffer;
+            pcbuffer = pvvbmalloc (tsize);
+            if (!pcbuffer) {
+                return ELOGWRIT;
+            }
+            if (vb_rtd->pclogbuffer) {
+                memcpy (pcbuffer, vb_rtd->pclogbuffer, vb_rtd->tlogbufused);
+                vvbfree (vb_rtd->pclogbuffer, vb_rtd->tlogbufsize);
+            }
+            vb_rtd->pclogbuffer = pcbuffer;
+            vb_rtd->tlogbufsize = tsize;
+        }
+        inl_stint (irollback, vb_rtd->psvblogheader->crfu1);
+        memcpy (vb_rtd->pclogbuffer + vb_rtd->tlogbufused, vb_rtd->cvbtransbuffer,
+                (size_t)itranslength);
+        vb_rtd->tlogbufused += itranslength;
+    } else {
+        iresult = ilogflush ();
+        if (iresult) {
+            return iresult;
+        }
+        /* We hold the log lock, so the end of the log can't move under us */
+        tappend = tlogappendlock ();
+        if (tappend == -1) {
             return ELOGWRIT;
         }
-    }
-    if (tvbwrite (vb_rtd->ivblogfilehandle, (void *)vb_rtd->cvbtransbuffer, (size_t) itranslength) !=
-        (ssize_t) itranslength) {
-        return ELOGWRIT;
-    }
-    iresult = ivblock (vb_rtd->ivblogfilehandle, (off_t)0, (off_t)0, VBUNLOCK);
-    if (iresult) {
-        return ELOGWRIT;
+        if (irollback) {
+            inl_stint ((int)vb_rtd->toffset, vb_rtd->psvblogheader->clastposn);
+            vb_rtd->toffset = tappend;
+        }
+        if (tvbpwrite (vb_rtd->ivblogfilehandle, (void *)vb_rtd->cvbtransbuffer, (size_t) itranslength,
+                       tappend) != (ssize_t) itranslength) {
+            ilogappendunlock ();
+            return ELOGWRIT;
+        }
+        vb_rtd->tlogend = tappend + itranslength;
+        iresult = ilogappendunlock ();
+        if (iresult) {
+            return iresult;
+        }
     }
     if (vb_rtd->ivbintrans == VBBEGIN) {
         vb_rtd->ivbintrans = VBNEEDFLUSH;
@@ -232,6 +512,233 @@ idemotelocks (void)
     return iresult;
 }
 
+/*
+ * A backwards (or, with tlimit set, forwards) walk through the log, which
+ * reads it a block at a time rather than with a seek and a read for every
+ * record
+ */
+struct LOGBACK {
+    VB_CHAR *pcblock;
+    size_t  tallocated;
+    size_t  tblocksize; /* How much the next read brings in */
+    off_t   tblockstart;    /* pcblock holds the log from here ... */
+    off_t   tblockend;  /* ... up to here */
+    off_t   toffset;    /* The end (forwards: start) of the next record */
+    off_t   tlimit;     /* Forwards only, where to stop */
+};
+
+/*
+ * Name:
+ *	static	void	vlogbackinit (struct LOGBACK *psback, off_t toffset);
+ * Arguments:
+ *	struct	LOGBACK	*psback
+ *		The walk to set up
+ *	off_t	toffset
+ *		The position within the logfile to begin the backwards walk
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	NOTHING
+ * Problems:
+ *	None known
+ */
+static void
+vlogbackinit (struct LOGBACK *psback, off_t toffset)
+{
+    psback->pcblock = NULL;
+    psback->tallocated = 0;
+    psback->tblocksize = 8192;
+    psback->tblockstart = 0;
+    psback->tblockend = 0;
+    psback->toffset = toffset;
+    psback->tlimit = 0;
+}
+
+/*
+ * Name:
+ *	static	void	vlogbackfree (struct LOGBACK *psback);
+ * Arguments:
+ *	struct	LOGBACK	*psback
+ *		The walk to finish
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	NOTHING
+ * Problems:
+ *	None known
+ */
+static void
+vlogbackfree (struct LOGBACK *psback)
+{
+    if (psback->pcblock) {
+        vvbfree (psback->pcblock, psback->tallocated);
+        psback->pcblock = NULL;
+    }
+}
+
+/*
+ * Name:
+ *	static	VB_CHAR	*pclogbackfetch (struct LOGBACK *psback, off_t tstart, off_t tend);
+ * Arguments:
+ *	struct	LOGBACK	*psback
+ *		The walk in progress
+ *	off_t	tstart
+ *		The first byte of the log wanted
+ *	off_t	tend
+ *		The byte after the last one wanted
+ * Prerequisites:
+ *	0 <= tstart < tend
+ * Returns:
+ *	NULL
+ *		Ooops, the log couldn't be read
+ *	OTHER
+ *		Where the wanted bytes are
+ * Problems:
+ *	None known
+ * Comments:
+ *	On a miss, reads the block of the log that ENDS with the wanted bytes,
+ *	since the walk carries on towards the start of the log, or when going
+ *	forwards the one that starts with them.  The first blocks are small so
+ *	that rolling back a short transaction stays cheap.
+ */
+static VB_CHAR *
+pclogbackfetch (struct LOGBACK *psback, off_t tstart, off_t tend)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    size_t  tlength;
+
+    if (tstart >= psback->tblockstart && tend <= psback->tblockend) {
+        return psback->pcblock + (tstart - psback->tblockstart);
+    }
+    tlength = psback->tblocksize;
+    if ((off_t)tlength < tend - tstart) {
+        tlength = (size_t)(tend - tstart);
+    }
+    if (psback->tlimit) {
+        if ((off_t)tlength > psback->tlimit - tstart) {
+            tlength = (size_t)(psback->tlimit - tstart);
+        }
+    } else if ((off_t)tlength > tend) {
+        tlength = (size_t)tend;
+    }
+    if (tlength > psback->tallocated) {
+        vlogbackfree (psback);
+        psback->pcblock = pvvbmalloc (tlength);
+        if (!psback->pcblock) {
+            psback->tallocated = 0;
+            psback->tblockend = 0;
+            return NULL;
+        }
+        psback->tallocated = tlength;
+    }
+    if (psback->tlimit) {
+        psback->tblockstart = tstart;
+    } else {
+        psback->tblockstart = tend - tlength;
+    }
+    psback->tblockend = psback->tblockstart + tlength;
+    if (tvbpread (vb_rtd->ivblogfilehandle, psback->pcblock, tlength,
+                  psback->tblockstart) != (ssize_t)tlength) {
+        psback->tblockend = psback->tblockstart;
+        return NULL;
+    }
+    if (psback->tblocksize < VB_LOGBLOCK) {
+        psback->tblocksize *= 2;
+    }
+    return psback->pcblock + (tstart - psback->tblockstart);
+}
+
+/*
+ * Name:
+ *	static	VB_CHAR	*pclogbackprev (struct LOGBACK *psback);
+ * Arguments:
+ *	struct	LOGBACK	*psback
+ *		The walk in progress
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	NULL
+ *		The start of the log was reached, or it can't be followed back
+ *	OTHER
+ *		The previous record, starting with its header
+ * Problems:
+ *	None known
+ * Comments:
+ *	The record stays valid until the next call.  Afterwards psback->toffset
+ *	is where the record starts in the log.  The length at the end of each
+ *	record is checked against the one at the start.
+ */
+static VB_CHAR *
+pclogbackprev (struct LOGBACK *psback)
+{
+    VB_CHAR *pcrecord;
+    off_t   tlength;
+
+    if (psback->toffset < (off_t)sizeof (struct SLOGHDR) + INTSIZE) {
+        return NULL;
+    }
+    pcrecord = pclogbackfetch (psback, psback->toffset - INTSIZE, psback->toffset);
+    if (!pcrecord) {
+        return NULL;
+    }
+    tlength = inl_ldint (pcrecord);
+    if (tlength < (off_t)sizeof (struct SLOGHDR) + INTSIZE || tlength > psback->toffset) {
+        return NULL;
+    }
+    pcrecord = pclogbackfetch (psback, psback->toffset - tlength, psback->toffset);
+    if (!pcrecord
+        || inl_ldint (((struct SLOGHDR *)pcrecord)->clength) != tlength) {
+        return NULL;
+    }
+    psback->toffset -= tlength;
+    return pcrecord;
+}
+
+/*
+ * Name:
+ *	static	VB_CHAR	*pclogbacknext (struct LOGBACK *psback);
+ * Arguments:
+ *	struct	LOGBACK	*psback
+ *		The walk in progress, psback->tlimit set
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	NULL
+ *		psback->tlimit was reached, or the log can't be followed
+ *	OTHER
+ *		The next record, starting with its header
+ * Problems:
+ *	None known
+ * Comments:
+ *	The forwards counterpart of pclogbackprev (), afterwards psback->toffset
+ *	is where the record ends in the log
+ */
+static VB_CHAR *
+pclogbacknext (struct LOGBACK *psback)
+{
+    VB_CHAR *pcrecord;
+    off_t   tlength;
+
+    if (psback->tlimit - psback->toffset < (off_t)sizeof (struct SLOGHDR) + INTSIZE) {
+        return NULL;
+    }
+    pcrecord = pclogbackfetch (psback, psback->toffset, psback->toffset + INTSIZE);
+    if (!pcrecord) {
+        return NULL;
+    }
+    tlength = inl_ldint (pcrecord);
+    if (tlength < (off_t)sizeof (struct SLOGHDR) + INTSIZE
+        || tlength > psback->tlimit - psback->toffset) {
+        return NULL;
+    }
+    pcrecord = pclogbackfetch (psback, psback->toffset, psback->toffset + tlength);
+    if (!pcrecord || inl_ldint (pcrecord + tlength - INTSIZE) != tlength) {
+        return NULL;
+    }
+    psback->toffset += tlength;
+    return pcrecord;
+}
+
 /*
  * Name:
  *	int	ivbrollmeback (off_t toffset, int iinrecover);
@@ -256,12 +763,13 @@ static int
 ivbrollmeback (off_t toffset, const int iinrecover)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
-    VB_CHAR *pcbuffer, *pcrow;
-    off_t   tlength, trownumber;
+    struct SLOGHDR *psheader;
+    struct LOGBACK sback;
+    VB_CHAR *pcrecord, *pcbuffer, *pcrow;
+    off_t   trownumber;
     int ierrorencountered = 0;
-    int ifoundbegin = 0;
     int ihandle, iloop;
-    int ilocalhandle[VB_MAX_FILES + 1], isavedhandle[VB_MAX_FILES + 1];
+    int ilocalhandle[VB_MAX_FILES + 1], iisours[VB_MAX_FILES + 1];
 
     for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
         if (vb_rtd->psvbfile[iloop]) {
@@ -269,251 +777,780 @@ ivbrollmeback (off_t toffset, const int iinrecover)
         } else {
             ilocalhandle[iloop] = -1;
         }
-        isavedhandle[iloop] = ilocalhandle[iloop];
-    }
-    vb_rtd->psvblogheader = (struct SLOGHDR *)(vb_rtd->cvbtransbuffer + INTSIZE);
-    pcbuffer = vb_rtd->cvbtransbuffer + INTSIZE + sizeof (struct SLOGHDR);
-    /* Begin by reading the footer of the previous transaction */
-    toffset -= INTSIZE;
-    if (tvblseek (vb_rtd->ivblogfilehandle, toffset, SEEK_SET) != toffset) {
-        return EBADFILE;
-    }
-    if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer, INTSIZE) != INTSIZE) {
-        return EBADFILE;
-    }
-    /* Now, recurse backwards */
-    while (!ifoundbegin) {
-        tlength = inl_ldint (vb_rtd->cvbtransbuffer);
-        if (!tlength) {
-            return EBADFILE;
-        }
-        toffset -= tlength;
-        /* Special case: Handle where the FIRST log entry is our BW */
-        if (toffset == -(INTSIZE)) {
-            if (tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_SET) != 0) {
-                return EBADFILE;
-            }
-            if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer + INTSIZE,
-                         tlength - INTSIZE) != tlength - INTSIZE) {
-                return EBADFILE;
-            }
-            if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_BEGIN, 2)) {
-                break;
-            }
-            return EBADFILE;
-        } else {
-            if (toffset < INTSIZE) {
-                return EBADFILE;
-            }
-            if (tvblseek (vb_rtd->ivblogfilehandle, toffset, SEEK_SET) != toffset) {
-                return EBADFILE;
-            }
-            if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer, tlength) != tlength) {
-                return EBADFILE;
-            }
+        iisours[iloop] = 0;
+    }
+    /*
+     * The records come out of their own block, so closing a file below
+     * can log a VBL_FILECLOSE through vb_rtd->cvbtransbuffer safely
+     */
+    vlogbackinit (&sback, toffset);
+    while (1) {
+        pcrecord = pclogbackprev (&sback);
+        if (!pcrecord) {
+            ierrorencountered = EBADFILE;
+            goto rollmeback_exit;
         }
+        psheader = (struct SLOGHDR *)pcrecord;
+        pcbuffer = pcrecord + sizeof (struct SLOGHDR);
         /* Is it OURS? */
-        if (inl_ldint (vb_rtd->psvblogheader->cpid) != vb_rtd->tvbpid) {
+        if (inl_ldint (psheader->cpid) != vb_rtd->tvbpid) {
             continue;
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_BEGIN, 2)) {
+        if (!memcmp (psheader->coperation, VBL_BEGIN, 2)) {
             break;
         }
         ihandle = inl_ldint (pcbuffer);
         trownumber = inl_ldquad (pcbuffer + INTSIZE);
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_FILECLOSE, 2)) {
+        if (!memcmp (psheader->coperation, VBL_FILECLOSE, 2)) {
             if (ilocalhandle[ihandle] != -1 && vb_rtd->psvbfile[ihandle]->iisopen == 0) {
-                return EBADFILE;
+                ierrorencountered = EBADFILE;
+                goto rollmeback_exit;
             }
             ilocalhandle[ihandle] =
             isopen (pcbuffer + INTSIZE + INTSIZE, ISMANULOCK + ISINOUT);
             if (ilocalhandle[ihandle] == -1) {
-                return ETOOMANY;
+                ierrorencountered = ETOOMANY;
+                goto rollmeback_exit;
             }
+            iisours[ihandle] = 1;
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_INSERT, 2)) {
+        if (!memcmp (psheader->coperation, VBL_INSERT, 2)) {
             if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
+                ierrorencountered = EBADFILE;
+                goto rollmeback_exit;
             }
             /* BUG? - Should we READ the row first and compare it? */
             if (isdelrec (ilocalhandle[ihandle], trownumber)) {
-                return vb_rtd->iserrno;
+                ierrorencountered = vb_rtd->iserrno;
+                goto rollmeback_exit;
             }
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_UPDATE, 2)) {
+        if (!memcmp (psheader->coperation, VBL_UPDATE, 2)) {
             if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
+                ierrorencountered = EBADFILE;
+                goto rollmeback_exit;
             }
             vb_rtd->isreclen = inl_ldint (pcbuffer + INTSIZE + QUADSIZE);
             pcrow = pcbuffer + INTSIZE + QUADSIZE + INTSIZE + INTSIZE;
             /* BUG? - Should we READ the row first and compare it? */
             if (isrewrec (ilocalhandle[ihandle], trownumber, pcrow)) {
-                return vb_rtd->iserrno;
+                ierrorencountered = vb_rtd->iserrno;
+                goto rollmeback_exit;
             }
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_DELETE, 2)) {
+        if (!memcmp (psheader->coperation, VBL_DELETE, 2)) {
             if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
+                ierrorencountered = EBADFILE;
+                goto rollmeback_exit;
+            }
+            vb_rtd->isreclen = inl_ldint (pcbuffer + INTSIZE + QUADSIZE);
+            pcrow = pcbuffer + INTSIZE + QUADSIZE + INTSIZE;
+            ivbenter (ilocalhandle[ihandle], 1);
+            vb_rtd->psvbfile[ilocalhandle[ihandle]]->iisdictlocked |= 0x02;
+            if (iinrecover
+                && ivbforcedataallocate (ilocalhandle[ihandle], trownumber)) {
+                ierrorencountered = EBADFILE;
+            } else {
+                if (ivbwriterow (ilocalhandle[ihandle], pcrow, trownumber)) {
+                    ierrorencountered = EDUPL;
+                    ivbdatafree (ilocalhandle[ihandle], trownumber);
+                }
+            }
+            ivbexit (ilocalhandle[ihandle]);
+        }
+        if (!memcmp (psheader->coperation, VBL_FILEOPEN, 2)) {
+            if (ilocalhandle[ihandle] == -1) {
+                ierrorencountered = EBADFILE;
+                goto rollmeback_exit;
+            }
+            /* A file the caller opened within the transaction stays open */
+            if (iisours[ihandle]) {
+                isclose (ilocalhandle[ihandle]);
+                iisours[ihandle] = 0;
+            }
+            ilocalhandle[ihandle] = -1;
+        }
+    }
+rollmeback_exit:
+    vlogbackfree (&sback);
+    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
+        if (iisours[iloop]) {
+            isclose (ilocalhandle[iloop]);
+        }
+    }
+    return ierrorencountered;
+}
+
+/*
+ * Name:
+ *	int	ivbrollmeforward (off_t toffset);
+ * Arguments:
+ *	off_t	toffset
+ *		The position within the logfile to begin the backwards scan
+ *		It is assumed that this is at a true transaction 'boundary'
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	0
+ *		Success
+ *	OTHER
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ */
+static int
+ivbrollmeforward (off_t toffset)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct SLOGHDR *psheader;
+    struct LOGBACK sback;
+    VB_CHAR *pcrecord, *pcbuffer;
+    off_t   trownumber;
+    int ierror = 0;
+    int ihandle, iloop;
+    int ilocalhandle[VB_MAX_FILES + 1], iisours[VB_MAX_FILES + 1];
+
+    vinitpiduid ();
+    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
+        if (vb_rtd->psvbfile[iloop]) {
+            ilocalhandle[iloop] = iloop;
+        } else {
+            ilocalhandle[iloop] = -1;
+        }
+        iisours[iloop] = 0;
+    }
+    vlogbackinit (&sback, toffset);
+    while (1) {
+        pcrecord = pclogbackprev (&sback);
+        if (!pcrecord) {
+            ierror = EBADFILE;
+            goto rollmeforward_exit;
+        }
+        psheader = (struct SLOGHDR *)pcrecord;
+        pcbuffer = pcrecord + sizeof (struct SLOGHDR);
+        /* Is it OURS? */
+        if (inl_ldint (psheader->cpid) != vb_rtd->tvbpid) {
+            continue;
+        }
+        if (!memcmp (psheader->coperation, VBL_BEGIN, 2)) {
+            break;
+        }
+        ihandle = inl_ldint (pcbuffer);
+        trownumber = inl_ldquad (pcbuffer + INTSIZE);
+        if (!memcmp (psheader->coperation, VBL_FILECLOSE, 2)) {
+            if (ilocalhandle[ihandle] != -1 && vb_rtd->psvbfile[ihandle]->iisopen == 0) {
+                ierror = EBADFILE;
+                goto rollmeforward_exit;
+            }
+            ilocalhandle[ihandle] =
+            isopen (pcbuffer + INTSIZE + INTSIZE, ISMANULOCK + ISINOUT);
+            if (ilocalhandle[ihandle] == -1) {
+                ierror = ETOOMANY;
+                goto rollmeforward_exit;
+            }
+            iisours[ihandle] = 1;
+        }
+        if (!memcmp (psheader->coperation, VBL_DELETE, 2)) {
+            if (ilocalhandle[ihandle] == -1) {
+                ierror = EBADFILE;
+                goto rollmeforward_exit;
+            }
+            ivbenter (ilocalhandle[ihandle], 1);
+            vb_rtd->psvbfile[ilocalhandle[ihandle]]->iisdictlocked |= 0x02;
+            /* ivbdatafree also trims the data count when it's the last row */
+            if (ivbdatafree (ilocalhandle[ihandle], trownumber)) {
+                ierror = EBADFILE;
+            }
+            ivbexit (ilocalhandle[ihandle]);
+            if (ierror) {
+                goto rollmeforward_exit;
+            }
+        }
+        if (!memcmp (psheader->coperation, VBL_FILEOPEN, 2)) {
+            if (ilocalhandle[ihandle] == -1) {
+                ierror = EBADFILE;
+                goto rollmeforward_exit;
+            }
+            /* A file the caller opened within the transaction stays open */
+            if (iisours[ihandle]) {
+                isclose (ilocalhandle[ihandle]);
+                iisours[ihandle] = 0;
+            }
+            ilocalhandle[ihandle] = -1;
+        }
+    }
+rollmeforward_exit:
+    vlogbackfree (&sback);
+    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
+        if (iisours[iloop]) {
+            isclose (ilocalhandle[iloop]);
+        }
+    }
+    return ierror;
+}
+
+/*
+ * Name:
+ *	static	int	ilogrecord (VB_CHAR *pcdest, int itranslength);
+ * Arguments:
+ *	VB_CHAR	*pcdest
+ *		Where to put the finished record
+ *	int	itranslength
+ *		The length of the record in vb_rtd->cvbtransbuffer (exluding hdr/ftr)
+ * Prerequisites:
+ *	vtranshdr () has set up the header
+ * Returns:
+ *	The full length of the record
+ * Problems:
+ *	None known
+ * Comments:
+ *	Like iwritetrans () but the record is copied out instead of written and
+ *	can't be rolled back
+ */
+static int
+ilogrecord (VB_CHAR *pcdest, int itranslength)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+    itranslength += sizeof (struct SLOGHDR) + INTSIZE;
+    inl_stint (itranslength, vb_rtd->cvbtransbuffer);
+    inl_stint (itranslength, vb_rtd->cvbtransbuffer + itranslength - INTSIZE);
+    inl_stint (0, vb_rtd->psvblogheader->clastposn);
+    inl_stint (0, vb_rtd->psvblogheader->clastlength);
+    memcpy (pcdest, vb_rtd->cvbtransbuffer, (size_t)itranslength);
+    return itranslength;
+}
+
+/*
+ * The files a checkpoint finds open, the tables changed since the previous
+ * checkpoint, and the processes it finds in the middle of a transaction,
+ * while reading the log since the previous checkpoint
+ */
+struct CKPTFILE {
+    struct CKPTFILE *psnext;
+    off_t   tstamp;     /* The table's Dict.Trans at the checkpoint */
+    int     ipid;       /* (Only for the open files) */
+    int     isynced;    /* (Only for the tables) 1 = No change since synced */
+    int     ihandle;
+    int     ivarlen;
+    VB_CHAR cfilename[MAX_PATH_LENGTH];
+};
+
+struct CKPTTRANS {
+    struct CKPTTRANS *psnext;
+    int     ipid;
+};
+
+/*
+ * Whether the process that logged ipid may still be running.  The log only
+ * keeps the low INTSIZE bytes of a pid, so any running process whose pid
+ * ends in the same bytes counts (up to the 4M pids Linux allows at most)
+ */
+static int
+ipidalive (const int ipid)
+{
+#ifdef	_WIN32
+    HANDLE  hprocess;
+    DWORD   dexitcode = 0;
+
+    hprocess = OpenProcess (PROCESS_QUERY_INFORMATION, FALSE, (DWORD)ipid);
+    if (!hprocess) {
+        return GetLastError () != ERROR_INVALID_PARAMETER;
+    }
+    GetExitCodeProcess (hprocess, &dexitcode);
+    CloseHandle (hprocess);
+    return dexitcode == STILL_ACTIVE;
+#else
+    long    tpid;
+
+    for (tpid = ipid & ((1L << (INTSIZE * 8)) - 1); tpid < 0x400000L;
+         tpid += 1L << (INTSIZE * 8)) {
+        if (tpid && (!kill ((pid_t)tpid, 0) || errno == EPERM)) {
+            return 1;
+        }
+    }
+    return 0;
+#endif
+}
+
+/*
+ * Add a table to the ones changed since the previous checkpoint, unless it's
+ * already there, in which case it needs syncing again
+ */
+static int
+ickpttable (struct CKPTFILE **ppstable, VB_CHAR *pcfilename)
+{
+    struct CKPTFILE *pstable;
+
+    for (pstable = *ppstable; pstable; pstable = pstable->psnext) {
+        if (!strncmp ((char *)pstable->cfilename, (char *)pcfilename, MAX_PATH_LENGTH - 1)) {
+            pstable->isynced = 0;
+            return 0;
+        }
+    }
+    pstable = pvvbmalloc (sizeof (struct CKPTFILE));
+    if (!pstable) {
+        return EBADMEM;
+    }
+    memset (pstable, 0, sizeof (struct CKPTFILE));
+    strncpy ((char *)pstable->cfilename, (char *)pcfilename, MAX_PATH_LENGTH - 1);
+    pstable->psnext = *ppstable;
+    *ppstable = pstable;
+    return 0;
+}
+
+/*
+ * Name:
+ *	static	int	ickptscan (off_t *ptbase, off_t toffset, off_t tend, struct CKPTFILE **ppsfile, struct CKPTFILE **ppstable, struct CKPTTRANS **ppstrans);
+ * Arguments:
+ *	off_t	*ptbase
+ *		The previous checkpoint, if any, receives any later one found
+ *	off_t	toffset
+ *		Where to start reading the log
+ *	off_t	tend
+ *		Where to stop
+ *	struct	CKPTFILE **ppsfile
+ *		Receives the files still open at tend
+ *	struct	CKPTFILE **ppstable
+ *		Receives every table changed since toffset, by name
+ *	struct	CKPTTRANS **ppstrans
+ *		Receives the transactions still running at tend
+ * Prerequisites:
+ *	Nothing past tend is still being written
+ * Returns:
+ *	0
+ *		Success
+ *	ELOGREAD
+ *		Ooops, some problem occurred!
+ *	EBADMEM
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ * Comments:
+ *	The files that the checkpoint at *ptbase restates count as opened.
+ *	The tables it stamps were synced by it, so they're only wanted again
+ *	once they've been changed since.  A scan can carry on from where an
+ *	earlier one stopped, adding to what that found.
+ */
+static int
+ickptscan (off_t *ptbase, off_t toffset, off_t tend, struct CKPTFILE **ppsfile,
+           struct CKPTFILE **ppstable, struct CKPTTRANS **ppstrans)
+{
+    struct SLOGHDR  *psheader;
+    struct CKPTFILE *psfile, **ppsprevfile;
+    struct CKPTTRANS *pstrans, **ppsprevtrans;
+    struct LOGBACK sback;
+    VB_CHAR *pcbuffer;
+    off_t   tbase = *ptbase;
+    int     ihandle, ipid, iskip = 0, iname, iresult = 0;
+
+    vlogbackinit (&sback, toffset);
+    sback.tlimit = tend;
+    while (!iresult && sback.toffset < tend) {
+        toffset = sback.toffset;
+        psheader = (struct SLOGHDR *)pclogbacknext (&sback);
+        if (!psheader) {
+            iresult = ELOGREAD;
+            break;
+        }
+        pcbuffer = (VB_CHAR *)psheader + sizeof (struct SLOGHDR);
+        /* A later checkpoint restates files that we already know about */
+        if (iskip) {
+            iskip--;
+            continue;
+        }
+        ipid = inl_ldint (psheader->cpid);
+        if (!memcmp (psheader->coperation, VBL_CHECKPOINT, 2)) {
+            if (toffset != tbase) {
+                iskip = inl_ldint (pcbuffer);
+                *ptbase = toffset;
+            }
+            continue;
+        }
+        if (!memcmp (psheader->coperation, VBL_BEGIN, 2)) {
+            pstrans = pvvbmalloc (sizeof (struct CKPTTRANS));
+            if (!pstrans) {
+                iresult = EBADMEM;
+                break;
+            }
+            pstrans->ipid = ipid;
+            pstrans->psnext = *ppstrans;
+            *ppstrans = pstrans;
+            continue;
+        }
+        if (!memcmp (psheader->coperation, VBL_COMMIT, 2)
+            || !memcmp (psheader->coperation, VBL_ROLLBACK, 2)) {
+            for (ppsprevtrans = ppstrans; *ppsprevtrans; ppsprevtrans = &(*ppsprevtrans)->psnext) {
+                if ((*ppsprevtrans)->ipid == ipid) {
+                    pstrans = *ppsprevtrans;
+                    *ppsprevtrans = pstrans->psnext;
+                    vvbfree (pstrans, sizeof (struct CKPTTRANS));
+                    break;
+                }
+            }
+            continue;
+        }
+        /* The tables changed by name, a new one is empty until it's opened */
+        if (!memcmp (psheader->coperation, VBL_BUILD, 2)) {
+            iname = (INTSIZE * 6) + (INTSIZE * 3 * inl_ldint (pcbuffer + (4 * INTSIZE)));
+            if (ickpttable (ppstable, pcbuffer + iname)) {
+                iresult = EBADMEM;
+                break;
+            }
+            continue;
+        }
+        if (!memcmp (psheader->coperation, VBL_RENAME, 2)) {
+            iname = (INTSIZE * 2) + inl_ldint (pcbuffer);
+            if (ickpttable (ppstable, pcbuffer + iname)) {
+                iresult = EBADMEM;
+                break;
             }
-            vb_rtd->isreclen = inl_ldint (pcbuffer + INTSIZE + QUADSIZE);
-            pcrow = pcbuffer + INTSIZE + QUADSIZE + INTSIZE;
-            ivbenter (ilocalhandle[ihandle], 1);
-            vb_rtd->psvbfile[ilocalhandle[ihandle]]->iisdictlocked |= 0x02;
-            if (iinrecover
-                && ivbforcedataallocate (ilocalhandle[ihandle], trownumber)) {
-                ierrorencountered = EBADFILE;
-            } else {
-                if (ivbwriterow (ilocalhandle[ihandle], pcrow, trownumber)) {
-                    ierrorencountered = EDUPL;
-                    ivbdatafree (ilocalhandle[ihandle], trownumber);
+            continue;
+        }
+        ihandle = inl_ldint (pcbuffer);
+        /* And the ones changed through a handle */
+        if (!memcmp (psheader->coperation, VBL_INSERT, 2)
+            || !memcmp (psheader->coperation, VBL_UPDATE, 2)
+            || !memcmp (psheader->coperation, VBL_DELETE, 2)
+            || !memcmp (psheader->coperation, VBL_CREINDEX, 2)
+            || !memcmp (psheader->coperation, VBL_DELINDEX, 2)
+            || !memcmp (psheader->coperation, VBL_CLUSTER, 2)
+            || !memcmp (psheader->coperation, VBL_SETUNIQUE, 2)
+            || !memcmp (psheader->coperation, VBL_UNIQUEID, 2)) {
+            for (psfile = *ppsfile; psfile; psfile = psfile->psnext) {
+                if (psfile->ipid == ipid && psfile->ihandle == ihandle) {
+                    iresult = ickpttable (ppstable, psfile->cfilename);
+                    break;
                 }
             }
-            ivbexit (ilocalhandle[ihandle]);
+            continue;
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_FILEOPEN, 2)) {
-            if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
+        if (memcmp (psheader->coperation, VBL_FILEOPEN, 2)
+            && memcmp (psheader->coperation, VBL_FILECLOSE, 2)) {
+            continue;
+        }
+        /* Either way, any earlier use of the handle by this process is over */
+        for (ppsprevfile = ppsfile; *ppsprevfile; ppsprevfile = &(*ppsprevfile)->psnext) {
+            if ((*ppsprevfile)->ipid == ipid && (*ppsprevfile)->ihandle == ihandle) {
+                psfile = *ppsprevfile;
+                *ppsprevfile = psfile->psnext;
+                vvbfree (psfile, sizeof (struct CKPTFILE));
+                break;
             }
-            isclose (ilocalhandle[ihandle]);
-            ilocalhandle[ihandle] = -1;
         }
-    }
-    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
-        if (isavedhandle[iloop] != -1 && vb_rtd->psvbfile[isavedhandle[iloop]]) {
-            isclose (isavedhandle[iloop]);
+        if (!memcmp (psheader->coperation, VBL_FILEOPEN, 2)) {
+            psfile = pvvbmalloc (sizeof (struct CKPTFILE));
+            if (!psfile) {
+                iresult = EBADMEM;
+                break;
+            }
+            psfile->ipid = ipid;
+            psfile->ihandle = ihandle;
+            psfile->ivarlen = inl_ldint (pcbuffer + INTSIZE);
+            strncpy ((char *)psfile->cfilename, (char *)pcbuffer + INTSIZE + INTSIZE,
+                     MAX_PATH_LENGTH - 1);
+            psfile->cfilename[MAX_PATH_LENGTH - 1] = 0;
+            psfile->psnext = *ppsfile;
+            *ppsfile = psfile;
         }
     }
-    return ierrorencountered;
+    vlogbackfree (&sback);
+    return iresult;
 }
 
 /*
  * Name:
- *	int	ivbrollmeforward (off_t toffset);
+ *	static	int	isynctable (VB_CHAR *pcfilename);
  * Arguments:
- *	off_t	toffset
- *		The position within the logfile to begin the backwards scan
- *		It is assumed that this is at a true transaction 'boundary'
+ *	VB_CHAR	*pcfilename
+ *		The name of the table
  * Prerequisites:
  *	NONE
  * Returns:
  *	0
+ *		Success (or the table no longer exists)
+ *	OTHER
+ *		Ooops, some problem occurred!
+ * Problems:
+ *	None known
+ * Comments:
+ *	Changes made to the table by any process are on disk afterwards.  Our
+ *	own descriptor is shared when the table is open here, so closing it
+ *	again doesn't drop our locks.
+ */
+static int
+isynctable (VB_CHAR *pcfilename)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    VB_CHAR cname[MAX_PATH_LENGTH + 5];
+    int     ihandle, iloop, iresult = 0;
+
+    for (iloop = 0; iloop < 2; iloop++) {
+        sprintf ((char *)cname, iloop ? "%s.dat" : "%s.idx", pcfilename);
+        ihandle = ivbopen (cname, O_RDONLY, 0);
+        if (ihandle < 0) {
+            continue;
+        }
+        if (fsync (vb_rtd->svbfile[ihandle].ihandle)) {
+            iresult = errno;
+        }
+        ivbclose (ihandle);
+    }
+    return iresult;
+}
+
+/*
+ * Drop what the processes that have died since left behind.  Returns ELOCKED
+ * if a running one is still in the middle of a transaction.
+ */
+static int
+ickptbusy (struct CKPTFILE **ppsfile, struct CKPTTRANS **ppstrans)
+{
+    struct CKPTFILE *psfile;
+    struct CKPTTRANS *pstrans;
+
+    while (*ppstrans) {
+        pstrans = *ppstrans;
+        if (ipidalive (pstrans->ipid)) {
+            ppstrans = &pstrans->psnext;
+            continue;
+        }
+        *ppstrans = pstrans->psnext;
+        vvbfree (pstrans, sizeof (struct CKPTTRANS));
+    }
+    while (*ppsfile) {
+        psfile = *ppsfile;
+        if (ipidalive (psfile->ipid)) {
+            ppsfile = &psfile->psnext;
+            continue;
+        }
+        *ppsfile = psfile->psnext;
+        vvbfree (psfile, sizeof (struct CKPTFILE));
+    }
+    return *ppstrans ? ELOCKED : 0;
+}
+
+/*
+ * Name:
+ *	static	int	ivbcheckpoint (int iauto, off_t *ptoffset);
+ * Arguments:
+ *	int	iauto
+ *		0
+ *			Always write the checkpoint
+ *		1
+ *			Unless there's one (or the start of the log) within the
+ *			last vb_rtd->icheckpoint bytes
+ *	off_t	*ptoffset
+ *		Receives where the checkpoint starts (if not NULL)
+ * Prerequisites:
+ *	The log file is open and we're not in a transaction
+ * Returns:
+ *	0
  *		Success
+ *	ELOCKED
+ *		Another (running) process is in the middle of a transaction
  *	OTHER
  *		Ooops, some problem occurred!
  * Problems:
  *	None known
+ * Comments:
+ *	The checkpoint is a VBL_CHECKPOINT record followed by a VBL_FILEOPEN on
+ *	behalf of every process for each file it still has open, then by a
+ *	VBL_TABLESTAMP for every other table changed since the previous
+ *	checkpoint, all in one write.  Before that, every table changed since
+ *	the previous checkpoint is synced to disk.  Each record also carries the
+ *	table's Dict.Trans, which is how isrecover () tells whether the tables
+ *	it's given were saved at this checkpoint.  A table that hasn't changed
+ *	for a while is stamped by an earlier checkpoint, so the VBL_CHECKPOINT
+ *	record holds where the previous one is for isrecover () to follow.
+ *	A process that died in the middle of a transaction (or with files open)
+ *	will never finish it, so it's left out rather than holding up every
+ *	checkpoint from then on.
+ *	The log is read and the tables synced while others go on appending to
+ *	it.  Only what they've added meanwhile is read (and its tables synced)
+ *	under the append lock, along with taking the stamps and the write.
  */
 static int
-ivbrollmeforward (off_t toffset)
+ivbcheckpoint (const int iauto, off_t *ptoffset)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
-    VB_CHAR *pcbuffer;
-    off_t   tlength, trownumber;
-    int ifoundbegin = 0;
-    int ihandle, iloop;
-    int ilocalhandle[VB_MAX_FILES + 1], isavedhandle[VB_MAX_FILES + 1];
+    struct CKPTFILE *psfile, *psfilehead = NULL, *psother, *pstablehead = NULL, **ppstable;
+    struct CKPTTRANS *pstrans, *pstranshead = NULL;
+    VB_CHAR *pcgroup = NULL, *pcbuffer;
+    off_t   tend, tscanned, tlast, tnewer;
+    size_t  tsize = 0, tgroupsize;
+    int     ifiles = 0, iresult, ilength, ilocked = 0;
 
-    vinitpiduid ();
-    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
-        if (vb_rtd->psvbfile[iloop]) {
-            ilocalhandle[iloop] = iloop;
+    iresult = ilogflush ();
+    if (iresult) {
+        return iresult;
+    }
+    /* Once we've had the lock, nobody is still writing below the end */
+    tscanned = tlogappendlock ();
+    if (tscanned == -1) {
+        return ELOGWRIT;
+    }
+    iresult = ilogappendunlock ();
+    if (iresult) {
+        return iresult;
+    }
+    tend = tscanned;
+    tlast = tvblastcheckpoint (tscanned);
+    if (iauto && tscanned - (tlast == -1 ? 0 : tlast) < vb_rtd->icheckpoint) {
+        vb_rtd->tnextcheckpoint = (tlast == -1 ? 0 : tlast) + vb_rtd->icheckpoint;
+        return 0;
+    }
+    tnewer = tlast;
+    iresult = ickptscan (&tnewer, tlast == -1 ? 0 : tlast, tscanned, &psfilehead,
+                         &pstablehead, &pstranshead);
+    if (!iresult) {
+        iresult = ickptbusy (&psfilehead, &pstranshead);
+    }
+    for (psfile = iresult ? NULL : pstablehead; psfile; psfile = psfile->psnext) {
+        iresult = isynctable (psfile->cfilename);
+        if (iresult) {
+            break;
+        }
+        psfile->isynced = 1;
+    }
+    if (!iresult) {
+        tend = tlogappendlock ();
+        if (tend == -1) {
+            tend = tscanned;
+            iresult = ELOGWRIT;
         } else {
-            ilocalhandle[iloop] = -1;
+            ilocked = 1;
         }
-        isavedhandle[iloop] = ilocalhandle[iloop];
-    }
-    vb_rtd->psvblogheader = (struct SLOGHDR *)(vb_rtd->cvbtransbuffer + INTSIZE);
-    pcbuffer = vb_rtd->cvbtransbuffer + INTSIZE + sizeof (struct SLOGHDR);
-    /* Begin by reading the footer of the previous transaction */
-    toffset -= INTSIZE;
-    if (tvblseek (vb_rtd->ivblogfilehandle, toffset, SEEK_SET) != toffset) {
-        return EBADFILE;
-    }
-    if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer, INTSIZE) != INTSIZE) {
-        return EBADFILE;
-    }
-    /* Now, recurse backwards */
-    while (!ifoundbegin) {
-        tlength = inl_ldint (vb_rtd->cvbtransbuffer);
-        if (!tlength) {
-            return EBADFILE;
-        }
-        toffset -= tlength;
-        /* Special case: Handle where the FIRST log entry is our BW */
-        if (toffset == -(INTSIZE)) {
-            if (tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_SET) != 0) {
-                return EBADFILE;
-            }
-            if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer + INTSIZE,
-                         tlength - INTSIZE) != tlength - INTSIZE) {
-                return EBADFILE;
-            }
-            if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_BEGIN, 2)) {
+    }
+    if (!iresult && tend > tscanned) {
+        iresult = ickptscan (&tnewer, tscanned, tend, &psfilehead, &pstablehead,
+                             &pstranshead);
+        if (!iresult) {
+            iresult = ickptbusy (&psfilehead, &pstranshead);
+        }
+    }
+    /* Somebody else got there first, an automatic one isn't needed now */
+    if (!iresult && tnewer != tlast) {
+        if (iauto) {
+            vb_rtd->tnextcheckpoint = tnewer + vb_rtd->icheckpoint;
+            goto checkpoint_exit;
+        }
+        tlast = tnewer;
+    }
+    /* Try again once the log has grown a little more */
+    if (iresult == ELOCKED && iauto) {
+        vb_rtd->tnextcheckpoint = tend + vb_rtd->icheckpoint / 8;
+    }
+    /* What was logged up to here must be in the tables on disk */
+    for (psfile = iresult ? NULL : pstablehead; psfile; psfile = psfile->psnext) {
+        if (!psfile->isynced) {
+            iresult = isynctable (psfile->cfilename);
+            if (iresult) {
                 break;
             }
-            return EBADFILE;
-        } else {
-            if (toffset < INTSIZE) {
-                return EBADFILE;
-            }
-            if (tvblseek (vb_rtd->ivblogfilehandle, toffset, SEEK_SET) != toffset) {
-                return EBADFILE;
+        }
+    }
+    for (psfile = iresult ? NULL : psfilehead; psfile; psfile = psfile->psnext) {
+        tsize += sizeof (struct SLOGHDR) + INTSIZE + INTSIZE + INTSIZE
+                 + strlen ((char *)psfile->cfilename) + 1 + QUADSIZE;
+        ifiles++;
+        for (psother = psfilehead; psother != psfile; psother = psother->psnext) {
+            if (!strcmp ((char *)psother->cfilename, (char *)psfile->cfilename)) {
+                break;
             }
-            if (tvbread (vb_rtd->ivblogfilehandle, vb_rtd->cvbtransbuffer, tlength) != tlength) {
-                return EBADFILE;
+        }
+        if (psother != psfile) {
+            psfile->tstamp = psother->tstamp;
+            continue;
+        }
+        psfile->tstamp = tvbtablestamp (psfile->cfilename);
+    }
+    /* The changed tables that are open were stamped above */
+    ppstable = &pstablehead;
+    while (!iresult && *ppstable) {
+        psfile = *ppstable;
+        for (psother = psfilehead; psother; psother = psother->psnext) {
+            if (!strcmp ((char *)psother->cfilename, (char *)psfile->cfilename)) {
+                break;
             }
         }
-        /* Is it OURS? */
-        if (inl_ldint (vb_rtd->psvblogheader->cpid) != vb_rtd->tvbpid) {
+        if (psother) {
+            *ppstable = psfile->psnext;
+            vvbfree (psfile, sizeof (struct CKPTFILE));
             continue;
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_BEGIN, 2)) {
-            break;
+        tsize += sizeof (struct SLOGHDR) + INTSIZE + strlen ((char *)psfile->cfilename) + 1
+                 + QUADSIZE;
+        ifiles++;
+        psfile->tstamp = tvbtablestamp (psfile->cfilename);
+        ppstable = &psfile->psnext;
+    }
+    if (!iresult) {
+        tgroupsize = tsize + sizeof (struct SLOGHDR) + INTSIZE + QUADSIZE + INTSIZE;
+        pcgroup = pvvbmalloc (tgroupsize);
+        if (!pcgroup) {
+            iresult = EBADMEM;
         }
-        ihandle = inl_ldint (pcbuffer);
-        trownumber = inl_ldquad (pcbuffer + INTSIZE);
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_FILECLOSE, 2)) {
-            if (ilocalhandle[ihandle] != -1) {
-                return EBADFILE;
-            }
-            ilocalhandle[ihandle] =
-            isopen (pcbuffer + INTSIZE + INTSIZE, ISMANULOCK + ISINOUT);
-            if (ilocalhandle[ihandle] == -1) {
-                return ETOOMANY;
-            }
+    }
+    if (!iresult) {
+        pcbuffer = vb_rtd->cvbtransbuffer + sizeof (struct SLOGHDR);
+        vtranshdr ((VB_CHAR*)VBL_CHECKPOINT);
+        inl_stint (ifiles, pcbuffer);
+        inl_stquad (tlast, pcbuffer + INTSIZE);
+        tsize = ilogrecord (pcgroup, INTSIZE + QUADSIZE);
+        for (psfile = psfilehead; psfile; psfile = psfile->psnext) {
+            vtranshdr ((VB_CHAR*)VBL_FILEOPEN);
+            inl_stint (psfile->ipid, vb_rtd->psvblogheader->cpid);
+            inl_stint (psfile->ihandle, pcbuffer);
+            inl_stint (psfile->ivarlen, pcbuffer + INTSIZE);
+            ilength = strlen ((char *)psfile->cfilename) + 1;
+            memcpy (pcbuffer + INTSIZE + INTSIZE, psfile->cfilename, (size_t)ilength);
+            inl_stquad (psfile->tstamp, pcbuffer + INTSIZE + INTSIZE + ilength);
+            tsize += ilogrecord (pcgroup + tsize, INTSIZE + INTSIZE + ilength + QUADSIZE);
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_DELETE, 2)) {
-            if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
-            }
-            ivbenter (ilocalhandle[ihandle], 1);
-            vb_rtd->psvbfile[ilocalhandle[ihandle]]->iisdictlocked |= 0x02;
-            if (trownumber ==
-                inl_ldquad (vb_rtd->psvbfile[ilocalhandle[ihandle]]->sdictnode.
-                            cdatacount)) {
-                vb_rtd->psvbfile[ilocalhandle[ihandle]]->iisdictlocked |= 0x02;
-                inl_stquad (trownumber - 1,
-                            vb_rtd->psvbfile[ilocalhandle[ihandle]]->sdictnode.
-                            cdatacount);
-            } else if (ivbdatafree (ilocalhandle[ihandle], trownumber)) {
-                ivbexit (ilocalhandle[ihandle]);
-                return EBADFILE;
-            }
-            ivbexit (ilocalhandle[ihandle]);
+        for (psfile = pstablehead; psfile; psfile = psfile->psnext) {
+            vtranshdr ((VB_CHAR*)VBL_TABLESTAMP);
+            ilength = strlen ((char *)psfile->cfilename) + 1;
+            memcpy (pcbuffer, psfile->cfilename, (size_t)ilength);
+            inl_stquad (psfile->tstamp, pcbuffer + ilength);
+            tsize += ilogrecord (pcgroup + tsize, ilength + QUADSIZE);
         }
-        if (!memcmp (vb_rtd->psvblogheader->coperation, VBL_FILEOPEN, 2)) {
-            if (ilocalhandle[ihandle] == -1) {
-                return EBADFILE;
-            }
-            isclose (ilocalhandle[ihandle]);
+        if (tvbpwrite (vb_rtd->ivblogfilehandle, (void *)pcgroup, tsize, tend) != (ssize_t)tsize) {
+            iresult = ELOGWRIT;
         }
+        vvbfree (pcgroup, tgroupsize);
     }
-    for (iloop = 0; iloop <= VB_MAX_FILES; iloop++) {
-        if (isavedhandle[iloop] != -1 && vb_rtd->psvbfile[isavedhandle[iloop]]) {
-            isclose (isavedhandle[iloop]);
+checkpoint_exit:
+    if (ilocked && ilogappendunlock () && !iresult) {
+        iresult = ELOGWRIT;
+    }
+    /* Like a commit, the checkpoint joins whoever else is syncing the log */
+    if (!iresult && tsize) {
+        iresult = ilogsync (tend + tsize);
+    }
+    if (!iresult && tsize) {
+        vb_rtd->tlogend = tend + tsize;
+        vb_rtd->tnextcheckpoint = tend + vb_rtd->icheckpoint;
+        if (ptoffset) {
+            *ptoffset = tend;
         }
     }
-    return 0;
+    while (psfilehead) {
+        psfile = psfilehead->psnext;
+        vvbfree (psfilehead, sizeof (struct CKPTFILE));
+        psfilehead = psfile;
+    }
+    while (pstablehead) {
+        psfile = pstablehead->psnext;
+        vvbfree (pstablehead, sizeof (struct CKPTFILE));
+        pstablehead = psfile;
+    }
+    while (pstranshead) {
+        pstrans = pstranshead->psnext;
+        vvbfree (pstranshead, sizeof (struct CKPTTRANS));
+        pstranshead = pstrans;
+    }
+    return iresult;
 }
 
 /* Global functions */
@@ -544,6 +1581,59 @@ isbegin (void)
         return 0;
     }
     vb_rtd->ivbintrans = VBBEGIN;   /* Just flag that we've BEGUN */
+    /*
+     * Write the BEGIN straight away: a checkpoint in another process must
+     * see the transaction before it changes any table
+     */
+    vb_rtd->iserrno = iwritebegin ();
+    if (vb_rtd->iserrno) {
+        vb_rtd->ivbintrans = VBNOTRANS;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Name:
+ *	int	ischeckpoint (vbisam_off_t *ptoffset);
+ * Arguments:
+ *	vbisam_off_t	*ptoffset
+ *		Receives the position of the checkpoint in the log (if not NULL)
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	-1	Failure (vb_rtd->iserrno contains more info)
+ *	0	Success
+ * Problems:
+ *	NONE known
+ * Comments:
+ *	Only possible while no process has a transaction under way, otherwise
+ *	this fails with ELOCKED.  A copy of the tables taken after this point
+ *	only needs the log from *ptoffset on for isrecover (), which starts at
+ *	the last checkpoint anyway.  Anything before it can be discarded.
+ */
+int
+ischeckpoint (vbisam_off_t *ptoffset)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    off_t   toffset;
+
+    if (vb_rtd->ivblogfilehandle < 0) {
+        vb_rtd->iserrno = ELOGOPEN;
+        return -1;
+    }
+    if (vb_rtd->ivbintrans) {
+        vb_rtd->iserrno = ELOCKED;
+        return -1;
+    }
+    vinitpiduid ();
+    vb_rtd->iserrno = ivbcheckpoint (0, &toffset);
+    if (vb_rtd->iserrno) {
+        return -1;
+    }
+    if (ptoffset) {
+        *ptoffset = toffset;
+    }
     return 0;
 }
 
@@ -578,9 +1668,22 @@ iscommit (void)
     }
     vinitpiduid ();
     vb_rtd->ivbintrans = VBCOMMIT;
-    if (iholdstatus != VBBEGIN) {
-        toffset = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
-        vb_rtd->iserrno = ivbrollmeforward (toffset);
+    /*
+     * ivbrollmeforward () only acts on VBL_DELETE records: it hands the
+     * data space of the rows we deleted back to the free list, which had
+     * to wait until now in case of a rollback.  The VBL_FILEOPEN and
+     * VBL_FILECLOSE records it also looks at are only there to find the
+     * handle each delete belongs to.  ivbtransdelete () sets iloggeddelete
+     * for every VBL_DELETE it logs within a transaction, so without it the
+     * backward scan would find nothing to do.  The scan reads the log, so
+     * it needs whatever we have staged on disk first.
+     */
+    if (iholdstatus != VBBEGIN && vb_rtd->iloggeddelete) {
+        vb_rtd->iserrno = ilogflush ();
+        if (!vb_rtd->iserrno) {
+            toffset = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
+            vb_rtd->iserrno = ivbrollmeforward (toffset);
+        }
     }
     for (iloop = 0; iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
         psvbptr = vb_rtd->psvbfile[iloop];
@@ -595,15 +1698,27 @@ iscommit (void)
     if (iholdstatus != VBBEGIN) {
         vtranshdr ((VB_CHAR*)VBL_COMMIT);
         iresult = iwritetrans (0, 1);
+        if (!iresult) {
+            iresult = ilogflush ();
+        }
+        if (!iresult && vb_rtd->ilogsync) {
+            iresult = ilogsync (vb_rtd->tlogend);
+        }
         if (iresult) {
             vb_rtd->iserrno = iresult;
         }
         idemotelocks ();
     }
     vb_rtd->ivbintrans = VBNOTRANS;
+    vb_rtd->iloggeddelete = 0;
     if (vb_rtd->iserrno) {
         return -1;
     }
+    /* A busy log only means trying again a little later */
+    if (vb_rtd->icheckpoint && iholdstatus != VBBEGIN
+        && vb_rtd->tlogend >= vb_rtd->tnextcheckpoint) {
+        ivbcheckpoint (1, NULL);
+    }
     return 0;
 }
 
@@ -633,11 +1748,20 @@ islogclose (void)
     }
     vb_rtd->ivbintrans = VBNOTRANS;
     if (vb_rtd->ivblogfilehandle != -1) {
+        if (ilogflush ()) {
+            iresult = ELOGWRIT;
+        }
         if (ivbclose (vb_rtd->ivblogfilehandle)) {
             iresult = errno;
         }
     }
     vb_rtd->ivblogfilehandle = -1;
+    vb_rtd->tlogbufused = 0;
+    if (vb_rtd->pclogbuffer) {
+        vvbfree (vb_rtd->pclogbuffer, vb_rtd->tlogbufsize);
+        vb_rtd->pclogbuffer = NULL;
+        vb_rtd->tlogbufsize = 0;
+    }
     return iresult;
 }
 
@@ -714,10 +1838,15 @@ isrollback (void)
         return 0;
     }
     vb_rtd->ivbintrans = VBROLLBACK;
-    toffset = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
-    /* Write out the log entry */
-    vtranshdr ((VB_CHAR*)VBL_ROLLBACK);
-    vb_rtd->iserrno = iwritetrans (0, 1);
+    vb_rtd->iloggeddelete = 0;
+    /* The backwards scan reads the log, so get our records into it */
+    vb_rtd->iserrno = ilogflush ();
+    if (!vb_rtd->iserrno) {
+        toffset = tvblseek (vb_rtd->ivblogfilehandle, (off_t)0, SEEK_END);
+        /* Write out the log entry */
+        vtranshdr ((VB_CHAR*)VBL_ROLLBACK);
+        vb_rtd->iserrno = iwritetrans (0, 1);
+    }
     if (!vb_rtd->iserrno) {
         vb_rtd->iserrno = ivbrollmeback (toffset, 0);
     }
@@ -740,6 +1869,77 @@ isrollback (void)
     return(iresult ? -1 : 0);
 }
 
+/*
+ * Name:
+ *	off_t	tvblastcheckpoint (off_t tend);
+ * Arguments:
+ *	off_t	tend
+ *		The end of the log
+ * Prerequisites:
+ *	The log file is open
+ * Returns:
+ *	-1
+ *		There is no checkpoint (or the log can't be followed back to one)
+ *	OTHER
+ *		The position of the last VBL_CHECKPOINT record in the log
+ * Problems:
+ *	None known
+ */
+off_t
+tvblastcheckpoint (off_t tend)
+{
+    struct LOGBACK sback;
+    VB_CHAR *pcrecord;
+    off_t   tcheckpoint = -1;
+
+    vlogbackinit (&sback, tend);
+    while ((pcrecord = pclogbackprev (&sback)) != NULL) {
+        if (!memcmp (((struct SLOGHDR *)pcrecord)->coperation, VBL_CHECKPOINT, 2)) {
+            tcheckpoint = sback.toffset;
+            break;
+        }
+    }
+    vlogbackfree (&sback);
+    return tcheckpoint;
+}
+
+/*
+ * Name:
+ *	off_t	tvbtablestamp (VB_CHAR *pcfilename);
+ * Arguments:
+ *	VB_CHAR	*pcfilename
+ *		The name of the table
+ * Prerequisites:
+ *	NONE
+ * Returns:
+ *	-1
+ *		The table can't be read
+ *	OTHER
+ *		The Dict.Trans of the table on disk, bumped by every change
+ * Problems:
+ *	None known
+ */
+off_t
+tvbtablestamp (VB_CHAR *pcfilename)
+{
+    struct DICTNODE sdictnode;
+    VB_CHAR cname[MAX_PATH_LENGTH + 5];
+    off_t   tstamp = -1;
+    int     ihandle;
+
+    sprintf ((char *)cname, "%s.idx", pcfilename);
+    ihandle = ivbopen (cname, O_RDONLY, 0);
+    if (ihandle < 0) {
+        return -1;
+    }
+    if (tvbpread (ihandle, (void *)&sdictnode, sizeof (struct DICTNODE), (off_t)0)
+        == sizeof (struct DICTNODE)) {
+        tstamp = inl_ldquad (sdictnode.ctransnumber);
+    }
+    ivbclose (ihandle);
+    return tstamp;
+}
+
 /*
  * Name:
  *	int	ivbtransbuild (const VB_CHAR *pcfilename, int iminrowlen, int imaxrowlen, struct keydesc *pskeydesc);
@@ -870,21 +2070,73 @@ ivbtranscreateindex (int ihandle, struct keydesc *pskeydesc)
 
 /*
  * Name:
- *	int	ivbtranscluster (void);
+ *	int	ivbtranscluster (int ihandle, struct keydesc *pskeydesc,
+ *				 const VB_CHAR *pcnewname);
  * Arguments:
- *	BUG - Unknown args
+ *	int	ihandle
+ *		An (exclusively) open VBISAM table
+ *	struct	keydesc	*pskeydesc
+ *		The index the table is being clustered on
+ *	const	VB_CHAR	*pcnewname
+ *		The name of the clustered copy about to be renamed into place
  * Prerequisites:
- *	NONE
+ *	NOT in a transaction, other than one iscluster () began itself
  * Returns:
  *	-1	Failure (vb_rtd->iserrno contains more info)
  *	0	Success
  * Problems:
- *	NONE known
+ *	Should even the first rename fail outside a transaction, the log holds
+ *	a cluster the table never had
+ * Comments:
+ *	Written before the first rename, so that a swap the log doesn't know
+ *	about never happened.  Nothing can put the old row numbers back, so
+ *	iscluster () refuses to run within a transaction of the caller's and
+ *	the record never needs chaining for rollback.  The one it begins for
+ *	an ISTRANS table is only rolled back when nothing was renamed, which
+ *	keeps isrecover () from replaying the cluster.
  */
 int
-ivbtranscluster ()
+ivbtranscluster (int ihandle, struct keydesc *pskeydesc, const VB_CHAR *pcnewname)
 {
-    /* BUG - Write ivbtranscluster */
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *psvbptr;
+    VB_CHAR *pcbuffer;
+    int ilength = 0, iloop;
+
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    if (vb_rtd->ivblogfilehandle < 0 || psvbptr->iopenmode & ISNOLOG) {
+        return 0;
+    }
+    /* Don't log transactions if we're in rollback / recover mode */
+    if (vb_rtd->ivbintrans > VBNEEDFLUSH) {
+        return 0;
+    }
+    if (psvbptr->itransyet == 0) {
+        ivbtransopen (ihandle, psvbptr->cfilename);
+    }
+    vtranshdr ((VB_CHAR*)VBL_CLUSTER);
+    pcbuffer = vb_rtd->cvbtransbuffer + sizeof (struct SLOGHDR);
+    inl_stint (ihandle, pcbuffer);
+    inl_stint (pskeydesc->k_flags, pcbuffer + INTSIZE);
+    inl_stint (pskeydesc->k_nparts, pcbuffer + (2 * INTSIZE));
+    pcbuffer += (INTSIZE * 4);
+    for (iloop = 0; iloop < pskeydesc->k_nparts; iloop++) {
+        inl_stint (pskeydesc->k_part[iloop].kp_start, pcbuffer + (iloop * 3 * INTSIZE));
+        inl_stint (pskeydesc->k_part[iloop].kp_leng,
+                   pcbuffer + INTSIZE + (iloop * 3 * INTSIZE));
+        inl_stint (pskeydesc->k_part[iloop].kp_type,
+                   pcbuffer + (INTSIZE * 2) + (iloop * 3 * INTSIZE));
+        ilength += pskeydesc->k_part[iloop].kp_leng;
+    }
+    inl_stint (ilength, pcbuffer - INTSIZE);
+    pcbuffer += (INTSIZE * 3 * (pskeydesc->k_nparts));
+    strcpy ((char*)pcbuffer, (char*)pcnewname);
+    ilength = (INTSIZE * 4) + (INTSIZE * 3 * (pskeydesc->k_nparts))
+              + strlen ((char*)pcnewname) + 1;
+    vb_rtd->iserrno = iwritetrans (ilength, 0);
+    if (vb_rtd->iserrno) {
+        return -1;
+    }
     return 0;
 }
 
@@ -940,6 +2192,10 @@ ivbtransdelete (int ihandle, off_t trownumber, int irowlength)
     if (vb_rtd->iserrno) {
         return -1;
     }
+    /* iscommit () has to come back for the row's data space */
+    if (vb_rtd->ivbintrans != VBNOTRANS) {
+        vb_rtd->iloggeddelete = 1;
+    }
     return 0;
 }
 
@@ -45,7 +45,7 @@ irowinsert (const int ihandle, VB_CHAR *pcrow_buffer, off_t trownumber)
 		iresult = ivbkeysearch (ihandle, ISGREAT, ikeynumber, 0, ckeyvalue, (off_t)0);
 		tdupnumber[ikeynumber] = 0;
 		if (iresult >= 0 && !ivbkeyload (ihandle, ikeynumber, ISPREV, 0, &pskey)
-		    && !memcmp (pskey->ckey, ckeyvalue, (size_t)pskptr->k_len)) {
+		    && !ivbkeycompare (ihandle, ikeynumber, 0, pskey->ckey, ckeyvalue)) {
 			vb_rtd->iserrno = EDUPL;
 			if (pskptr->k_flags & ISDUPS) {
 				tdupnumber[ikeynumber] = pskey->tdupnumber + 1;
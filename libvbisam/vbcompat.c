@@ -4,8 +4,6 @@
  * are not translated.
  */
 
-#define NEED_VBINLINE_INT_LOAD 1
-#define NEED_VBINLINE_QUAD_LOAD 1
 #include "isinternal.h"
 
 /* Provide the error messages for the standard CISAM error codes */
@@ -168,25 +166,6 @@ static const char *_is_errlist[] = {
  */
 
 /* Provide the newer iskeyinfo() and isdictinfo() */
-static off_t my_tcountrows(int ihandle, struct DICTINFO *fptr) {
-    off_t   tnodenumber, tdatacount;
-    int     inodeused;
-    VB_CHAR cvbnodetmp[MAX_NODE_LENGTH];
-
-    tnodenumber = inl_ldquad((VB_CHAR *)fptr->sdictnode.cdatafree);
-    tdatacount = inl_ldquad((VB_CHAR *)fptr->sdictnode.cdatacount);
-    while (tnodenumber) {
-        if (ivbblockread(ihandle, 1, tnodenumber, cvbnodetmp)) {
-            return -1;
-        }
-        inodeused = inl_ldint(cvbnodetmp);
-        inodeused -= INTSIZE + QUADSIZE;
-        tdatacount -= (inodeused / QUADSIZE);
-        tnodenumber = inl_ldquad(cvbnodetmp + INTSIZE);
-    }
-    return tdatacount;
-}
-
 int
 isdictinfo (int ihandle, struct dictinfo *psdictinfo)
 {
@@ -215,7 +194,7 @@ isdictinfo (int ihandle, struct dictinfo *psdictinfo)
         sdict.di_nkeys |= 0x80;
     sdict.di_recsize = psvbfptr->imaxrowlength;
     sdict.di_idxsize = psvbfptr->inodesize;
-    sdict.di_nrecords = my_tcountrows(ihandle, psvbfptr);
+    sdict.di_nrecords = tvbrowcount (ihandle);
     vb_rtd->isreclen = psvbfptr->iminrowlength;
     memcpy (psdictinfo, &sdict, sizeof (struct dictinfo));
     ivbexit (ihandle);
@@ -551,12 +551,12 @@ ivbdataread (const int ihandle, VB_CHAR *pcbuffer, int *pideletedrow, off_t trow
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *tvbptr;
-    off_t           tblocknumber;
     off_t           toffset; 
-    off_t           tsofar = 0;
+    ssize_t         tresult;
     int             irowlength;
+    VB_CHAR         *pcrow;
     VB_CHAR         cfooter[16];
-    VB_CHAR         cvbnodetmp[MAX_NODE_LENGTH];
+    VB_CHAR         crow[MAX_RESERVED_LENGTH];
 
     /* Sanity check - Is ihandle a currently open table? */
     if ( unlikely(ihandle < 0 || ihandle > vb_rtd->ivbmaxusedhandle) ) {
@@ -573,44 +573,27 @@ ivbdataread (const int ihandle, VB_CHAR *pcbuffer, int *pideletedrow, off_t trow
         irowlength += INTSIZE + QUADSIZE;
     }
     toffset = irowlength * (trownumber - 1);
-    tblocknumber = (toffset / tvbptr->inodesize);
-    toffset -= (tblocknumber * tvbptr->inodesize);
-    if ( ivbblockread (ihandle, 0, tblocknumber + 1,cvbnodetmp) ) {
-        return(EBADFILE);
-    }
-    /* Read in the *MINIMUM* rowlength and store it into pcbuffer */
-    while ( tsofar < tvbptr->iminrowlength ) {
-        if ( (tvbptr->iminrowlength - tsofar) < (tvbptr->inodesize - toffset) ) {
-            memcpy (pcbuffer + tsofar,cvbnodetmp + toffset,
-                    (size_t)(tvbptr->iminrowlength - tsofar));
-            toffset += tvbptr->iminrowlength - tsofar;
-            tsofar = tvbptr->iminrowlength;
-            break;
-        }
-        memcpy (pcbuffer + tsofar,cvbnodetmp + toffset, (size_t)(tvbptr->inodesize - toffset));
-        tblocknumber++;
-        tsofar += tvbptr->inodesize - toffset;
-        toffset = 0;
-        if ( ivbblockread (ihandle, 0, tblocknumber + 1,cvbnodetmp) ) {
+    pcrow = pcvbmapped (tvbptr->idatahandle, toffset, (size_t)irowlength);
+    if ( pcrow ) {
+        /* ISMMAP: Copy the row and its footer straight out of the mapping */
+        memcpy (pcbuffer, pcrow, (size_t)tvbptr->iminrowlength);
+        memcpy (cfooter, pcrow + tvbptr->iminrowlength,
+                (size_t)(irowlength - tvbptr->iminrowlength));
+        pcbuffer += tvbptr->iminrowlength;
+    } else {
+        /* Rows are contiguous, so fetch the row and its footer in one go */
+        tresult = tvbpread (tvbptr->idatahandle, crow, (size_t)irowlength, toffset);
+        if ( tresult < 0 ) {
             return(EBADFILE);
         }
-    }
-    pcbuffer += tsofar;
-    /* OK, now for the footer.  Either 1 byte or 1 + INTSIZE + QUADSIZE. */
-    while ( tsofar < irowlength ) {
-        if ( (irowlength - tsofar) <= (tvbptr->inodesize - toffset) ) {
-            memcpy (cfooter + tsofar - tvbptr->iminrowlength,cvbnodetmp + toffset,
-                    (size_t)(irowlength - tsofar));
-            break;
-        }
-        memcpy (cfooter + tsofar - tvbptr->iminrowlength,cvbnodetmp + toffset,
-                (size_t)(tvbptr->inodesize - toffset));
-        tblocknumber++;
-        tsofar += tvbptr->inodesize - toffset;
-        toffset = 0;
-        if ( ivbblockread (ihandle, 0, tblocknumber + 1,cvbnodetmp) ) {
-            return(EBADFILE);
+        /* Beyond the end of the file reads as a deleted row */
+        if ( tresult < irowlength ) {
+            memset (crow + tresult, 0, (size_t)(irowlength - tresult));
         }
+        memcpy (pcbuffer, crow, (size_t)tvbptr->iminrowlength);
+        memcpy (cfooter, crow + tvbptr->iminrowlength,
+                (size_t)(irowlength - tvbptr->iminrowlength));
+        pcbuffer += tvbptr->iminrowlength;
     }
     vb_rtd->isreclen = tvbptr->iminrowlength;
     *pideletedrow = 0;
@@ -654,9 +637,8 @@ ivbdatawrite (const int ihandle, VB_CHAR *pcbuffer, int ideletedrow, off_t trown
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *tvbptr;
     VB_CHAR         *pctemp;
-    off_t           tblocknumber, toffset, tsofar = 0;
+    off_t           toffset;
     int             irowlength;
-    VB_CHAR         cvbnodetmp[MAX_NODE_LENGTH];
     VB_CHAR         pcwritebuffer[MAX_RESERVED_LENGTH];
 
     /* Sanity check - Is ihandle a currently open table? */
@@ -707,26 +689,8 @@ ivbdatawrite (const int ihandle, VB_CHAR *pcbuffer, int ideletedrow, off_t trown
         irowlength += INTSIZE + QUADSIZE;
     }
 
-    tblocknumber = (toffset / tvbptr->inodesize);
-    toffset -= (tblocknumber * tvbptr->inodesize);
-    while ( tsofar < irowlength ) {
-        memset (cvbnodetmp, 0, MAX_NODE_LENGTH);
-        ivbblockread (ihandle, 0, tblocknumber + 1, cvbnodetmp);        /* Can fail!! */
-        if ( (irowlength - tsofar) <= (tvbptr->inodesize - toffset) ) {
-            memcpy (cvbnodetmp + toffset, pcwritebuffer + tsofar,
-                    (size_t)(irowlength - tsofar));
-            if ( ivbblockwrite (ihandle, 0, tblocknumber + 1, cvbnodetmp) ) {
-                return(EBADFILE);
-            }
-            break;
-        }
-        memcpy (cvbnodetmp + toffset, pcwritebuffer + tsofar, (size_t)(tvbptr->inodesize - toffset));
-        if ( ivbblockwrite (ihandle, 0, tblocknumber + 1, cvbnodetmp) ) {
-            return(EBADFILE);
-        }
-        tblocknumber++;
-        tsofar += tvbptr->inodesize - toffset;
-        toffset = 0;
+    if ( tvbpwrite (tvbptr->idatahandle, pcwritebuffer, (size_t)irowlength, toffset) != irowlength ) {
+        return(EBADFILE);
     }
     return(0);
 }
@@ -45,8 +45,93 @@ tvbdatacountgetnext (const int ihandle)
     return tvalue;
 }
 
+/*
+ * Count the live rows the hard way: the data count less every row number
+ * held in the data free list.  Only needed for tables built before the
+ * dictionary carried its own row count, or last changed by a version that
+ * doesn't keep it (see crowcountok).
+ */
+static off_t
+tvbrowcountwalk (const int ihandle)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *tvbptr;
+    off_t       tnodenumber, tdatacount;
+    int         ilengthused;
+    VB_CHAR     cvbnodetmp[MAX_NODE_LENGTH];
+
+    tvbptr = vb_rtd->psvbfile[ihandle];
+    tnodenumber = inl_ldquad (tvbptr->sdictnode.cdatafree);
+    tdatacount = inl_ldquad (tvbptr->sdictnode.cdatacount);
+    while (tnodenumber) {
+        vb_rtd->iserrno = ivbblockread (ihandle, 1, tnodenumber, cvbnodetmp);
+        if (vb_rtd->iserrno) {
+            return -1;
+        }
+        ilengthused = inl_ldint (cvbnodetmp);
+        tdatacount -= (ilengthused - (INTSIZE + QUADSIZE)) / QUADSIZE;
+        tnodenumber = inl_ldquad (cvbnodetmp + INTSIZE);
+    }
+    return tdatacount;
+}
+
+/*
+ * Make sure the live row count is valid.  Must be called BEFORE the data
+ * count / data free list are altered so that a table without a valid
+ * count gets it seeded from the state any later delta applies to.
+ */
+static int
+ivbrowcountseed (const int ihandle)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *tvbptr;
+    off_t       trowcount;
+
+    tvbptr = vb_rtd->psvbfile[ihandle];
+    if (tvbptr->sdictnode.crowcountok) {
+        return 0;
+    }
+    trowcount = tvbrowcountwalk (ihandle);
+    if (trowcount == (off_t)-1) {
+        return -1;
+    }
+    tvbptr->sdictnode.crowcountok = 1;
+    inl_stquad (trowcount, tvbptr->sdictnode.crowcount);
+    tvbptr->iisdictlocked |= 0x02;
+    return 0;
+}
+
+/*
+ * Adjust the (already seeded) live row count by tdelta.  Only called once
+ * the change it accounts for has succeeded.
+ */
+static void
+vvbrowcountadjust (const int ihandle, off_t tdelta)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *tvbptr;
+
+    tvbptr = vb_rtd->psvbfile[ihandle];
+    inl_stquad (inl_ldquad (tvbptr->sdictnode.crowcount) + tdelta,
+                tvbptr->sdictnode.crowcount);
+    tvbptr->iisdictlocked |= 0x02;
+}
+
 /* Global functions */
 
+off_t
+tvbrowcount (const int ihandle)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *tvbptr;
+
+    tvbptr = vb_rtd->psvbfile[ihandle];
+    if (tvbptr->sdictnode.crowcountok) {
+        return inl_ldquad (tvbptr->sdictnode.crowcount);
+    }
+    return tvbrowcountwalk (ihandle);
+}
+
 off_t
 tvbnodecountgetnext (const int ihandle)
 {
@@ -171,10 +256,14 @@ ivbdatafree (const int ihandle, off_t trownumber)
         return -1;
     }
     vb_rtd->iserrno = 0;
+    if (ivbrowcountseed (ihandle)) {
+        return vb_rtd->iserrno;
+    }
 
     if (inl_ldquad (tvbptr->sdictnode.cdatacount) == trownumber) {
         inl_stquad (trownumber - 1, tvbptr->sdictnode.cdatacount);
         tvbptr->iisdictlocked |= 0x02;
+        vvbrowcountadjust (ihandle, -1);
         return 0;
     }
 
@@ -200,6 +289,9 @@ ivbdatafree (const int ihandle, off_t trownumber)
             ilengthused += QUADSIZE;
             inl_stint (ilengthused, cvbnodetmp);
             iresult = ivbblockwrite (ihandle, 1, theadnode, cvbnodetmp);
+            if (!iresult) {
+                vvbrowcountadjust (ihandle, -1);
+            }
             return iresult;
         }
     }
@@ -221,6 +313,7 @@ ivbdatafree (const int ihandle, off_t trownumber)
     }
     inl_stquad (tnodenumber, tvbptr->sdictnode.cdatafree);
     tvbptr->iisdictlocked |= 0x02;
+    vvbrowcountadjust (ihandle, -1);
     return 0;
 }
 
@@ -264,7 +357,7 @@ tvbnodeallocate (const int ihandle)
         ilengthused = inl_ldint (cvbnodetmp);
         if (ilengthused > (INTSIZE + QUADSIZE)) {
             tvalue = inl_ldquad (cvbnodetmp + INTSIZE + QUADSIZE);
-            memcpy (cvbnodetmp + INTSIZE + QUADSIZE,
+            memmove (cvbnodetmp + INTSIZE + QUADSIZE,
                     cvbnodetmp + INTSIZE + QUADSIZE + QUADSIZE,
                     (size_t)(ilengthused - (INTSIZE + QUADSIZE + QUADSIZE)));
             ilengthused -= QUADSIZE;
@@ -303,6 +396,9 @@ tvbdataallocate (const int ihandle)
         return -1;
     }
     vb_rtd->iserrno = 0;
+    if (ivbrowcountseed (ihandle)) {
+        return -1;
+    }
 
     /* If there's *ANY* rows in the free list, use them first! */
     theadnode = inl_ldquad (tvbptr->sdictnode.cdatafree);
@@ -333,6 +429,7 @@ tvbdataallocate (const int ihandle)
                 if (vb_rtd->iserrno) {
                     return -1;
                 }
+                vvbrowcountadjust (ihandle, 1);
                 return tvalue;
             }
             /* If we're using the last entry in the node, advance */
@@ -342,6 +439,7 @@ tvbdataallocate (const int ihandle)
                 return -1;
             }
             inl_stquad (tnextnode, tvbptr->sdictnode.cdatafree);
+            vvbrowcountadjust (ihandle, 1);
             return tvalue;
         }
         /* Ummmm, this is an INTEGRITY ERROR of sorts! */
@@ -358,6 +456,9 @@ tvbdataallocate (const int ihandle)
     /* If we get here, we need to allocate a NEW row number. */
     /* Since we already hold a dictionary lock, we don't need another */
     tvalue = tvbdatacountgetnext (ihandle);
+    if (tvalue != (off_t)-1) {
+        vvbrowcountadjust (ihandle, 1);
+    }
     return tvalue;
 }
 
@@ -367,7 +468,7 @@ ivbforcedataallocate (const int ihandle, off_t trownumber)
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *tvbptr;
     off_t           theadnode, tprevnode, tnextnode;
-    int             iloop, ilengthused;
+    int             iloop, ilengthused, iresult;
     VB_CHAR	        cvbnodetmp[MAX_NODE_LENGTH];
 
     /* Sanity check - Is ihandle a currently open table? */
@@ -381,10 +482,15 @@ ivbforcedataallocate (const int ihandle, off_t trownumber)
         return -1;
     }
     vb_rtd->iserrno = 0;
+    if (ivbrowcountseed (ihandle)) {
+        return -1;
+    }
 
     /* Test 1: Is it already beyond EOF (the SIMPLE test) */
     theadnode = inl_ldquad (tvbptr->sdictnode.cdatacount);
     if (theadnode < trownumber) {
+        /* Every row up to trownumber becomes live, the gap is freed below */
+        vvbrowcountadjust (ihandle, trownumber - theadnode);
         tvbptr->iisdictlocked |= 0x02;
         inl_stquad (trownumber, tvbptr->sdictnode.cdatacount);
         theadnode++;
@@ -417,13 +523,14 @@ ivbforcedataallocate (const int ihandle, off_t trownumber)
         ilengthused = inl_ldint (cvbnodetmp);
         for (iloop = INTSIZE + QUADSIZE; iloop < ilengthused; iloop += QUADSIZE) {
             if (inl_ldquad (&cvbnodetmp[iloop]) == trownumber) {    /* Extract it */
-                memcpy (&(cvbnodetmp[iloop]), &(cvbnodetmp[iloop + QUADSIZE]),
+                /* The row count is only adjusted once the extraction sticks */
+                memmove (&(cvbnodetmp[iloop]), &(cvbnodetmp[iloop + QUADSIZE]),
                         (size_t)(ilengthused - iloop));
                 ilengthused -= QUADSIZE;
                 if (ilengthused > INTSIZE + QUADSIZE) {
                     inl_stquad ((off_t)0, &cvbnodetmp[ilengthused]);
                     inl_stint (ilengthused, cvbnodetmp);
-                    return ivbblockwrite (ihandle, 1, theadnode, cvbnodetmp);
+                    iresult = ivbblockwrite (ihandle, 1, theadnode, cvbnodetmp);
                 } else {    /* It was the last one in the node! */
                     tnextnode = inl_ldquad (&cvbnodetmp[INTSIZE]);
                     if (tprevnode) {
@@ -434,15 +541,19 @@ ivbforcedataallocate (const int ihandle, off_t trownumber)
                             return -1;
                         }
                         inl_stquad (tnextnode, &cvbnodetmp[INTSIZE]);
-                        return ivbblockwrite
+                        iresult = ivbblockwrite
                         (ihandle, 1, tprevnode, cvbnodetmp);
                     } else {
                         tvbptr->iisdictlocked |= 0x02;
                         inl_stquad (tnextnode,
                                     tvbptr->sdictnode.cdatafree);
+                        iresult = ivbnodefree (ihandle, theadnode);
                     }
-                    return ivbnodefree (ihandle, theadnode);
                 }
+                if (!iresult) {
+                    vvbrowcountadjust (ihandle, 1);
+                }
+                return iresult;
             }
         }
         tprevnode = theadnode;
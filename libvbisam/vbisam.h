@@ -93,6 +93,10 @@
     #define     ISWAIT          0x400   /* Wait for row lock */
     #define     ISLCKW          ISLOCK | ISWAIT
 
+/* Bytes per isreadbatch () entry: row number, row length, then the row itself */
+    #define     VB_BATCHHEADER          (sizeof (vbisam_off_t) + sizeof (int))
+    #define     VB_BATCHENTRY(ireclen)  (VB_BATCHHEADER + (size_t)(ireclen))
+
 /* isstart () lock modes */
     #define     ISKEEPLOCK      0x800   /* Keep rec lock in autolk mode */
 
@@ -110,6 +114,7 @@
     #define     ISVARLEN        0x10    /* Variable length rows */
     #define     ISFIXLEN        0x0     /* (Non-flag) Fixed length rows only */
     #define     ISREBUILD       0x20    /* Open for Rebuild (forget some check)*/
+    #define     ISMMAP          0x40    /* Map the files, read via the mapping */
 
 /* audit trail mode parameters */
     #define     AUDSETNAME      0       /* Set new audit trail name */
@@ -156,6 +161,24 @@ struct  dictinfo {
     vbisam_off_t        di_nrecords;/* Number of rows in data file */
 };
 
+struct  nodecacheinfo {
+    vbisam_off_t    nc_budget;  /* Bytes allowed, see issetnodecache () */
+    vbisam_off_t    nc_bytes;   /* Bytes of decoded nodes / keys retained */
+    vbisam_off_t    nc_peak;    /* Highest nc_bytes seen */
+    vbisam_off_t    nc_evictions;   /* Nodes discarded to stay in budget */
+    int             nc_nodes;   /* Decoded index nodes retained */
+    int             nc_keys;    /* Decoded keys retained */
+};
+
+struct  indexfillinfo {
+    vbisam_off_t    fi_nodes;   /* Nodes in the index */
+    vbisam_off_t    fi_leaves;  /* Of which leaf nodes */
+    vbisam_off_t    fi_bytes;   /* Bytes of keys they hold */
+    vbisam_off_t    fi_capacity;/* Bytes of keys they could hold */
+    int             fi_levels;  /* Height of the tree, 1 = root only */
+    int             fi_fill;    /* Average node fill percentage */
+};
+
 /* Possible error return values */
     #define     EDUPL           100     /* Duplicate row */
     #define     ENOTOPEN        101     /* File not open */
@@ -194,6 +217,8 @@ struct  dictinfo {
 struct DICTINFO;
 struct VBLOCK;
 struct VBTREE;
+struct VBPOOL;
+struct VBSLAB;
 struct SLOGHDR;
 #define	MAXSUBS		        32  /* Maximum number of indexes per table */
 #define	VB_MAX_FILES	    128	/* Maximum number of open VBISAM files */
@@ -206,11 +231,23 @@ struct  VBFILE {
     int             irefcount;      /* How many times we are 'open' */
     /*dev_t*/ long  tdevice;
     /*ino_t*/ long  tinode;
+    VB_CHAR         *pcmap;         /* Read only mapping of the file (ISMMAP) */
+    size_t          tmapsize;       /* Length of the mapping */
+    int             iismapped;      /* Reads are served from pcmap */
+    VB_CHAR         *pcdictmap;     /* Read only mapping of the dictionary node */
 #ifdef	_WIN32
     void*          whandle;
     VB_CHAR        *cfilename;
 #endif
 };
+/* Objects of one kind and size, handed out from malloc'ed chunks */
+struct  VBSLABPOOL {
+    struct VBSLAB   *psslab;        /* The chunks, newest first */
+    size_t          tsize;          /* Object size, rounded up for alignment */
+    int             iperslab;       /* Objects per chunk */
+    int             iunused;        /* Objects never handed out in psslab */
+    int             ilive;          /* Objects handed out and not freed */
+};
 /* Implementation limits */
 /* 64-bit versions have a maximum node length of 4096 bytes */
 /* 32-bit versions have a maximum node length of 1024 bytes */
@@ -247,7 +284,28 @@ typedef struct vb_rtd_s {
     /*VB_CHAR	        cvbnodetmp[MAX_NODE_LENGTH];*/
     int             lowiinitialized;
     struct VBLOCK	*pslockfree;
-    struct VBTREE	*pstreefree;
+    struct VBSLABPOOL slockslab;    /* Where the VBLOCKs come from */
+    struct VBPOOL	*psvbpool;      /* Block buffer pool (NULL until first used) */
+    int             ipoolsize;      /* Block buffer pool budget in bytes, 0 = off */
+    struct VBTREE	*pstreemru;     /* Retained node LRU list, newest first */
+    struct VBTREE	*pstreelru;
+    vbisam_off_t    tnodecache;     /* Retained node budget in bytes */
+    vbisam_off_t    tsortmemory;    /* Bulk index build sort budget in bytes */
+    int             ifillfactor;    /* Bulk index build node fill percentage */
+    VB_CHAR         *pclogbuffer;   /* Log records staged by the transaction */
+    size_t          tlogbufsize;
+    size_t          tlogbufused;
+    int             ilogbuffer;     /* Log staging budget in bytes, 0 = off */
+    int             ilogsync;       /* 1 = fdatasync () the log at iscommit () */
+    int             iloggeddelete;  /* 1 = The transaction deleted a row */
+    vbisam_off_t    tlogend;        /* End of our last write to the log */
+    int             icheckpoint;    /* Log bytes between checkpoints, 0 = off */
+    vbisam_off_t    tnextcheckpoint;/* Try a checkpoint once tlogend gets here */
+    vbisam_off_t    tnodebytes;     /* Bytes of decoded nodes / keys retained */
+    vbisam_off_t    tnodepeak;
+    vbisam_off_t    tnodeevictions;
+    int             inodes;         /* VBTREE retained */
+    int             ikeys;          /* VBKEY retained */
     int             vb_isinit;
 #ifdef	VBDEBUG
     int		        icurrhandle;
@@ -287,6 +345,7 @@ extern int  ischeck (const VB_CHAR *pcfile);
 extern int  iscleanup (void);
 extern int  isclose (int ihandle);
 extern int  iscluster (int ihandle, struct keydesc *pskeydesc);
+extern int  ischeckpoint (vbisam_off_t *ptoffset);
 extern int  iscommit (void);
 extern int  isdelcurr (int ihandle);
 extern int  isdelete (int ihandle, VB_CHAR *pcrow);
@@ -302,6 +361,12 @@ extern int  islogclose (void);
 extern int  islogopen (VB_CHAR *pcfilename);
 extern int  isopen (const VB_CHAR *pcfilename, int imode);
 extern int  isread (int ihandle, VB_CHAR *pcrow, int imode);
+extern int  isreadbatch (int ihandle, VB_CHAR *pcbuffer, int imaxrows,
+                         int imode, int *pinrows);
+extern int  isreadkey (int ihandle, VB_CHAR *pcrow, int imode);
+extern int  isreadmany (int ihandle, int inkeys, VB_CHAR *pckeys,
+                        VB_CHAR *pcrows, vbisam_off_t *ptrownumbers,
+                        int *pirowlengths);
 extern int  isrecover (void);
 extern int  isrelcurr (int ihandle);
 extern int  isrelease (int ihandle);
@@ -311,7 +376,14 @@ extern int  isrewcurr (int ihandle, VB_CHAR *pcrow);
 extern int  isrewrec (int ihandle, vbisam_off_t trownumber, VB_CHAR *pcrow);
 extern int  isrewrite (int ihandle, VB_CHAR *pcrow);
 extern int  isrollback (void);
+extern int  issetbuffers (int ibytes);
+extern int  issetcheckpoint (int ibytes);
+extern int  issetnodecache (int ibytes);
 extern int  issetcollate (int ihandle, VB_UCHAR *collating_sequence);
+extern int  issetfillfactor (int ipercent);
+extern int  issetlogbuffer (int ibytes);
+extern int  issetlogsync (int isync);
+extern int  issetsortmemory (int ibytes);
 extern int  issetunique (int ihandle, vbisam_off_t tuniqueid);
 extern int  isstart (int ihandle, struct keydesc *pskeydesc,
                      int ilength, VB_CHAR *pcrow, int imode);
@@ -343,6 +415,8 @@ extern void     stdecimal (dec_t *dp, VB_UCHAR *cp, int len);
 
 extern int          isdictinfo (int ihandle, struct dictinfo *psdictinfo);
 extern int          iskeyinfo (int ihandle, struct keydesc *pskeydesc, int ikeynumber);
+extern int          isnodecacheinfo (struct nodecacheinfo *psinfo);
+extern int          isindexfill (int ihandle, int ikeynumber, struct indexfillinfo *psinfo);
 extern int          iserrno (void);
 extern int          iserrio (void);
 extern vbisam_off_t isrecnum (void);
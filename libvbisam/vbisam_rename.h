@@ -28,6 +28,9 @@
 #define iswrite VBiswrite
 #define islock VBislock
 #define isread VBisread
+#define isreadbatch VBisreadbatch
+#define isreadkey VBisreadkey
+#define isreadmany VBisreadmany
 #define isrename VBisrename
 #define isclose VBisclose
 #define issetunique VBissetunique
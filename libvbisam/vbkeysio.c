@@ -24,23 +24,467 @@
 #define NEED_VBINLINE_QUAD_LOAD 1
 #include	"isinternal.h"
 
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	VB_PREFIX_SIMD 1
+#include	<immintrin.h>
+#endif
+
 /* Local functions */
 
+/*
+ * Key comparators
+ * Each one returns -1, 0 or 1 after comparing the first ilength bytes (or
+ * k_len bytes if ilength is zero) of two contiguous keys.
+ * vvbkeycompareset () picks one per index when its keydesc is set up.
+ * Only icomparenormal () honours a collating sequence.
+ */
+
+static int
+icomparegeneric (struct keydesc *pskeydesc, VB_UCHAR *pccollate, int ilength,
+                 VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    off_t       tvalue1, tvalue2;
+    int     idescbias, ipart, ilengthtocompare;
+    int     iresult = 0, ivalue1, ivalue2;
+    int     n;
+    int     lvalue1, lvalue2;
+    float       fvalue1, fvalue2;
+    double      dvalue1, dvalue2;
+
+    if (ilength == 0) {
+        ilength = pskeydesc->k_len;
+    }
+    for (ipart = 0; ilength > 0 && ipart < pskeydesc->k_nparts; ipart++) {
+        if (ilength >= pskeydesc->k_part[ipart].kp_leng) {
+            ilengthtocompare = pskeydesc->k_part[ipart].kp_leng;
+        } else {
+            ilengthtocompare = ilength;
+        }
+        ilength -= ilengthtocompare;
+        if (pskeydesc->k_part[ipart].kp_type & ISDESC) {
+            idescbias = -1;
+        } else {
+            idescbias = 1;
+        }
+        iresult = 0;
+        switch ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) & ~ISDESC) {
+            case CHARTYPE:
+
+                n = memcmp (pckey1, pckey2, (size_t)ilengthtocompare);
+                if (n < 0) {
+                    return -idescbias;
+                }
+                if (n > 0) {
+                    return idescbias;
+                }
+                pckey1 += ilengthtocompare;
+                pckey2 += ilengthtocompare;
+/*
+            while (ilengthtocompare-- && !iresult) {
+                if (*pckey1 < *pckey2) {
+                    return -idescbias;
+                }
+                if (*pckey1++ > *pckey2++) {
+                    return idescbias;
+                }
+            }
+*/
+                break;
+
+            case INTTYPE:
+                while (ilengthtocompare >= INTSIZE && !iresult) {
+                    ivalue1 = inl_ldint (pckey1);
+                    ivalue2 = inl_ldint (pckey2);
+                    if (ivalue1 < ivalue2) {
+                        return -idescbias;
+                    }
+                    if (ivalue1 > ivalue2) {
+                        return idescbias;
+                    }
+                    pckey1 += INTSIZE;
+                    pckey2 += INTSIZE;
+                    ilengthtocompare -= INTSIZE;
+                }
+                break;
+
+            case LONGTYPE:
+                while (ilengthtocompare >= LONGSIZE && !iresult) {
+                    lvalue1 = inl_ldlong (pckey1);
+                    lvalue2 = inl_ldlong (pckey2);
+                    if (lvalue1 < lvalue2) {
+                        return -idescbias;
+                    }
+                    if (lvalue1 > lvalue2) {
+                        return idescbias;
+                    }
+                    pckey1 += LONGSIZE;
+                    pckey2 += LONGSIZE;
+                    ilengthtocompare -= LONGSIZE;
+                }
+                break;
+
+            case QUADTYPE:
+                while (ilengthtocompare >= QUADSIZE && !iresult) {
+                    tvalue1 = inl_ldquad (pckey1);
+                    tvalue2 = inl_ldquad (pckey2);
+                    if (tvalue1 < tvalue2) {
+                        return -idescbias;
+                    }
+                    if (tvalue1 > tvalue2) {
+                        return idescbias;
+                    }
+                    pckey1 += QUADSIZE;
+                    pckey2 += QUADSIZE;
+                    ilengthtocompare -= QUADSIZE;
+                }
+                break;
+
+            case FLOATTYPE:
+                while (ilengthtocompare >= FLOATSIZE && !iresult) {
+                    fvalue1 = ldfloat (pckey1);
+                    fvalue2 = ldfloat (pckey2);
+                    if (fvalue1 < fvalue2) {
+                        return -idescbias;
+                    }
+                    if (fvalue1 > fvalue2) {
+                        return idescbias;
+                    }
+                    pckey1 += FLOATSIZE;
+                    pckey2 += FLOATSIZE;
+                    ilengthtocompare -= FLOATSIZE;
+                }
+                break;
+
+            case DOUBLETYPE:
+                while (ilengthtocompare >= DOUBLESIZE && !iresult) {
+                    dvalue1 = lddbl (pckey1);
+                    dvalue2 = lddbl (pckey2);
+                    if (dvalue1 < dvalue2) {
+                        return -idescbias;
+                    }
+                    if (dvalue1 > dvalue2) {
+                        return idescbias;
+                    }
+                    pckey1 += DOUBLESIZE;
+                    pckey2 += DOUBLESIZE;
+                    ilengthtocompare -= DOUBLESIZE;
+                }
+                break;
+
+            default:
+#ifdef	VBDEBUG
+                fprintf (stderr, "HUGE ERROR! File %s, Line %d itype %d\n", __FILE__,
+                         __LINE__, pskeydesc->k_part[ipart].kp_type);
+                exit (1);
+#else
+                break;
+#endif
+        }
+    }
+    return 0;
+}
+
+static VB_INLINE int
+icomparetail (int ilength, VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    int     n;
+
+    if (ilength <= 0) {
+        return 0;
+    }
+    n = memcmp (pckey1, pckey2, (size_t)ilength);
+    if (n < 0) {
+        return -1;
+    }
+    if (n > 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Any key, compared through its normalized form */
+static int
+icomparenormal (struct keydesc *pskeydesc, VB_UCHAR *pccollate, int ilength,
+                VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    VB_UCHAR    cnormal1[VB_MAX_KEYLEN], cnormal2[VB_MAX_KEYLEN];
+
+    vvbkeynormalize (pskeydesc, pccollate, pckey1, cnormal1);
+    vvbkeynormalize (pskeydesc, pccollate, pckey2, cnormal2);
+    return icomparetail (ivbkeynormlength (pskeydesc, ilength), cnormal1, cnormal2);
+}
+
+/* All parts are ascending CHARTYPE: the key is just a string of bytes */
+static int
+icomparechar (struct keydesc *pskeydesc, VB_UCHAR *pccollate, int ilength,
+              VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    if (ilength == 0 || ilength > pskeydesc->k_len) {
+        ilength = pskeydesc->k_len;
+    }
+    return icomparetail (ilength, pckey1, pckey2);
+}
+
+/* One ascending LONGTYPE followed by zero or more ascending CHARTYPE parts */
+static int
+icomparelongchar (struct keydesc *pskeydesc, VB_UCHAR *pccollate, int ilength,
+                  VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    int     lvalue1, lvalue2;
+
+    if (ilength == 0 || ilength > pskeydesc->k_len) {
+        ilength = pskeydesc->k_len;
+    }
+    if (ilength < LONGSIZE) {
+        return 0;
+    }
+    lvalue1 = inl_ldlong (pckey1);
+    lvalue2 = inl_ldlong (pckey2);
+    if (lvalue1 < lvalue2) {
+        return -1;
+    }
+    if (lvalue1 > lvalue2) {
+        return 1;
+    }
+    return icomparetail (ilength - LONGSIZE, pckey1 + LONGSIZE,
+                         pckey2 + LONGSIZE);
+}
+
+/* One ascending QUADTYPE followed by zero or more ascending CHARTYPE parts */
+static int
+icomparequadchar (struct keydesc *pskeydesc, VB_UCHAR *pccollate, int ilength,
+                  VB_UCHAR *pckey1, VB_UCHAR *pckey2)
+{
+    off_t       tvalue1, tvalue2;
+
+    if (ilength == 0 || ilength > pskeydesc->k_len) {
+        ilength = pskeydesc->k_len;
+    }
+    if (ilength < QUADSIZE) {
+        return 0;
+    }
+    tvalue1 = inl_ldquad (pckey1);
+    tvalue2 = inl_ldquad (pckey2);
+    if (tvalue1 < tvalue2) {
+        return -1;
+    }
+    if (tvalue1 > tvalue2) {
+        return 1;
+    }
+    return icomparetail (ilength - QUADSIZE, pckey1 + QUADSIZE,
+                         pckey2 + QUADSIZE);
+}
+
+/*
+ * Prefix ranking
+ * Given the ascending ptprefix array of a node, count the entries below
+ * tprefix (*pilower) and those not above it (*piupper).  The search key can
+ * then only land in the slots between the two.  The vector routines scan
+ * the whole (small) array in parallel, the scalar one bisects it.
+ */
+
+typedef void (*VBPREFIXRANK) (const long long *ptprefix, int icount,
+                              long long tprefix, int *pilower, int *piupper);
+
+static void
+vprefixrankscalar (const long long *ptprefix, int icount, long long tprefix,
+                   int *pilower, int *piupper)
+{
+    int     ilow, ihigh, imid;
+
+    ilow = 0;
+    ihigh = icount;
+    while (ilow < ihigh) {
+        imid = (ilow + ihigh) / 2;
+        if (ptprefix[imid] < tprefix) {
+            ilow = imid + 1;
+        } else {
+            ihigh = imid;
+        }
+    }
+    *pilower = ilow;
+    ihigh = icount;
+    while (ilow < ihigh) {
+        imid = (ilow + ihigh) / 2;
+        if (ptprefix[imid] <= tprefix) {
+            ilow = imid + 1;
+        } else {
+            ihigh = imid;
+        }
+    }
+    *piupper = ilow;
+}
+
+#ifdef	VB_PREFIX_SIMD
+__attribute__ ((target ("avx2")))
+static void
+vprefixrankavx2 (const long long *ptprefix, int icount, long long tprefix,
+                 int *pilower, int *piupper)
+{
+    __m256i     vkey, vprefix;
+    int     ilower = 0, iupper = 0, iloop = 0, imask;
+
+    vkey = _mm256_set1_epi64x (tprefix);
+    for (; iloop + 4 <= icount; iloop += 4) {
+        vprefix = _mm256_loadu_si256 ((const __m256i *)(ptprefix + iloop));
+        imask = _mm256_movemask_pd (_mm256_castsi256_pd (
+                                    _mm256_cmpgt_epi64 (vprefix, vkey)));
+        if (imask == 0x0f) {
+            break;  /* Everything from here on is above it */
+        }
+        iupper += 4 - __builtin_popcount (imask);
+        imask = _mm256_movemask_pd (_mm256_castsi256_pd (
+                                    _mm256_cmpgt_epi64 (vkey, vprefix)));
+        ilower += __builtin_popcount (imask);
+    }
+    for (; iloop < icount && ptprefix[iloop] <= tprefix; iloop++) {
+        iupper++;
+        if (ptprefix[iloop] < tprefix) {
+            ilower++;
+        }
+    }
+    *pilower = ilower;
+    *piupper = iupper;
+}
+
+__attribute__ ((target ("sse4.2")))
+static void
+vprefixranksse42 (const long long *ptprefix, int icount, long long tprefix,
+                  int *pilower, int *piupper)
+{
+    __m128i     vkey, vprefix;
+    int     ilower = 0, iupper = 0, iloop = 0, imask;
+
+    vkey = _mm_set1_epi64x (tprefix);
+    for (; iloop + 2 <= icount; iloop += 2) {
+        vprefix = _mm_loadu_si128 ((const __m128i *)(ptprefix + iloop));
+        imask = _mm_movemask_pd (_mm_castsi128_pd (_mm_cmpgt_epi64 (vprefix, vkey)));
+        if (imask == 0x03) {
+            break;  /* Everything from here on is above it */
+        }
+        iupper += 2 - __builtin_popcount (imask);
+        imask = _mm_movemask_pd (_mm_castsi128_pd (_mm_cmpgt_epi64 (vkey, vprefix)));
+        ilower += __builtin_popcount (imask);
+    }
+    for (; iloop < icount && ptprefix[iloop] <= tprefix; iloop++) {
+        iupper++;
+        if (ptprefix[iloop] < tprefix) {
+            ilower++;
+        }
+    }
+    *pilower = ilower;
+    *piupper = iupper;
+}
+#endif	/* VB_PREFIX_SIMD */
+
+static void
+vprefixrankselect (const long long *ptprefix, int icount, long long tprefix,
+                   int *pilower, int *piupper);
+
+static VBPREFIXRANK pfprefixrank = vprefixrankselect;
+
+/* The first call picks the best routine the CPU can run */
+static void
+vprefixrankselect (const long long *ptprefix, int icount, long long tprefix,
+                   int *pilower, int *piupper)
+{
+    VBPREFIXRANK    pfrank = vprefixrankscalar;
+
+#ifdef	VB_PREFIX_SIMD
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+        pfrank = vprefixrankavx2;
+    } else if (__builtin_cpu_supports ("sse4.2")) {
+        pfrank = vprefixranksse42;
+    }
+#endif	/* VB_PREFIX_SIMD */
+    pfprefixrank = pfrank;
+    pfrank (ptprefix, icount, tprefix, pilower, piupper);
+}
+
+/* Compare a normalized key (and tdupnumber) with one slot of a node */
+static VB_INLINE int
+islotcompare (struct VBTREE *pstree, int islot, int ikeylength, int ilength,
+              VB_UCHAR *pcnormal, off_t tdupnumber)
+{
+    int     iresult;
+
+    iresult = memcmp (pcnormal, pstree->pckeyslots + islot * ikeylength, (size_t)ilength);
+    if (iresult == 0) {
+        if (tdupnumber > pstree->ptdupnumber[islot]) {
+            iresult = 1;
+        } else if (tdupnumber < pstree->ptdupnumber[islot]) {
+            iresult = -1;
+        }
+    }
+    return iresult;
+}
+
+/*
+ * Whether a normalized key (and tdupnumber) belongs below pstree.  That's
+ * decided by the separator keys the current path took through the
+ * ancestors, so the whole path up to the root has to be current.
+ */
+static int
+iinsubtree (struct DICTINFO *psvbptr, const int ikeynumber, struct VBTREE *pstree,
+            const int ilength, VB_UCHAR *pcnormal, off_t tdupnumber)
+{
+    struct VBTREE   *psparent;
+    struct VBKEY    *pskey;
+    int     ikeylength, ilower = 0, iupper = 0;
+
+    ikeylength = psvbptr->pskeydesc[ikeynumber]->k_len;
+    if (pstree->iepoch != psvbptr->iepoch) {
+        return 0;
+    }
+    for (; pstree->psparent; pstree = psparent) {
+        psparent = pstree->psparent;
+        pskey = psparent->pskeycurr;
+        if (psparent->iepoch != psvbptr->iepoch || !pskey || pskey->pschild != pstree
+            || pskey->islot >= psparent->ikeysinnode
+            || psparent->pskeylist[pskey->islot] != pskey) {
+            return 0;
+        }
+        /* The child holds the keys above the previous separator up to its own */
+        if (!iupper && !pskey->iishigh) {
+            if (islotcompare (psparent, pskey->islot, ikeylength, ilength,
+                              pcnormal, tdupnumber) > 0) {
+                return 0;
+            }
+            iupper = 1;
+        }
+        if (!ilower && pskey->islot > 0) {
+            if (islotcompare (psparent, pskey->islot - 1, ikeylength, ilength,
+                              pcnormal, tdupnumber) <= 0) {
+                return 0;
+            }
+            ilower = 1;
+        }
+    }
+    return pstree == psvbptr->pstree[ikeynumber];
+}
+
+/*
+ * pcnormal is the normalized search key and ilength the number of its bytes
+ * to compare (see ivbkeynormlength ()), so every probe is a plain memcmp ()
+ */
 static int
 itreeload (const int ihandle, const int ikeynumber, const int ilength,
-           VB_UCHAR *pckeyvalue, off_t tdupnumber)
+           VB_UCHAR *pcnormal, off_t tdupnumber)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct VBKEY    *pskey;
     struct VBTREE   *pstree;
     struct DICTINFO *psvbptr;
     struct keydesc  *pskptr;
-    unsigned int    idelta, iindex;
-    int     iresult = 0;
+    long long   tprefix = 0;
+    int     ifinger, iprefix, ilast, ilow, ihigh, iresult = 0, islot;
 
     psvbptr = vb_rtd->psvbfile[ihandle];
     pstree = psvbptr->pstree[ikeynumber];
     pskptr = psvbptr->pskeydesc[ikeynumber];
+    /* Reloading the root can free the nodes the current key lives in */
+    ifinger = pstree && pstree->iepoch == psvbptr->iepoch;
     if (!pstree) {
         pstree = psvbtreeallocate (ihandle);
         psvbptr->pstree[ikeynumber] = pstree;
@@ -59,7 +503,7 @@ itreeload (const int ihandle, const int ikeynumber, const int ilength,
             psvbptr->pskeycurr[ikeynumber] = NULL;
             goto treeload_exit;
         }
-    } else if (psvbptr->iindexchanged) {
+    } else if (pstree->iepoch != psvbptr->iepoch) {
         vb_rtd->iserrno = ivbnodeload (ihandle, ikeynumber, pstree,
                                        pskptr->k_rootnode, -1);
         if (vb_rtd->iserrno) {
@@ -76,68 +520,65 @@ itreeload (const int ihandle, const int ikeynumber, const int ilength,
     pstree->iisroot = 1;
     pstree->iistof = 1;
     pstree->iiseof = 1;
+    /* A partial key shorter than the prefix can't use the prefixes */
+    iprefix = ilength >= VB_PREFIXLEN || ilength == pskptr->k_len;
+    if (iprefix) {
+        tprefix = tvbkeyprefix (pcnormal, ilength);
+    }
+    /*
+     * Finger search: a key near the current one is most likely in the same
+     * leaf or one of its siblings.  Start from the current leaf or its parent
+     * if the key is known to belong there, and skip the upper levels.
+     */
+    pskey = psvbptr->pskeycurr[ikeynumber];
+    if (ifinger && pskey && pskey->trownode != -1 && pskey->psparent
+        && !pskey->psparent->ilevel && pskey->psparent != pstree) {
+        if (iinsubtree (psvbptr, ikeynumber, pskey->psparent, ilength,
+                        pcnormal, tdupnumber)) {
+            pstree = pskey->psparent;
+        } else if (pskey->psparent->psparent != pstree
+                   && iinsubtree (psvbptr, ikeynumber, pskey->psparent->psparent,
+                                  ilength, pcnormal, tdupnumber)) {
+            pstree = pskey->psparent->psparent;
+        }
+    }
     while (1) {
-/* The following code takes a 'bisection' type approach for location of the */
-/* key entry.  It FAR outperforms the original sequential search code. */
-        idelta = 1;
-        iindex = pstree->ikeysinnode;
-        while (iindex) {
-            idelta = idelta << 1;
-            iindex = iindex >> 1;
+        vvbtreetouch (pstree);
+        if (!pstree->ikeysinnode) {
+            goto treeload_exit;
         }
-        iindex = idelta;
-        while (idelta) {
-            idelta = idelta >> 1;
-            if (iindex > pstree->ikeysinnode) {
-                iindex -= idelta;
-                continue;
-            }
-            pstree->pskeycurr = pstree->pskeylist[iindex - 1];
-            if (pstree->pskeycurr->iisdummy) {
-                iresult = -1;
-            } else {
-                iresult = ivbkeycompare (ihandle, ikeynumber, ilength,
-                                         pckeyvalue, pstree->pskeycurr->ckey);
-            }
-            if (iresult == 0) {
-                if (tdupnumber > pstree->pskeycurr->tdupnumber) {
-                    iresult = 1;
-                    iindex += idelta;
-                    continue;
-                }
-                if (tdupnumber < pstree->pskeycurr->tdupnumber) {
-                    iresult = -1;
-                    iindex -= idelta;
-                    continue;
-                }
-                if (tdupnumber == pstree->pskeycurr->tdupnumber) {
-                    break;
-                }
-            }
-            if (iresult < 0) {
-                iindex -= idelta;
-                continue;
-            }
-            if (iresult > 0) {
-                iindex += idelta;
-                continue;
-            }
+        ilast = pstree->ikeysinnode;
+        if (pstree->pskeylist[ilast - 1]->iisdummy) {
+            ilast--;
         }
-        if (iresult > 0 && pstree->pskeycurr->psnext) {
-            pstree->pskeycurr = pstree->pskeylist[iindex];
+/* Look for the first slot that is not below the search key (and tdupnumber). */
+/* The prefixes narrow the range down, then it's a bisection on the slot */
+/* arrays, so only the chosen key's VBKEY is touched. */
+        ilow = 0;
+        ihigh = ilast;
+        if (iprefix && ilast) {
+            pfprefixrank (pstree->ptprefix, ilast, tprefix, &ilow, &ihigh);
         }
-        if (!pstree->pskeycurr) {
-            goto treeload_exit;
+        while (ilow < ihigh) {
+            islot = (ilow + ihigh) / 2;
+            iresult = islotcompare (pstree, islot, pskptr->k_len, ilength,
+                                    pcnormal, tdupnumber);
+            if (iresult > 0) {
+                ilow = islot + 1;
+            } else {
+                ihigh = islot;
+            }
         }
-        if (pstree->pskeycurr->iisdummy && pstree->pskeycurr->psprev
-            && pstree->pskeycurr->psprev->iishigh) {
-            pstree->pskeycurr = pstree->pskeycurr->psprev;
+        islot = ilow;
+        if ((unsigned int)islot == pstree->ikeysinnode) {
+            islot--;
         }
-        if (!pstree->pskeycurr) {
-            goto treeload_exit;
+        if (islot == ilast && islot > 0 && pstree->pskeylist[islot - 1]->iishigh) {
+            islot--;
         }
-        iresult = ivbkeycompare (ihandle, ikeynumber, ilength, pckeyvalue,
-                                 pstree->pskeycurr->ckey);
+        pstree->pskeycurr = pstree->pskeylist[islot];
+        iresult = icomparetail (ilength, pcnormal,
+                                pstree->pckeyslots + islot * pskptr->k_len);
         if (iresult == 0 && tdupnumber < pstree->pskeycurr->tdupnumber) {
             iresult = -1;
         }
@@ -147,7 +588,8 @@ itreeload (const int ihandle, const int ikeynumber, const int ilength,
         if (!pstree->pskeycurr) {
             goto treeload_exit;
         }
-        if (!pstree->pskeycurr->pschild || psvbptr->iindexchanged) {
+        if (!pstree->pskeycurr->pschild
+            || pstree->pskeycurr->pschild->iepoch != psvbptr->iepoch) {
             pskey = pstree->pskeycurr;
             if (!pstree->pskeycurr->pschild) {
                 pskey->pschild = psvbtreeallocate (ihandle);
@@ -181,53 +623,248 @@ itreeload (const int ihandle, const int ikeynumber, const int ilength,
                 pstree->pskeycurr->pschild->iiseof = 1;
             }
         }
-        pstree = pstree->pskeycurr->pschild;
+        pstree = pstree->pskeycurr->pschild;
+    }
+    /*
+     * When we get here, iresult is set depending upon whether the located
+     * key was:
+     * -1   LESS than the desired value
+     * 0    EQUAL to the desired value (including a tdupnumber match!)
+     * 1    GREATER than the desired value
+     * By simply adding one to the value, we're cool for a NON-STANDARD
+     * comparison return value.
+     */
+    psvbptr->pskeycurr[ikeynumber] = pstree->pskeycurr;
+    if (!pstree->pskeycurr) {
+        vb_rtd->iserrno = EBADFILE;
+        return -1;
+    }
+    vb_rtd->iserrno = 0;
+    if (pstree->pskeycurr->iisdummy) {
+        vb_rtd->iserrno = EENDFILE;
+        if (pstree->pskeycurr->psprev) {
+            return 0;   /* EOF */
+        } else {
+            return 2;   /* Empty file! */
+        }
+    }
+    return(iresult + 1);
+
+    treeload_exit:
+    return -1;
+}
+
+/* Global functions */
+
+void
+vvbmakekey (const struct keydesc *pskeydesc, VB_CHAR *pcrow_buffer,
+            VB_UCHAR *pckeyvalue)
+{
+    VB_CHAR     *pcsource;
+    int     ipart;
+
+    /* Wierdly enough, a single keypart *CAN* span multiple instances */
+    /* EG: Part number 1 might contain 4 long values */
+    for (ipart = 0; ipart < pskeydesc->k_nparts; ipart++) {
+        pcsource = pcrow_buffer + pskeydesc->k_part[ipart].kp_start;
+        memcpy (pckeyvalue, pcsource, (size_t)pskeydesc->k_part[ipart].kp_leng);
+        pckeyvalue += pskeydesc->k_part[ipart].kp_leng;
+    }
+}
+
+/* The reverse of vvbmakekey (): scatter a key back into its row columns */
+void
+vvbunmakekey (const struct keydesc *pskeydesc, VB_UCHAR *pckeyvalue,
+              VB_CHAR *pcrow_buffer)
+{
+    int     ipart;
+
+    for (ipart = 0; ipart < pskeydesc->k_nparts; ipart++) {
+        memcpy (pcrow_buffer + pskeydesc->k_part[ipart].kp_start, pckeyvalue,
+                (size_t)pskeydesc->k_part[ipart].kp_leng);
+        pckeyvalue += pskeydesc->k_part[ipart].kp_leng;
+    }
+}
+
+/*
+ * Turn a contiguous key into a form of the same length that collates with a
+ * plain memcmp ():
+ * - CHARTYPE bytes go through the collating sequence (if any)
+ * - INTTYPE, LONGTYPE and QUADTYPE values have their sign bit flipped
+ * - FLOATTYPE and DOUBLETYPE values become big-endian IEEE bit patterns
+ *   with negative values inverted and -0.0 folded onto 0.0
+ * - ISDESC parts are then inverted byte for byte
+ * Bytes that don't form a whole value (ivbkeycompare () ignores them) are
+ * zeroed.  The result is only ever held in memory, never written to disk.
+ */
+void
+vvbkeynormalize (const struct keydesc *pskeydesc, VB_UCHAR *pccollate,
+                 VB_UCHAR *pckeyvalue, VB_UCHAR *pcnormal)
+{
+    unsigned long long  tbits;
+    unsigned int    ibits;
+    float       fvalue;
+    double      dvalue;
+    int     ipart, ilength, isize, ioffset, ibyte;
+
+    for (ipart = 0; ipart < pskeydesc->k_nparts; ipart++) {
+        ilength = pskeydesc->k_part[ipart].kp_leng;
+        switch ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) & ~ISDESC) {
+            case CHARTYPE:
+                if (pccollate) {
+                    for (ioffset = 0; ioffset < ilength; ioffset++) {
+                        pcnormal[ioffset] = pccollate[pckeyvalue[ioffset]];
+                    }
+                } else {
+                    memcpy (pcnormal, pckeyvalue, (size_t)ilength);
+                }
+                isize = ilength;
+                break;
+
+            case INTTYPE:
+            case LONGTYPE:
+            case QUADTYPE:
+                switch ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) & ~ISDESC) {
+                    case INTTYPE:
+                        isize = INTSIZE;
+                        break;
+                    case LONGTYPE:
+                        isize = LONGSIZE;
+                        break;
+                    default:
+                        isize = QUADSIZE;
+                        break;
+                }
+                /* The values are stored big-endian already */
+                for (ioffset = 0; ioffset + isize <= ilength; ioffset += isize) {
+                    memcpy (pcnormal + ioffset, pckeyvalue + ioffset, (size_t)isize);
+                    pcnormal[ioffset] ^= 0x80;
+                }
+                isize = ioffset;
+                break;
+
+            case FLOATTYPE:
+                for (ioffset = 0; ioffset + (int)FLOATSIZE <= ilength;
+                     ioffset += FLOATSIZE) {
+                    memcpy (&fvalue, pckeyvalue + ioffset, FLOATSIZE);
+                    if (fvalue == 0) {
+                        fvalue = 0;
+                    }
+                    memcpy (&ibits, &fvalue, FLOATSIZE);
+                    if (ibits & 0x80000000U) {
+                        ibits = ~ibits;
+                    } else {
+                        ibits |= 0x80000000U;
+                    }
+                    for (ibyte = FLOATSIZE - 1; ibyte >= 0; ibyte--) {
+                        pcnormal[ioffset + ibyte] = (VB_UCHAR)ibits;
+                        ibits >>= 8;
+                    }
+                }
+                isize = ioffset;
+                break;
+
+            case DOUBLETYPE:
+                for (ioffset = 0; ioffset + (int)DOUBLESIZE <= ilength;
+                     ioffset += DOUBLESIZE) {
+                    memcpy (&dvalue, pckeyvalue + ioffset, DOUBLESIZE);
+                    if (dvalue == 0) {
+                        dvalue = 0;
+                    }
+                    memcpy (&tbits, &dvalue, DOUBLESIZE);
+                    if (tbits & 0x8000000000000000ULL) {
+                        tbits = ~tbits;
+                    } else {
+                        tbits |= 0x8000000000000000ULL;
+                    }
+                    for (ibyte = DOUBLESIZE - 1; ibyte >= 0; ibyte--) {
+                        pcnormal[ioffset + ibyte] = (VB_UCHAR)tbits;
+                        tbits >>= 8;
+                    }
+                }
+                isize = ioffset;
+                break;
+
+            default:
+                memcpy (pcnormal, pckeyvalue, (size_t)ilength);
+                isize = ilength;
+                break;
+        }
+        memset (pcnormal + isize, 0, (size_t)(ilength - isize));
+        if (pskeydesc->k_part[ipart].kp_type & ISDESC) {
+            for (ioffset = 0; ioffset < ilength; ioffset++) {
+                pcnormal[ioffset] = ~pcnormal[ioffset];
+            }
+        }
+        pckeyvalue += ilength;
+        pcnormal += ilength;
     }
-    /*
-     * When we get here, iresult is set depending upon whether the located
-     * key was:
-     * -1   LESS than the desired value
-     * 0    EQUAL to the desired value (including a tdupnumber match!)
-     * 1    GREATER than the desired value
-     * By simply adding one to the value, we're cool for a NON-STANDARD
-     * comparison return value.
-     */
-    psvbptr->pskeycurr[ikeynumber] = pstree->pskeycurr;
-    if (!pstree->pskeycurr) {
-        vb_rtd->iserrno = EBADFILE;
-        return -1;
+}
+
+/*
+ * The number of leading bytes of a normalized key that a comparison of the
+ * first ilength bytes (or k_len bytes if ilength is zero) of the original
+ * key covers.  A numeric value cut short by ilength takes no part in it.
+ */
+int
+ivbkeynormlength (const struct keydesc *pskeydesc, int ilength)
+{
+    int     ipart, isize, inormal = 0;
+
+    if (ilength == 0 || ilength > pskeydesc->k_len) {
+        ilength = pskeydesc->k_len;
     }
-    vb_rtd->iserrno = 0;
-    if (pstree->pskeycurr->iisdummy) {
-        vb_rtd->iserrno = EENDFILE;
-        if (pstree->pskeycurr->psprev) {
-            return 0;   /* EOF */
-        } else {
-            return 2;   /* Empty file! */
+    for (ipart = 0; ilength > 0 && ipart < pskeydesc->k_nparts; ipart++) {
+        if (ilength >= pskeydesc->k_part[ipart].kp_leng) {
+            inormal += pskeydesc->k_part[ipart].kp_leng;
+            ilength -= pskeydesc->k_part[ipart].kp_leng;
+            continue;
+        }
+        switch ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) & ~ISDESC) {
+            case INTTYPE:
+                isize = INTSIZE;
+                break;
+            case LONGTYPE:
+                isize = LONGSIZE;
+                break;
+            case QUADTYPE:
+                isize = QUADSIZE;
+                break;
+            case FLOATTYPE:
+                isize = FLOATSIZE;
+                break;
+            case DOUBLETYPE:
+                isize = DOUBLESIZE;
+                break;
+            default:
+                isize = 1;
+                break;
         }
+        inormal += ilength - ilength % isize;
+        break;
     }
-    return(iresult + 1);
-
-    treeload_exit:
-    return -1;
+    return inormal;
 }
 
-/* Global functions */
-
-void
-vvbmakekey (const struct keydesc *pskeydesc, VB_CHAR *pcrow_buffer,
-            VB_UCHAR *pckeyvalue)
+/*
+ * The first VB_PREFIXLEN bytes (at most ilength of them, zero padded) of a
+ * normalized key as one big-endian number.  The sign bit is flipped, so the
+ * prefixes of two keys compare as signed values like the bytes would under
+ * memcmp ().
+ */
+long long
+tvbkeyprefix (VB_UCHAR *pcnormal, int ilength)
 {
-    VB_CHAR     *pcsource;
-    int     ipart;
+    unsigned long long  tprefix = 0;
+    int     ibyte;
 
-    /* Wierdly enough, a single keypart *CAN* span multiple instances */
-    /* EG: Part number 1 might contain 4 long values */
-    for (ipart = 0; ipart < pskeydesc->k_nparts; ipart++) {
-        pcsource = pcrow_buffer + pskeydesc->k_part[ipart].kp_start;
-        memcpy (pckeyvalue, pcsource, (size_t)pskeydesc->k_part[ipart].kp_leng);
-        pckeyvalue += pskeydesc->k_part[ipart].kp_leng;
+    for (ibyte = 0; ibyte < VB_PREFIXLEN; ibyte++) {
+        tprefix <<= 8;
+        if (ibyte < ilength) {
+            tprefix |= pcnormal[ibyte];
+        }
     }
+    return (long long)(tprefix ^ 0x8000000000000000ULL);
 }
 
 int
@@ -238,22 +875,21 @@ ivbkeysearch (const int ihandle, const int imode, const int ikeynumber,
     struct VBKEY    *pskey;
     struct keydesc  *pskeydesc;
     int     iresult;
-    VB_UCHAR    ckeyvalue[VB_MAX_KEYLEN];
+    VB_UCHAR    cnormal[VB_MAX_KEYLEN];
 
     pskeydesc = vb_rtd->psvbfile[ihandle]->pskeydesc[ikeynumber];
-    if (ilength == 0) {
-        ilength = pskeydesc->k_len;
-    }
+    ilength = ivbkeynormlength (pskeydesc, ilength);
     switch (imode) {
+        /* The normalized extremes suit every key type, ISDESC included */
         case ISFIRST:
-            vvbkeyvalueset (0, pskeydesc, ckeyvalue);
+            memset (cnormal, 0x00, (size_t)pskeydesc->k_len);
             tdupnumber = -1;
-            return itreeload (ihandle, ikeynumber, ilength, ckeyvalue, tdupnumber);
+            return itreeload (ihandle, ikeynumber, ilength, cnormal, tdupnumber);
 
         case ISLAST:
-            vvbkeyvalueset (1, pskeydesc, ckeyvalue);
+            memset (cnormal, 0xff, (size_t)pskeydesc->k_len);
             tdupnumber = VB_MAX_OFF_T;
-            return itreeload (ihandle, ikeynumber, ilength, ckeyvalue, tdupnumber);
+            return itreeload (ihandle, ikeynumber, ilength, cnormal, tdupnumber);
 
         case ISNEXT:
             iresult = ivbkeyload (ihandle, ikeynumber, ISNEXT, 1, &pskey);
@@ -278,16 +914,16 @@ ivbkeysearch (const int ihandle, const int imode, const int ikeynumber,
             return 1;   /* "PREV" can NEVER be an exact match */
 
         case ISCURR:
-            return itreeload (ihandle, ikeynumber, ilength, pckeyvalue, tdupnumber);
+            break;
 
         case ISEQUAL:       /* Falls thru to ISGTEQ */
             tdupnumber = 0;
         case ISGTEQ:
-            return itreeload (ihandle, ikeynumber, ilength, pckeyvalue, tdupnumber);
+            break;
 
         case ISGREAT:
             tdupnumber = VB_MAX_OFF_T;
-            return itreeload (ihandle, ikeynumber, ilength, pckeyvalue, tdupnumber);
+            break;
 
         default:
 #ifdef	VBDEBUG
@@ -298,6 +934,9 @@ ivbkeysearch (const int ihandle, const int imode, const int ikeynumber,
             return -1;
 #endif
     }
+    vvbkeynormalize (pskeydesc, vb_rtd->psvbfile[ihandle]->collating_sequence,
+                     pckeyvalue, cnormal);
+    return itreeload (ihandle, ikeynumber, ilength, cnormal, tdupnumber);
 }
 
 int
@@ -307,6 +946,7 @@ ivbkeylocaterow (const int ihandle, const int ikeynumber, off_t trownumber)
     struct DICTINFO *psvbptr;
     struct VBKEY    *pskey;
     struct VBTREE   *pstree;
+    VBKEYCOMPARE    pfcompare;
     int     iresult;
     VB_UCHAR    ckeyvalue[VB_MAX_KEYLEN];
 
@@ -325,6 +965,12 @@ ivbkeylocaterow (const int ihandle, const int ikeynumber, off_t trownumber)
         /* Position pskeycurr all the way up to the root to point at us */
         pstree = pskey->psparent;
         while (pstree->psparent) {
+            /* Usually they still do, ivbkeyload () keeps them in step */
+            if (pstree->psparent->pskeycurr
+                && pstree->psparent->pskeycurr->pschild == pstree) {
+                pstree = pstree->psparent;
+                continue;
+            }
             for (pstree->psparent->pskeycurr = pstree->psparent->pskeyfirst;
                 pstree->psparent->pskeycurr
                 && pstree->psparent->pskeycurr->pschild != pstree;
@@ -347,6 +993,7 @@ ivbkeylocaterow (const int ihandle, const int ikeynumber, off_t trownumber)
      *      Find the damn key!
      */
     vvbmakekey (psvbptr->pskeydesc[ikeynumber], psvbptr->ppcrowbuffer, ckeyvalue);
+    pfcompare = psvbptr->pfkeycompare[ikeynumber];
     iresult = ivbkeysearch (ihandle, ISGTEQ, ikeynumber, 0, ckeyvalue, (off_t)0);
     if (iresult < 0 || iresult > 1) {
         vb_rtd->iserrno = ENOREC;
@@ -360,8 +1007,9 @@ ivbkeylocaterow (const int ihandle, const int ikeynumber, off_t trownumber)
             }
             return -1;
         }
-        if (ivbkeycompare (ihandle, ikeynumber, 0, ckeyvalue,
-                           psvbptr->pskeycurr[ikeynumber]->ckey)) {
+        if (pfcompare (psvbptr->pskeydesc[ikeynumber],
+                       psvbptr->collating_sequence, 0, ckeyvalue,
+                       psvbptr->pskeycurr[ikeynumber]->ckey)) {
             vb_rtd->iserrno = ENOREC;
             return -1;
         }
@@ -415,7 +1063,7 @@ ivbkeyload (const int ihandle, const int ikeynumber, const int imode,
                 if (isetcurr) {
                     pstree->pskeycurr = pskey;
                 }
-                if (!pskey->pschild || psvbptr->iindexchanged) {
+                if (!pskey->pschild || pskey->pschild->iepoch != psvbptr->iepoch) {
                     if (!pskey->pschild) {
                         pskey->pschild = psvbtreeallocate (ihandle);
                         if (!pskey->pschild) {
@@ -443,6 +1091,7 @@ ivbkeyload (const int ihandle, const int ikeynumber, const int imode,
                     }
                 }
                 pstree = pskey->pschild;
+                vvbtreetouch (pstree);
                 /* Last key is always the dummy, so backup by one */
                 pskey = pstree->pskeylast->psprev;
             }
@@ -483,7 +1132,7 @@ ivbkeyload (const int ihandle, const int ikeynumber, const int imode,
                 if (isetcurr) {
                     pstree->pskeycurr = pskey;
                 }
-                if (!pskey->pschild || psvbptr->iindexchanged) {
+                if (!pskey->pschild || pskey->pschild->iepoch != psvbptr->iepoch) {
                     if (!pskey->pschild) {
                         pskey->pschild = psvbtreeallocate (ihandle);
                         if (!pskey->pschild) {
@@ -511,6 +1160,7 @@ ivbkeyload (const int ihandle, const int ikeynumber, const int imode,
                     }
                 }
                 pstree = pskey->pschild;
+                vvbtreetouch (pstree);
                 pskey = pstree->pskeyfirst;
             }
             if (isetcurr) {
@@ -557,7 +1207,7 @@ vvbkeyvalueset (const int ihigh, struct keydesc *pskeydesc, VB_UCHAR *pckeyvalue
             case LONGTYPE:
                 iremainder = pskeydesc->k_part[ipart].kp_leng;
                 while (iremainder > 0) {
-                    inl_stlong (ihigh ? LONG_MAX : LONG_MIN, pckeyvalue);
+                    inl_stlong (ihigh ? INT_MAX : INT_MIN, pckeyvalue);
                     pckeyvalue += LONGSIZE;
                     iremainder -= LONGSIZE;
                 }
@@ -611,8 +1261,8 @@ ivbkeyinsert (const int ihandle, struct VBTREE *pstree, const int ikeynumber,
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbptr;
-    struct VBKEY    *pskey, *pstempkey;
-    int     iposn = 0, iresult, i, klen;
+    struct VBKEY    *pskey;
+    int     iposn, iresult, i, klen;
     unsigned char nullchar;
 
     psvbptr = vb_rtd->psvbfile[ihandle];
@@ -651,14 +1301,11 @@ ivbkeyinsert (const int ihandle, struct VBTREE *pstree, const int ikeynumber,
     pstree->pskeycurr->psprev = pskey;
     pstree->pskeycurr = pskey;
     psvbptr->pskeycurr[ikeynumber] = pskey;
-    pstree->ikeysinnode = 0;
-    for (pstempkey = pstree->pskeyfirst; pstempkey; pstempkey = pstempkey->psnext) {
-        if (pstempkey == pskey) {
-            iposn = pstree->ikeysinnode;
-        }
-        pstree->pskeylist[pstree->ikeysinnode] = pstempkey;
-        pstree->ikeysinnode++;
+    iresult = ivbtreeslotinsert (ihandle, ikeynumber, pstree, pskey);
+    if (iresult) {
+        return iresult;
     }
+    iposn = pskey->islot;
     iresult = ivbnodesave (ihandle, ikeynumber, pskey->psparent,
                            pskey->psparent->tnodenumber, 1, iposn);
     pskey->iisnew = 0;
@@ -670,7 +1317,7 @@ ivbkeydelete (const int ihandle, const int ikeynumber)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbptr;
-    struct VBKEY    *pskey, *pskeytemp;
+    struct VBKEY    *pskey;
     struct VBTREE   *pstree, *pstreeroot;
     int     iforcerewrite = 0, iposn, iresult;
 
@@ -708,6 +1355,7 @@ ivbkeydelete (const int ihandle, const int ikeynumber)
                 pskey->pschild = pskey->psprev->pschild;
                 pskey->trownode = pskey->psprev->trownode;
                 pskey->tdupnumber = pskey->psprev->tdupnumber;
+                vvbtreeslotupdate (ihandle, ikeynumber, pstree, pskey);
                 pskey = pskey->psprev;
                 iforcerewrite = 1;
             } else {
@@ -720,17 +1368,8 @@ ivbkeydelete (const int ihandle, const int ikeynumber)
                 continue;
             }
         }
-        iposn = -1;
-        pskey->psparent->ikeysinnode = 0;
-        for (pskeytemp = pskey->psparent->pskeyfirst; pskeytemp;
-            pskeytemp = pskeytemp->psnext) {
-            if (pskey == pskeytemp) {
-                iposn = pskey->psparent->ikeysinnode;
-            } else {
-                pskey->psparent->pskeylist[pskey->psparent->ikeysinnode] = pskeytemp;
-                pskey->psparent->ikeysinnode++;
-            }
-        }
+        iposn = pskey->islot;
+        vvbtreeslotdelete (ihandle, ikeynumber, pstree, pskey);
         if (pskey->psprev) {
             pskey->psprev->psnext = pskey->psnext;
         } else {
@@ -792,6 +1431,13 @@ ivbkeydelete (const int ihandle, const int ikeynumber)
         }
         break;
     }
+    /*
+     * A retained neighbour of a child that went may now be the first or
+     * last one of the index
+     */
+    if (pstree->ilevel) {
+        vvbtreeedges (pstree);
+    }
     if (iforcerewrite) {
         return ivbnodesave (ihandle, ikeynumber, pstree, pstree->tnodenumber, 0, 0);
     }
@@ -803,147 +1449,49 @@ ivbkeycompare (const int ihandle, const int ikeynumber, int ilength,
                VB_UCHAR *pckey1, VB_UCHAR *pckey2)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
-    struct keydesc  *pskeydesc;
-    off_t       tvalue1, tvalue2;
-    int     idescbias, ipart, ilengthtocompare;
-    int     iresult = 0, ivalue1, ivalue2;
-    int     n;
-    int     lvalue1, lvalue2;
-    float       fvalue1, fvalue2;
-    double      dvalue1, dvalue2;
-
-    pskeydesc = vb_rtd->psvbfile[ihandle]->pskeydesc[ikeynumber];
-    if (ilength == 0) {
-        ilength = pskeydesc->k_len;
-    }
-    for (ipart = 0; ilength > 0 && ipart < pskeydesc->k_nparts; ipart++) {
-        if (ilength >= pskeydesc->k_part[ipart].kp_leng) {
-            ilengthtocompare = pskeydesc->k_part[ipart].kp_leng;
-        } else {
-            ilengthtocompare = ilength;
-        }
-        ilength -= ilengthtocompare;
-        if (pskeydesc->k_part[ipart].kp_type & ISDESC) {
-            idescbias = -1;
-        } else {
-            idescbias = 1;
-        }
-        iresult = 0;
-        switch ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) & ~ISDESC) {
-            case CHARTYPE:
-
-                n = memcmp (pckey1, pckey2, (size_t)ilengthtocompare);
-                if (n < 0) {
-                    return -idescbias;
-                }
-                if (n > 0) {
-                    return idescbias;
-                }
-                pckey1 += ilengthtocompare;
-                pckey2 += ilengthtocompare;
-/*
-            while (ilengthtocompare-- && !iresult) {
-                if (*pckey1 < *pckey2) {
-                    return -idescbias;
-                }
-                if (*pckey1++ > *pckey2++) {
-                    return idescbias;
-                }
-            }
-*/
-                break;
-
-            case INTTYPE:
-                while (ilengthtocompare >= INTSIZE && !iresult) {
-                    ivalue1 = inl_ldint (pckey1);
-                    ivalue2 = inl_ldint (pckey2);
-                    if (ivalue1 < ivalue2) {
-                        return -idescbias;
-                    }
-                    if (ivalue1 > ivalue2) {
-                        return idescbias;
-                    }
-                    pckey1 += INTSIZE;
-                    pckey2 += INTSIZE;
-                    ilengthtocompare -= INTSIZE;
-                }
-                break;
-
-            case LONGTYPE:
-                while (ilengthtocompare >= LONGSIZE && !iresult) {
-                    lvalue1 = inl_ldlong (pckey1);
-                    lvalue2 = inl_ldlong (pckey2);
-                    if (lvalue1 < lvalue2) {
-                        return -idescbias;
-                    }
-                    if (lvalue1 > lvalue2) {
-                        return idescbias;
-                    }
-                    pckey1 += LONGSIZE;
-                    pckey2 += LONGSIZE;
-                    ilengthtocompare -= LONGSIZE;
-                }
-                break;
-
-            case QUADTYPE:
-                while (ilengthtocompare >= QUADSIZE && !iresult) {
-                    tvalue1 = inl_ldquad (pckey1);
-                    tvalue2 = inl_ldquad (pckey2);
-                    if (tvalue1 < tvalue2) {
-                        return -idescbias;
-                    }
-                    if (tvalue1 > tvalue2) {
-                        return idescbias;
-                    }
-                    pckey1 += QUADSIZE;
-                    pckey2 += QUADSIZE;
-                    ilengthtocompare -= QUADSIZE;
-                }
-                break;
+    struct DICTINFO *psvbptr;
 
-            case FLOATTYPE:
-                while (ilengthtocompare >= FLOATSIZE && !iresult) {
-                    fvalue1 = ldfloat (pckey1);
-                    fvalue2 = ldfloat (pckey2);
-                    if (fvalue1 < fvalue2) {
-                        return -idescbias;
-                    }
-                    if (fvalue1 > fvalue2) {
-                        return idescbias;
-                    }
-                    pckey1 += FLOATSIZE;
-                    pckey2 += FLOATSIZE;
-                    ilengthtocompare -= FLOATSIZE;
-                }
-                break;
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    return psvbptr->pfkeycompare[ikeynumber] (psvbptr->pskeydesc[ikeynumber],
+                                              psvbptr->collating_sequence,
+                                              ilength, pckey1, pckey2);
+}
 
-            case DOUBLETYPE:
-                while (ilengthtocompare >= DOUBLESIZE && !iresult) {
-                    dvalue1 = lddbl (pckey1);
-                    dvalue2 = lddbl (pckey2);
-                    if (dvalue1 < dvalue2) {
-                        return -idescbias;
-                    }
-                    if (dvalue1 > dvalue2) {
-                        return idescbias;
-                    }
-                    pckey1 += DOUBLESIZE;
-                    pckey2 += DOUBLESIZE;
-                    ilengthtocompare -= DOUBLESIZE;
-                }
-                break;
+void
+vvbkeycompareset (const int ihandle, const int ikeynumber)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *psvbptr;
+    struct keydesc  *pskeydesc;
+    int     ipart, itype;
+    VBKEYCOMPARE    pfcompare = icomparegeneric;
 
-            default:
-#ifdef	VBDEBUG
-                fprintf (stderr, "HUGE ERROR! File %s, Line %d itype %d\n", __FILE__,
-                         __LINE__, pskeydesc->k_part[ipart].kp_type);
-                exit (1);
-#else
-                break;
-#endif
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    pskeydesc = psvbptr->pskeydesc[ikeynumber];
+    /*
+     * A specialised routine is only used when every part that follows the
+     * first is ascending CHARTYPE, so the tail of the key is one memcmp ().
+     */
+    for (ipart = 1; ipart < pskeydesc->k_nparts; ipart++) {
+        if ((pskeydesc->k_part[ipart].kp_type & BYTEMASK) != CHARTYPE) {
+            break;
         }
     }
-    return 0;
+    if (psvbptr->collating_sequence) {
+        pfcompare = icomparenormal;
+    } else if (pskeydesc->k_nparts > 0 && ipart == pskeydesc->k_nparts) {
+        itype = pskeydesc->k_part[0].kp_type & BYTEMASK;
+        if (itype == CHARTYPE) {
+            pfcompare = icomparechar;
+        } else if (itype == LONGTYPE
+                   && pskeydesc->k_part[0].kp_leng == LONGSIZE) {
+            pfcompare = icomparelongchar;
+        } else if (itype == QUADTYPE
+                   && pskeydesc->k_part[0].kp_leng == QUADSIZE) {
+            pfcompare = icomparequadchar;
+        }
+    }
+    psvbptr->pfkeycompare[ikeynumber] = pfcompare;
 }
 
 #ifdef	VBDEBUG
@@ -21,7 +21,6 @@
 #define NEED_VBINLINE_QUAD_STORE 1
 #include        "isinternal.h"
 
-#define IVBBUFFERLEVEL  4
 
 /* Local functions */
 
@@ -181,6 +180,7 @@ ivbenter (const int ihandle, const int imodifying)
         struct DICTINFO *psvbptr;
         off_t           tlength;
         int             ilockmode, iloop, iresult;
+        VB_CHAR         *pcdictnode;
         VB_CHAR         cvbnodetmp[MAX_NODE_LENGTH];
 
         if (unlikely(ihandle < 0 || ihandle > vb_rtd->ivbmaxusedhandle)) {
@@ -239,16 +239,24 @@ ivbenter (const int ihandle, const int imodifying)
                         return -1;
                 }
                 psvbptr->iisdictlocked |= 0x01;
-                iresult = ivbblockread (ihandle, 1, (off_t) 1, cvbnodetmp);
-                if (iresult) {
-                        psvbptr->iisdictlocked = 0;
-                        ivbexit (ihandle);
-                        vb_rtd->iserrno = EBADFILE;
-                        /*CIT*/ivblock (psvbptr->iindexhandle, (off_t)0, tlength, VBUNLOCK);
-                        return -1;
+                /* Prefer the shared mapping, it saves a read per call */
+                pcdictnode = pcvbdictmapped (psvbptr->iindexhandle);
+                if (pcdictnode) {
+                        memcpy ((void *)&psvbptr->sdictnode, (void *)pcdictnode,
+                                sizeof (struct DICTNODE));
+                } else {
+                        iresult = ivbblockread (ihandle, 1, (off_t) 1, cvbnodetmp);
+                        if (iresult) {
+                                psvbptr->iisdictlocked = 0;
+                                ivbexit (ihandle);
+                                vb_rtd->iserrno = EBADFILE;
+                                /*CIT*/ivblock (psvbptr->iindexhandle, (off_t)0, tlength, VBUNLOCK);
+                                return -1;
+                        }
+                        memcpy ((void *)&psvbptr->sdictnode, (void *)cvbnodetmp,
+                                sizeof (struct DICTNODE));
                 }
-                memcpy ((void *)&psvbptr->sdictnode, (void *)cvbnodetmp,
-                        sizeof (struct DICTNODE));
+                vvbbuffersync (ihandle, 0);
         }
         psvbptr->iisdictlocked |= 0x01;
 /*
@@ -259,10 +267,19 @@ ivbenter (const int ihandle, const int imodifying)
  * stamp on it stating the transaction number when it was updated.  If this
  * stamp is BELOW that of the current transaction number, we know that the
  * associated VBTREE / VBKEY linked lists are still coherent!
+ * So rather than freeing the trees, we start a new epoch: every cached node
+ * from an older epoch has its stamp checked (ivbnodeload) the next time it
+ * is descended into, and only the nodes that really changed are reloaded.
+ * The current key pointers are dropped so that they are relocated by key.
  */
-/*#if     ISAMMODE == 0*/
         if (psvbptr->ttranslast !=
             inl_ldquad (psvbptr->sdictnode.ctransnumber)) {
+#if     ISAMMODE == 1
+                psvbptr->iepoch++;
+                for (iloop = 0; iloop < MAXSUBS; iloop++) {
+                        psvbptr->pskeycurr[iloop] = NULL;
+                }
+#else   /* ISAMMODE == 1 */
                 for (iloop = 0; iloop < MAXSUBS; iloop++) {
                         if (psvbptr->pstree[iloop]) {
                                 vvbtreeallfree (ihandle, iloop,
@@ -270,8 +287,8 @@ ivbenter (const int ihandle, const int imodifying)
                         }
                         psvbptr->pstree[iloop] = NULL;
                 }
+#endif  /* ISAMMODE == 1 */
         }
-/*#endif   ISAMMODE == 0 */
         return 0;
 }
 
@@ -280,9 +297,8 @@ ivbexit (const int ihandle)
 {
         struct DICTINFO *psvbptr;
         vb_rtd_t *vb_rtd =VB_GET_RTD;
-        struct VBKEY    *pskey, *pskeycurr;
         off_t           tlength, ttransnumber;
-        int             iresult = 0, iloop, iloop2, isaveerror;
+        int             iresult = 0, isaveerror;
         VB_CHAR         cvbnodetmp[MAX_NODE_LENGTH];
 
         isaveerror = vb_rtd->iserrno;
@@ -294,6 +310,7 @@ ivbexit (const int ihandle)
         ttransnumber = inl_ldquad (psvbptr->sdictnode.ctransnumber);
         psvbptr->ttranslast = ttransnumber;
         if (psvbptr->iopenmode & ISEXCLLOCK) {
+                vvbtreetrim ();
                 return 0;
         }
         if (psvbptr->iisdictlocked & 0x02) {
@@ -310,6 +327,7 @@ ivbexit (const int ihandle)
                         vb_rtd->iserrno = EBADFILE;
                 } else {
                         vb_rtd->iserrno = 0;
+                        vvbbuffersync (ihandle, 1);
                 }
         }
         tlength = VB_OFFLEN_3F;
@@ -318,45 +336,8 @@ ivbexit (const int ihandle)
                 return -1;
         }
         psvbptr->iisdictlocked = 0;
-        /* Free up any key/tree no longer wanted */
-        for (iloop2 = 0; iloop2 < psvbptr->inkeys; iloop2++) {
-                pskey = psvbptr->pskeycurr[iloop2];
-                /*
-                 * This is a REAL fudge factor...
-                 * We simply free up all the dynamically allocated memory
-                 * associated with non-current nodes above a certain level.
-                 * In other words, we wish to keep the CURRENT key and all data
-                 * in memory above it for IVBBUFFERLEVEL levels.
-                 * Anything *ABOVE* that in the tree is to be purged with
-                 * EXTREME prejudice except for the 'current' tree up to the
-                 * root.
-                 */
-                for (iloop = 0; pskey && iloop < IVBBUFFERLEVEL; iloop++) {
-                        if (pskey->psparent->psparent) {
-                                pskey = pskey->psparent->psparent->pskeycurr;
-                        } else {
-                                pskey = NULL;
-                        }
-                }
-                if (!pskey) {
-                        vb_rtd->iserrno = isaveerror;
-                        return 0;
-                }
-                while (pskey) {
-                        for (pskeycurr = pskey->psparent->pskeyfirst; pskeycurr;
-                             pskeycurr = pskeycurr->psnext) {
-                                if (pskeycurr != pskey && pskeycurr->pschild) {
-                                        vvbtreeallfree (ihandle, iloop2, pskeycurr->pschild);
-                                        pskeycurr->pschild = NULL;
-                                }
-                        }
-                        if (pskey->psparent->psparent) {
-                                pskey = pskey->psparent->psparent->pskeycurr;
-                        } else {
-                                pskey = NULL;
-                        }
-                }
-        }
+        /* Keep the decoded nodes of all the open tables within budget */
+        vvbtreetrim ();
         if (iresult) {
                 return -1;
         }
@@ -17,6 +17,7 @@
  * Suite 330, Boston, MA 02111-1307 USA
  */
 
+#define NEED_VBINLINE_QUAD_LOAD 1
 #include	"isinternal.h"
 
 #ifdef	VBDEBUG
@@ -117,6 +118,19 @@ ivbclose (const int ihandle)
     }
     vb_rtd->svbfile[ihandle].irefcount--;
     if ( !vb_rtd->svbfile[ihandle].irefcount ) {
+        vvbbufferinvalidate (ihandle);
+#if	HAVE_SYS_MMAN_H
+        if ( vb_rtd->svbfile[ihandle].pcmap ) {
+            munmap ((void *)vb_rtd->svbfile[ihandle].pcmap, vb_rtd->svbfile[ihandle].tmapsize);
+        }
+        if ( vb_rtd->svbfile[ihandle].pcdictmap ) {
+            munmap ((void *)vb_rtd->svbfile[ihandle].pcdictmap, sizeof (struct DICTNODE));
+        }
+#endif
+        vb_rtd->svbfile[ihandle].pcdictmap = NULL;
+        vb_rtd->svbfile[ihandle].pcmap = NULL;
+        vb_rtd->svbfile[ihandle].tmapsize = 0;
+        vb_rtd->svbfile[ihandle].iismapped = 0;
         return close (vb_rtd->svbfile[ihandle].ihandle);
     }
     return 0;
@@ -157,13 +171,367 @@ tvbwrite (const int ihandle, void *pvbuffer, const size_t tcount)
 }
 #endif
 
+#if	defined(VBDEBUG) || defined(_WIN32)
+ssize_t
+tvbpread (const int ihandle, void *pvbuffer, const size_t tcount, off_t toffset)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    if ( unlikely(!vb_rtd->svbfile[ihandle].irefcount) ) {
+        errno = ENOENT;
+        return -1;
+    }
+#ifdef	_WIN32
+    /* No pread () here, fall back to a seek and read */
+    if ( lseek (vb_rtd->svbfile[ihandle].ihandle, toffset, SEEK_SET) != toffset ) {
+        return -1;
+    }
+    return read (vb_rtd->svbfile[ihandle].ihandle, pvbuffer, tcount);
+#else
+    return pread (vb_rtd->svbfile[ihandle].ihandle, pvbuffer, tcount, toffset);
+#endif
+}
+
+ssize_t
+tvbpwrite (const int ihandle, void *pvbuffer, const size_t tcount, off_t toffset)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    if ( unlikely(!vb_rtd->svbfile[ihandle].irefcount) ) {
+        errno = ENOENT;
+        return -1;
+    }
+#ifdef	_WIN32
+    /* No pwrite () here, fall back to a seek and write */
+    if ( lseek (vb_rtd->svbfile[ihandle].ihandle, toffset, SEEK_SET) != toffset ) {
+        return -1;
+    }
+    return write (vb_rtd->svbfile[ihandle].ihandle, pvbuffer, tcount);
+#else
+    return pwrite (vb_rtd->svbfile[ihandle].ihandle, pvbuffer, tcount, toffset);
+#endif
+}
+#endif
+
+/*
+ * ISMMAP support: the .idx / .dat file is mapped read only and shared, so
+ * our own pwrite ()s and those of other processes show through.  When a
+ * read falls beyond the mapping the file has grown (see tvbnodeallocate ()
+ * and tvbdataallocate ()) and it is remapped at its new size.
+ */
+static int
+ivbmapremap (const int ifilehandle)
+{
+#if	HAVE_SYS_MMAN_H
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBFILE   *psfile = &vb_rtd->svbfile[ifilehandle];
+    struct stat sstat;
+    void        *pvmap;
+
+    if ( fstat (psfile->ihandle, &sstat) ) {
+        return -1;
+    }
+    if ( (size_t)sstat.st_size == psfile->tmapsize ) {
+        return 0;
+    }
+    if ( psfile->pcmap ) {
+        munmap ((void *)psfile->pcmap, psfile->tmapsize);
+        psfile->pcmap = NULL;
+        psfile->tmapsize = 0;
+    }
+    if ( sstat.st_size == 0 ) {
+        return 0;
+    }
+    pvmap = mmap (NULL, (size_t)sstat.st_size, PROT_READ, MAP_SHARED, psfile->ihandle, (off_t)0);
+    if ( pvmap == MAP_FAILED ) {
+        return -1;
+    }
+    psfile->pcmap = (VB_CHAR *)pvmap;
+    psfile->tmapsize = (size_t)sstat.st_size;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int
+ivbmapenable (const int ifilehandle)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+    if ( vb_rtd->svbfile[ifilehandle].iismapped ) {
+        return 0;
+    }
+    if ( ivbmapremap (ifilehandle) ) {
+        return -1;
+    }
+    /* Blocks are no longer pooled for this file */
+    vvbbufferinvalidate (ifilehandle);
+    vb_rtd->svbfile[ifilehandle].iismapped = 1;
+    return 0;
+}
+
+/*
+ * Returns a pointer to tlength bytes at toffset of a mapped file, or NULL
+ * if the file is not mapped or does not (yet) extend that far.
+ * The pointer is only valid until the next call.
+ */
+VB_CHAR *
+pcvbmapped (const int ifilehandle, off_t toffset, const size_t tlength)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBFILE   *psfile = &vb_rtd->svbfile[ifilehandle];
+
+    if ( likely(!psfile->iismapped) ) {
+        return NULL;
+    }
+    if ( (size_t)toffset + tlength > psfile->tmapsize ) {
+        if ( ivbmapremap (ifilehandle) || (size_t)toffset + tlength > psfile->tmapsize ) {
+            return NULL;
+        }
+    }
+    return psfile->pcmap + toffset;
+}
+
+/*
+ * ivbenter () needs a fresh copy of the dictionary node on every call.  Rather
+ * than reading block 1 each time, the start of the index file is mapped shared
+ * and the node is copied out of the page cache, which sees every pwrite () of
+ * it by any process.  Returns NULL if the node cannot be mapped, in which case
+ * the caller must read it as usual.
+ */
+VB_CHAR *
+pcvbdictmapped (const int ifilehandle)
+{
+#if	HAVE_SYS_MMAN_H
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBFILE   *psfile = &vb_rtd->svbfile[ifilehandle];
+    struct stat sstat;
+    void        *pvmap;
+
+    if ( likely(psfile->pcdictmap != NULL) ) {
+        return psfile->pcdictmap;
+    }
+    /* Touching a mapped page beyond the end of the file faults */
+    if ( fstat (psfile->ihandle, &sstat) || sstat.st_size < (off_t)sizeof (struct DICTNODE) ) {
+        return NULL;
+    }
+    pvmap = mmap (NULL, sizeof (struct DICTNODE), PROT_READ, MAP_SHARED, psfile->ihandle, (off_t)0);
+    if ( pvmap == MAP_FAILED ) {
+        return NULL;
+    }
+    psfile->pcdictmap = (VB_CHAR *)pvmap;
+    return psfile->pcdictmap;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * The block buffer pool caches the blocks of every open file, keyed on the
+ * svbfile[] slot (thus the .idx or .dat) and the block number.  Rows are
+ * read and written directly by vbdataio.c, so in practice only index (and
+ * varlen) nodes pass through here.
+ * Writes go through to the file and update the pool, so our own changes
+ * never make it stale.  Changes made by other processes are detected by
+ * vvbbuffersync () comparing the Dict.Trans read by ivbenter () against the
+ * value the cached blocks were valid for.
+ * The dictionary node is never cached since ivbenter () MUST see it fresh.
+ */
+static struct VBPOOL *
+psvbpoolget (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBPOOL   *pspool;
+    int     ibuffers, ihashsize, iloop;
+
+    if ( likely(vb_rtd->psvbpool != NULL) ) {
+        return vb_rtd->psvbpool;
+    }
+    ibuffers = vb_rtd->ipoolsize / (int)sizeof (struct VBBUFFER);
+    if ( ibuffers < 1 ) {
+        return NULL;
+    }
+    for ( ihashsize = 1; ihashsize < ibuffers; ihashsize <<= 1 ) {
+        ;
+    }
+    pspool = pvvbmalloc (sizeof (struct VBPOOL));
+    if ( !pspool ) {
+        return NULL;
+    }
+    pspool->pshash = pvvbmalloc (sizeof (struct VBBUFFER *) * ihashsize);
+    pspool->psbuffer = pvvbmalloc (sizeof (struct VBBUFFER) * ibuffers);
+    if ( !pspool->pshash || !pspool->psbuffer ) {
+        if ( pspool->pshash ) {
+            vvbfree (pspool->pshash, sizeof (struct VBBUFFER *) * ihashsize);
+        }
+        if ( pspool->psbuffer ) {
+            vvbfree (pspool->psbuffer, sizeof (struct VBBUFFER) * ibuffers);
+        }
+        vvbfree (pspool, sizeof (struct VBPOOL));
+        return NULL;
+    }
+    pspool->ibuffers = ibuffers;
+    pspool->ihashmask = ihashsize - 1;
+    for ( iloop = 0; iloop < VB_MAX_FILES * 3; iloop++ ) {
+        pspool->ttransnumber[iloop] = -1;
+    }
+    vb_rtd->psvbpool = pspool;
+    return pspool;
+}
+
+static struct VBBUFFER **
+ppsvbbufferchain (struct VBPOOL *pspool, const int ifilehandle, off_t tblocknumber)
+{
+    unsigned int    uhash;
+
+    uhash = ((unsigned int)ifilehandle * 0x9e3779b1U) ^ (unsigned int)tblocknumber;
+    return &pspool->pshash[uhash & (unsigned int)pspool->ihashmask];
+}
+
+static struct VBBUFFER *
+psvbbufferfind (struct VBPOOL *pspool, const int ifilehandle, off_t tblocknumber)
+{
+    struct VBBUFFER *psbuffer;
+
+    psbuffer = *ppsvbbufferchain (pspool, ifilehandle, tblocknumber);
+    while ( psbuffer ) {
+        if ( psbuffer->tblocknumber == tblocknumber
+             && psbuffer->ifilehandle == ifilehandle ) {
+            return psbuffer;
+        }
+        psbuffer = psbuffer->psnext;
+    }
+    return NULL;
+}
+
+static void
+vvbbufferunhash (struct VBPOOL *pspool, struct VBBUFFER *psbuffer)
+{
+    struct VBBUFFER **ppsbuffer;
+
+    ppsbuffer = ppsvbbufferchain (pspool, psbuffer->ifilehandle, psbuffer->tblocknumber);
+    while ( *ppsbuffer ) {
+        if ( *ppsbuffer == psbuffer ) {
+            *ppsbuffer = psbuffer->psnext;
+            break;
+        }
+        ppsbuffer = &(*ppsbuffer)->psnext;
+    }
+    psbuffer->psnext = NULL;
+    psbuffer->tblocknumber = 0;
+}
+
+static void
+vvbbufferstore (const int ifilehandle, off_t tblocknumber, VB_CHAR *cbuffer,
+                const int ilength)
+{
+    struct VBPOOL   *pspool;
+    struct VBBUFFER *psbuffer, **ppsbuffer;
+
+    pspool = psvbpoolget ();
+    if ( !pspool ) {
+        return;
+    }
+    psbuffer = psvbbufferfind (pspool, ifilehandle, tblocknumber);
+    if ( !psbuffer ) {
+        /* CLOCK: Skip (and age) the recently referenced buffers */
+        while ( 1 ) {
+            psbuffer = &pspool->psbuffer[pspool->iclockhand];
+            pspool->iclockhand++;
+            if ( pspool->iclockhand == pspool->ibuffers ) {
+                pspool->iclockhand = 0;
+            }
+            if ( !psbuffer->iisreferenced ) {
+                break;
+            }
+            psbuffer->iisreferenced = 0;
+        }
+        if ( psbuffer->tblocknumber ) {
+            vvbbufferunhash (pspool, psbuffer);
+        }
+        psbuffer->ifilehandle = ifilehandle;
+        psbuffer->tblocknumber = tblocknumber;
+        ppsbuffer = ppsvbbufferchain (pspool, ifilehandle, tblocknumber);
+        psbuffer->psnext = *ppsbuffer;
+        *ppsbuffer = psbuffer;
+    }
+    psbuffer->iisreferenced = 1;
+    memcpy (psbuffer->cblock, cbuffer, (size_t)ilength);
+}
+
+void
+vvbbufferinvalidate (const int ifilehandle)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBPOOL   *pspool = vb_rtd->psvbpool;
+    int     iloop;
+
+    if ( !pspool ) {
+        return;
+    }
+    for ( iloop = 0; iloop < pspool->ibuffers; iloop++ ) {
+        if ( pspool->psbuffer[iloop].tblocknumber
+             && pspool->psbuffer[iloop].ifilehandle == ifilehandle ) {
+            vvbbufferunhash (pspool, &pspool->psbuffer[iloop]);
+            pspool->psbuffer[iloop].iisreferenced = 0;
+        }
+    }
+    pspool->ttransnumber[ifilehandle] = -1;
+}
+
+/*
+ * Called with the dictionary node freshly read (ivbenter) or just rewritten
+ * by ourselves (ivbexit, iownchange set).  In the former case, any change in
+ * Dict.Trans means some other process has altered the files underneath us.
+ */
+void
+vvbbuffersync (const int ihandle, const int iownchange)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct DICTINFO *psvbptr;
+    struct VBPOOL   *pspool = vb_rtd->psvbpool;
+    off_t       ttransnumber;
+
+    if ( !pspool ) {
+        return;
+    }
+    psvbptr = vb_rtd->psvbfile[ihandle];
+    ttransnumber = inl_ldquad (psvbptr->sdictnode.ctransnumber);
+    if ( !iownchange ) {
+        if ( pspool->ttransnumber[psvbptr->iindexhandle] != ttransnumber ) {
+            vvbbufferinvalidate (psvbptr->iindexhandle);
+        }
+        if ( pspool->ttransnumber[psvbptr->idatahandle] != ttransnumber ) {
+            vvbbufferinvalidate (psvbptr->idatahandle);
+        }
+    }
+    pspool->ttransnumber[psvbptr->iindexhandle] = ttransnumber;
+    pspool->ttransnumber[psvbptr->idatahandle] = ttransnumber;
+}
+
+void
+vvbbufferfree (void)
+{
+    vb_rtd_t *vb_rtd =VB_GET_RTD;
+    struct VBPOOL   *pspool = vb_rtd->psvbpool;
+
+    if ( !pspool ) {
+        return;
+    }
+    vvbfree (pspool->pshash, sizeof (struct VBBUFFER *) * (pspool->ihashmask + 1));
+    vvbfree (pspool->psbuffer, sizeof (struct VBBUFFER) * pspool->ibuffers);
+    vvbfree (pspool, sizeof (struct VBPOOL));
+    vb_rtd->psvbpool = NULL;
+}
+
 int
 ivbblockread (const int ihandle, const int iisindex, off_t tblocknumber, VB_CHAR *cbuffer)
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbfptr;
+    struct VBBUFFER *psbuffer;
+    VB_CHAR     *pcblock;
     off_t       tresult, toffset;
-    int     thandle;
+    int     thandle, iispooled;
 
     psvbfptr = vb_rtd->psvbfile[ihandle];
     toffset = (off_t) ((tblocknumber - 1) * psvbfptr->inodesize);
@@ -172,24 +540,24 @@ ivbblockread (const int ihandle, const int iisindex, off_t tblocknumber, VB_CHAR
     } else {
         thandle = psvbfptr->idatahandle;
     }
-    tresult = tvblseek (thandle, toffset, SEEK_SET);
-    if ( tresult != toffset ) {
-#ifdef	VBDEBUG
-        fprintf (stderr,
-#if	ISAMMODE == 1
-                 "Failed to position to block %lld of the %s file of table %s!\n",
-#else
-                 "Failed to position to block %ld of the %s file of table %s!\n",
-#endif
-                 tblocknumber, iisindex ? "Index" : "Data",
-                 psvbfptr->cfilename);
-        assert (0);
-#else
-        return EIO;
-#endif
+    if ( vb_rtd->svbfile[thandle].iismapped ) {
+        pcblock = pcvbmapped (thandle, toffset, (size_t)psvbfptr->inodesize);
+        if ( pcblock ) {
+            memcpy (cbuffer, pcblock, (size_t)psvbfptr->inodesize);
+            return 0;
+        }
     }
-
-    tresult = (off_t) tvbread (thandle, cbuffer, (size_t) psvbfptr->inodesize);
+    iispooled = vb_rtd->ipoolsize && (!iisindex || tblocknumber != 1)
+                && !vb_rtd->svbfile[thandle].iismapped;
+    if ( iispooled && vb_rtd->psvbpool ) {
+        psbuffer = psvbbufferfind (vb_rtd->psvbpool, thandle, tblocknumber);
+        if ( psbuffer ) {
+            psbuffer->iisreferenced = 1;
+            memcpy (cbuffer, psbuffer->cblock, (size_t)psvbfptr->inodesize);
+            return 0;
+        }
+    }
+    tresult = (off_t) tvbpread (thandle, cbuffer, (size_t) psvbfptr->inodesize, toffset);
     if ( !iisindex && tresult == 0 ) {
         tresult = (ssize_t) psvbfptr->inodesize;
         memset (cbuffer, 0, (size_t)psvbfptr->inodesize);
@@ -208,6 +576,9 @@ ivbblockread (const int ihandle, const int iisindex, off_t tblocknumber, VB_CHAR
         return EIO;
 #endif
     }
+    if ( iispooled ) {
+        vvbbufferstore (thandle, tblocknumber, cbuffer, psvbfptr->inodesize);
+    }
     return 0;
 }
 
@@ -216,6 +587,7 @@ ivbblockwrite (const int ihandle, const int iisindex, off_t tblocknumber, VB_CHA
 {
     vb_rtd_t *vb_rtd =VB_GET_RTD;
     struct DICTINFO *psvbfptr;
+    struct VBBUFFER *psbuffer;
     off_t       tresult, toffset;
     int     thandle;
 
@@ -226,24 +598,18 @@ ivbblockwrite (const int ihandle, const int iisindex, off_t tblocknumber, VB_CHA
     } else {
         thandle = psvbfptr->idatahandle;
     }
-    tresult = tvblseek (thandle, toffset, SEEK_SET);
-    if ( tresult == (off_t) -1 ) {
-#ifdef	VBDEBUG
-        fprintf (stderr,
-#if	ISAMMODE == 1
-                 "Failed to position to block %lld of the %s file of table %s!\n",
-#else
-                 "Failed to position to block %ld of the %s file of table %s!\n",
-#endif
-                 tblocknumber, iisindex ? "Index" : "Data",
-                 psvbfptr->cfilename);
-        assert (0);
-#else
-        return EIO;
-#endif
+    tresult = (off_t) tvbpwrite (thandle, cbuffer, (size_t) psvbfptr->inodesize, toffset);
+    if ( vb_rtd->ipoolsize && (!iisindex || tblocknumber != 1)
+         && !vb_rtd->svbfile[thandle].iismapped ) {
+        if ( (int)tresult == psvbfptr->inodesize ) {
+            vvbbufferstore (thandle, tblocknumber, cbuffer, psvbfptr->inodesize);
+        } else if ( vb_rtd->psvbpool ) {
+            psbuffer = psvbbufferfind (vb_rtd->psvbpool, thandle, tblocknumber);
+            if ( psbuffer ) {
+                vvbbufferunhash (vb_rtd->psvbpool, psbuffer);
+            }
+        }
     }
-
-    tresult = (off_t) tvbwrite (thandle, cbuffer, (size_t) psvbfptr->inodesize);
     if ( (int)tresult != psvbfptr->inodesize ) {
 #ifdef	VBDEBUG
 #if	ISAMMODE == 1
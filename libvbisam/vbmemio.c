@@ -58,6 +58,11 @@ vb_init_rtd (void)
 
 	vb_rtd->ivblogfilehandle = -1;		/* Handle of the current logfile */
 	vb_rtd->ivbmaxusedhandle = -1;		/* The highest opened file handle */
+	vb_rtd->ipoolsize = VB_POOLSIZE;	/* Block buffer pool budget */
+	vb_rtd->tnodecache = VB_NODECACHE;	/* Retained node budget */
+	vb_rtd->tsortmemory = VB_SORTMEMORY;	/* Bulk index build sort budget */
+	vb_rtd->ifillfactor = VB_FILLFACTOR;	/* Bulk index build node fill */
+	vb_rtd->ilogbuffer = VB_LOGBUFFER;	/* Transaction log staging budget */
 #ifdef	VBDEBUG
 	vb_rtd->icurrhandle = -1;
 #endif
@@ -107,6 +112,53 @@ end_get_rtd:
 	return res;
 }
 
+/*
+ * Hand out the next never used object of a slab pool, starting a new chunk
+ * when the newest one is used up.  The chunks come zeroed from pvvbmalloc.
+ * Freed objects are kept on the caller's own free list and the chunks are
+ * only ever released as a whole, by vvbslabfree ().
+ */
+static void *
+pvvbslaballoc (struct VBSLABPOOL *pspool, size_t tsize)
+{
+	struct VBSLAB	*psslab;
+	int		iperslab;
+
+	if (!pspool->iunused) {
+		tsize = (tsize + sizeof (off_t) - 1) & ~(sizeof (off_t) - 1);
+		iperslab = VB_SLABSIZE / tsize;
+		if (iperslab < 8) {
+			iperslab = 8;
+		}
+		psslab = pvvbmalloc (sizeof (struct VBSLAB) + iperslab * tsize);
+		if (!psslab) {
+			return NULL;
+		}
+		/* (Set afterwards, a VBDEBUG pvvbmalloc may have emptied the pool) */
+		pspool->tsize = tsize;
+		pspool->iperslab = iperslab;
+		psslab->psnext = pspool->psslab;
+		pspool->psslab = psslab;
+		pspool->iunused = pspool->iperslab;
+	}
+	pspool->iunused--;
+	return (VB_CHAR *)(pspool->psslab + 1)
+	       + (pspool->iperslab - pspool->iunused - 1) * pspool->tsize;
+}
+
+static void
+vvbslabfree (struct VBSLABPOOL *pspool)
+{
+	struct VBSLAB	*psslab;
+
+	while (pspool->psslab) {
+		psslab = pspool->psslab;
+		pspool->psslab = psslab->psnext;
+		vvbfree (psslab, sizeof (struct VBSLAB) + pspool->iperslab * pspool->tsize);
+	}
+	memset (pspool, 0, sizeof (struct VBSLABPOOL));
+}
+
 struct VBLOCK *
 psvblockallocate (const int ihandle)
 {
@@ -120,11 +172,14 @@ psvblockallocate (const int ihandle)
 		vb_rtd->pslockfree = vb_rtd->pslockfree->psnext;
 		memset (pslock, 0, sizeof (struct VBLOCK));
 	} else {
-		pslock = pvvbmalloc (sizeof (struct VBLOCK));
+		pslock = pvvbslaballoc (&vb_rtd->slockslab, sizeof (struct VBLOCK));
 	}
 #ifdef	VBDEBUG
 	vb_rtd->icurrhandle = -1;
 #endif
+	if (pslock) {
+		vb_rtd->slockslab.ilive++;
+	}
 	return pslock;
 }
 
@@ -134,35 +189,365 @@ vvblockfree (struct VBLOCK *pslock)
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
 	pslock->psnext = vb_rtd->pslockfree;
 	vb_rtd->pslockfree = pslock;
+	vb_rtd->slockslab.ilive--;
+}
+
+/*
+ * Release the VBLOCK chunks once no lock is held any more
+ */
+void
+vvblockunmalloc (void)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (vb_rtd->slockslab.ilive) {
+		return;
+	}
+	vb_rtd->pslockfree = NULL;
+	vvbslabfree (&vb_rtd->slockslab);
 }
 
 struct VBTREE *
 psvbtreeallocate (const int ihandle)
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
-	struct VBTREE *pstree = vb_rtd->pstreefree;
+	struct DICTINFO	*psvbptr = vb_rtd->psvbfile[ihandle];
+	struct VBTREE *pstree = psvbptr->pstreefree;
 
 #ifdef	VBDEBUG
 	vb_rtd->icurrhandle = ihandle;
 #endif
-	if (vb_rtd->pstreefree == NULL) {
-		pstree = pvvbmalloc (sizeof (struct VBTREE));
+	if (psvbptr->pstreefree == NULL) {
+		pstree = pvvbslaballoc (&psvbptr->streeslab, sizeof (struct VBTREE));
 	} else {
-		vb_rtd->pstreefree = vb_rtd->pstreefree->psnext;
-		memset (pstree, 0, sizeof (struct VBTREE));
 #ifdef	VBDEBUG
 		if (pstree->tnodenumber != -1) {
 			printf ("TreeAllocated that doesn't seem to be free!\n");
 			assert (0);
 		}
 #endif	/* VBDEBUG */
+		psvbptr->pstreefree = psvbptr->pstreefree->psnext;
+		memset (pstree, 0, sizeof (struct VBTREE));
 	}
 #ifdef	VBDEBUG
 	vb_rtd->icurrhandle = -1;
 #endif
+	if (pstree) {
+		psvbptr->streeslab.ilive++;
+		pstree->ihandle = ihandle;
+		pstree->iisretained = 1;
+		pstree->pslruolder = vb_rtd->pstreemru;
+		if (vb_rtd->pstreemru) {
+			vb_rtd->pstreemru->pslrunewer = pstree;
+		} else {
+			vb_rtd->pstreelru = pstree;
+		}
+		vb_rtd->pstreemru = pstree;
+		vb_rtd->inodes++;
+		vb_rtd->tnodebytes += sizeof (struct VBTREE);
+		if (vb_rtd->tnodebytes > vb_rtd->tnodepeak) {
+			vb_rtd->tnodepeak = vb_rtd->tnodebytes;
+		}
+	}
 	return pstree;
 }
 
+static void
+vvbtreeunlink (struct VBTREE *pstree)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (pstree->pslrunewer) {
+		pstree->pslrunewer->pslruolder = pstree->pslruolder;
+	} else {
+		vb_rtd->pstreemru = pstree->pslruolder;
+	}
+	if (pstree->pslruolder) {
+		pstree->pslruolder->pslrunewer = pstree->pslrunewer;
+	} else {
+		vb_rtd->pstreelru = pstree->pslrunewer;
+	}
+	pstree->pslrunewer = NULL;
+	pstree->pslruolder = NULL;
+}
+
+static void
+vvbtreeslotsfree (struct VBTREE *pstree)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (!pstree->islots) {
+		return;
+	}
+	vvbfree (pstree->ptrownode, pstree->tslotsize);
+	vb_rtd->tnodebytes -= pstree->tslotsize;
+	pstree->islots = 0;
+	pstree->tslotsize = 0;
+	pstree->ptrownode = NULL;
+	pstree->ptdupnumber = NULL;
+	pstree->ptprefix = NULL;
+	pstree->pskeylist = NULL;
+	pstree->pckeyslots = NULL;
+}
+
+/*
+ * Copy a key into one slot of its node's slot arrays
+ */
+static void
+vvbtreeslotfill (struct DICTINFO *psvbptr, const int ikeynumber, struct VBTREE *pstree,
+		 unsigned int islot, struct VBKEY *pskey)
+{
+	VB_UCHAR	*pcslot;
+	size_t		tkeylen;
+
+	tkeylen = psvbptr->pskeydesc[ikeynumber]->k_len;
+	pstree->ptrownode[islot] = pskey->trownode;
+	pstree->ptdupnumber[islot] = pskey->tdupnumber;
+	pstree->pskeylist[islot] = pskey;
+	pskey->islot = islot;
+	pcslot = pstree->pckeyslots + islot * tkeylen;
+	if (pskey->iishigh) {
+		/* Whatever is stored, it covers everything beyond */
+		memset (pcslot, 0xff, tkeylen);
+	} else {
+		vvbkeynormalize (psvbptr->pskeydesc[ikeynumber],
+				 psvbptr->collating_sequence, pskey->ckey, pcslot);
+	}
+	pstree->ptprefix[islot] = tvbkeyprefix (pcslot, (int)tkeylen);
+}
+
+/*
+ * Move the slots from islot onwards by one, up (idelta = 1) to make room
+ * or down (idelta = -1) over the slot being removed
+ */
+static void
+vvbtreeslotshift (const size_t tkeylen, struct VBTREE *pstree, unsigned int islot,
+		  const int idelta)
+{
+	unsigned int	ifrom, ito, iloop;
+	size_t		tcount;
+
+	ifrom = idelta > 0 ? islot : islot + 1;
+	ito = idelta > 0 ? islot + 1 : islot;
+	tcount = pstree->ikeysinnode - ifrom;
+	if (tcount) {
+		memmove (pstree->ptrownode + ito, pstree->ptrownode + ifrom,
+			 tcount * sizeof (off_t));
+		memmove (pstree->ptdupnumber + ito, pstree->ptdupnumber + ifrom,
+			 tcount * sizeof (off_t));
+		memmove (pstree->ptprefix + ito, pstree->ptprefix + ifrom,
+			 tcount * sizeof (long long));
+		memmove (pstree->pskeylist + ito, pstree->pskeylist + ifrom,
+			 tcount * sizeof (struct VBKEY *));
+		memmove (pstree->pckeyslots + ito * tkeylen,
+			 pstree->pckeyslots + ifrom * tkeylen, tcount * tkeylen);
+	}
+	pstree->ikeysinnode += idelta;
+	for (iloop = ito; iloop < ito + tcount; iloop++) {
+		pstree->pskeylist[iloop]->islot = iloop;
+	}
+}
+
+/*
+ * (Re)build the slot arrays of a node from its key list
+ */
+int
+ivbtreeslots (const int ihandle, const int ikeynumber, struct VBTREE *pstree)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct VBKEY	*pskey;
+	struct DICTINFO	*psvbptr;
+	unsigned int	icount = 0, islots;
+	size_t		tkeylen, tslotsize;
+
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	tkeylen = psvbptr->pskeydesc[ikeynumber]->k_len;
+	for (pskey = pstree->pskeyfirst; pskey; pskey = pskey->psnext) {
+		icount++;
+	}
+	if (icount > pstree->islots) {
+		vvbtreeslotsfree (pstree);
+		islots = (icount + 15) & ~15;
+		tslotsize = islots * (2 * sizeof (off_t) + sizeof (long long)
+				      + sizeof (struct VBKEY *) + tkeylen);
+		pstree->ptrownode = pvvbmalloc (tslotsize);
+		if (!pstree->ptrownode) {
+			pstree->ikeysinnode = 0;
+			return errno ? errno : EBADMEM;
+		}
+		pstree->islots = islots;
+		pstree->tslotsize = tslotsize;
+		pstree->ptdupnumber = pstree->ptrownode + islots;
+		pstree->ptprefix = (long long *)(pstree->ptdupnumber + islots);
+		pstree->pskeylist = (struct VBKEY **)(pstree->ptprefix + islots);
+		pstree->pckeyslots = (VB_UCHAR *)(pstree->pskeylist + islots);
+		vb_rtd->tnodebytes += pstree->tslotsize;
+		if (vb_rtd->tnodebytes > vb_rtd->tnodepeak) {
+			vb_rtd->tnodepeak = vb_rtd->tnodebytes;
+		}
+	}
+	pstree->ikeysinnode = 0;
+	for (pskey = pstree->pskeyfirst; pskey; pskey = pskey->psnext) {
+		vvbtreeslotfill (psvbptr, ikeynumber, pstree, pstree->ikeysinnode, pskey);
+		pstree->ikeysinnode++;
+	}
+	return 0;
+}
+
+/*
+ * Give a key just linked into a node's key list its own slot, moving the
+ * ones after it up by one rather than rebuilding them all
+ */
+int
+ivbtreeslotinsert (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
+		   struct VBKEY *pskey)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+	unsigned int	islot;
+
+	if (pstree->ikeysinnode >= pstree->islots) {
+		/* Out of room, so the arrays have to grow anyway */
+		return ivbtreeslots (ihandle, ikeynumber, pstree);
+	}
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	islot = pskey->psnext ? pskey->psnext->islot : pstree->ikeysinnode;
+	vvbtreeslotshift (psvbptr->pskeydesc[ikeynumber]->k_len, pstree, islot, 1);
+	vvbtreeslotfill (psvbptr, ikeynumber, pstree, islot, pskey);
+	return 0;
+}
+
+/*
+ * Drop the slot of a key that is about to be unlinked from its node
+ */
+void
+vvbtreeslotdelete (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
+		   struct VBKEY *pskey)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	vvbtreeslotshift (vb_rtd->psvbfile[ihandle]->pskeydesc[ikeynumber]->k_len,
+			  pstree, pskey->islot, -1);
+}
+
+/*
+ * Refresh the slot of a key whose value, row / node or high flag changed
+ */
+void
+vvbtreeslotupdate (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
+		   struct VBKEY *pskey)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	vvbtreeslotfill (vb_rtd->psvbfile[ihandle], ikeynumber, pstree, pskey->islot, pskey);
+}
+
+/*
+ * Rebuild the slot arrays of a node and every cached node below it
+ */
+int
+ivbtreeslotsall (const int ihandle, const int ikeynumber, struct VBTREE *pstree)
+{
+	struct VBKEY	*pskey;
+	int		iresult;
+
+	if (!pstree) {
+		return 0;
+	}
+	for (pskey = pstree->pskeyfirst; pskey; pskey = pskey->psnext) {
+		iresult = ivbtreeslotsall (ihandle, ikeynumber, pskey->pschild);
+		if (iresult) {
+			return iresult;
+		}
+	}
+	return ivbtreeslots (ihandle, ikeynumber, pstree);
+}
+
+/*
+ * Mark a retained node as the most recently used one
+ */
+void
+vvbtreetouch (struct VBTREE *pstree)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (!pstree->iisretained || vb_rtd->pstreemru == pstree) {
+		return;
+	}
+	vvbtreeunlink (pstree);
+	pstree->pslruolder = vb_rtd->pstreemru;
+	if (vb_rtd->pstreemru) {
+		vb_rtd->pstreemru->pslrunewer = pstree;
+	} else {
+		vb_rtd->pstreelru = pstree;
+	}
+	vb_rtd->pstreemru = pstree;
+}
+
+/*
+ * Return the index a retained node belongs to, or -1 if it must be kept
+ * because it is a root or lies on the path to the current key.
+ */
+static int
+ivbtreeevictable (struct VBTREE *pstree)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+	int		iloop, iiscurrent = 1;
+
+	if (!pstree->psparent) {
+		return -1;
+	}
+	for (; pstree->psparent; pstree = pstree->psparent) {
+		if (!pstree->psparent->pskeycurr
+		    || pstree->psparent->pskeycurr->pschild != pstree) {
+			iiscurrent = 0;
+		}
+	}
+	psvbptr = vb_rtd->psvbfile[pstree->ihandle];
+	if (iiscurrent || !psvbptr) {
+		return -1;
+	}
+	for (iloop = 0; iloop < psvbptr->inkeys; iloop++) {
+		if (psvbptr->pstree[iloop] == pstree) {
+			return iloop;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Discard the least recently used nodes (with everything below them) of
+ * all the open tables until the retained nodes fit in the budget again.
+ * The roots and the path down to each current key are always kept.
+ */
+void
+vvbtreetrim (void)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct VBTREE	*pstree;
+	struct VBKEY	*pskey;
+	int		ikeynumber, iskipped = 0;
+
+	while (vb_rtd->tnodebytes > vb_rtd->tnodecache && vb_rtd->pstreelru
+	       && iskipped < vb_rtd->inodes) {
+		pstree = vb_rtd->pstreelru;
+		ikeynumber = ivbtreeevictable (pstree);
+		if (ikeynumber < 0) {
+			vvbtreetouch (pstree);
+			iskipped++;
+			continue;
+		}
+		for (pskey = pstree->psparent->pskeyfirst; pskey; pskey = pskey->psnext) {
+			if (pskey->pschild == pstree) {
+				pskey->pschild = NULL;
+			}
+		}
+		vvbtreeallfree (pstree->ihandle, ikeynumber, pstree);
+		vb_rtd->tnodeevictions++;
+	}
+}
+
 void
 vvbtreeallfree (const int ihandle, const int ikeynumber, struct VBTREE *pstree)
 {
@@ -177,8 +562,15 @@ vvbtreeallfree (const int ihandle, const int ikeynumber, struct VBTREE *pstree)
 	}
 #endif	/* VBDEBUG */
 	vvbkeyallfree (ihandle, ikeynumber, pstree);
-	pstree->psnext = vb_rtd->pstreefree;
-	vb_rtd->pstreefree = pstree;
+	if (pstree->iisretained) {
+		vvbtreeunlink (pstree);
+		pstree->iisretained = 0;
+		vb_rtd->inodes--;
+		vb_rtd->tnodebytes -= sizeof (struct VBTREE);
+	}
+	pstree->psnext = vb_rtd->psvbfile[ihandle]->pstreefree;
+	vb_rtd->psvbfile[ihandle]->pstreefree = pstree;
+	vb_rtd->psvbfile[ihandle]->streeslab.ilive--;
 	pstree->tnodenumber = -1;
 }
 
@@ -188,7 +580,6 @@ psvbkeyallocate (const int ihandle, const int ikeynumber)
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
 	struct VBKEY	*pskey;
 	struct DICTINFO	*psvbptr;
-	int		ilength = 0;
 
 	psvbptr = vb_rtd->psvbfile[ihandle];
 	pskey = psvbptr->pskeyfree[ikeynumber];
@@ -196,8 +587,9 @@ psvbkeyallocate (const int ihandle, const int ikeynumber)
 #ifdef	VBDEBUG
 		vb_rtd->icurrhandle = ihandle;
 #endif
-		ilength = psvbptr->pskeydesc[ikeynumber]->k_len;
-		pskey = pvvbmalloc (sizeof (struct VBKEY) + ilength);
+		pskey = pvvbslaballoc (&psvbptr->skeyslab[ikeynumber],
+				       sizeof (struct VBKEY)
+				       + psvbptr->pskeydesc[ikeynumber]->k_len);
 #ifdef	VBDEBUG
 		vb_rtd->icurrhandle = -1;
 #endif
@@ -210,7 +602,17 @@ psvbkeyallocate (const int ihandle, const int ikeynumber)
 #endif	/* VBDEBUG */
 		psvbptr->pskeyfree[ikeynumber] =
 		    psvbptr->pskeyfree[ikeynumber]->psnext;
-		memset (pskey, 0, (sizeof (struct VBKEY) + ilength));
+		memset (pskey, 0, sizeof (struct VBKEY)
+			+ psvbptr->pskeydesc[ikeynumber]->k_len);
+	}
+	if (pskey) {
+		psvbptr->skeyslab[ikeynumber].ilive++;
+		vb_rtd->ikeys++;
+		vb_rtd->tnodebytes += sizeof (struct VBKEY)
+				      + psvbptr->pskeydesc[ikeynumber]->k_len;
+		if (vb_rtd->tnodebytes > vb_rtd->tnodepeak) {
+			vb_rtd->tnodepeak = vb_rtd->tnodebytes;
+		}
 	}
 	return pskey;
 }
@@ -239,11 +641,16 @@ vvbkeyallfree (const int ihandle, const int ikeynumber, struct VBTREE *pstree)
 		psvbptr->pskeyfree[ikeynumber] = pskeycurr;
 		pskeycurr->trownode = -1;
 		pskeycurr = pskeynext;
+		psvbptr->skeyslab[ikeynumber].ilive--;
+		vb_rtd->ikeys--;
+		vb_rtd->tnodebytes -= sizeof (struct VBKEY)
+				      + psvbptr->pskeydesc[ikeynumber]->k_len;
 	}
 	pstree->pskeyfirst = NULL;
 	pstree->pskeylast = NULL;
 	pstree->pskeycurr = NULL;
 	pstree->ikeysinnode = 0;
+	vvbtreeslotsfree (pstree);
 }
 
 void
@@ -272,25 +679,71 @@ vvbkeyfree (const int ihandle, const int ikeynumber, struct VBKEY *pskey)
 	pskey->psnext = psvbptr->pskeyfree[ikeynumber];
 	psvbptr->pskeyfree[ikeynumber] = pskey;
 	pskey->trownode = -1;
+	psvbptr->skeyslab[ikeynumber].ilive--;
+	vb_rtd->ikeys--;
+	vb_rtd->tnodebytes -= sizeof (struct VBKEY)
+			      + psvbptr->pskeydesc[ikeynumber]->k_len;
 }
 
+/*
+ * Release every VBKEY of an index at once, they must all be free by now
+ */
 void
 vvbkeyunmalloc (const int ihandle, const int ikeynumber)
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
 	struct DICTINFO	*psvbptr;
-	struct VBKEY	*pskeycurr;
-	int		ilength;
 
 	psvbptr = vb_rtd->psvbfile[ihandle];
-	pskeycurr = psvbptr->pskeyfree[ikeynumber];
-	ilength = sizeof (struct VBKEY) + psvbptr->pskeydesc[ikeynumber]->k_len;
-	while (pskeycurr) {
-		psvbptr->pskeyfree[ikeynumber] =
-	     psvbptr->pskeyfree[ikeynumber]->psnext;
-	 vvbfree (pskeycurr, ilength);
-	 pskeycurr = psvbptr->pskeyfree[ikeynumber];
-  }
+#ifdef	VBDEBUG
+	assert (psvbptr->skeyslab[ikeynumber].ilive == 0);
+#endif	/* VBDEBUG */
+	psvbptr->pskeyfree[ikeynumber] = NULL;
+	vvbslabfree (&psvbptr->skeyslab[ikeynumber]);
+}
+
+/*
+ * Release all of the cached nodes and keys of a table being closed.
+ * Rather than walking every key, the trees still in use are taken off the
+ * LRU list and then whole chunks are handed back.
+ */
+void
+vvbtableunmalloc (const int ihandle)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+	struct VBSLAB	*psslab;
+	struct VBTREE	*pstree;
+	int		iloop, icount;
+
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	icount = psvbptr->streeslab.iperslab - psvbptr->streeslab.iunused;
+	for (psslab = psvbptr->streeslab.psslab; psslab; psslab = psslab->psnext) {
+		pstree = (struct VBTREE *)(psslab + 1);
+		for (iloop = 0; iloop < icount; iloop++, pstree++) {
+			if (!pstree->iisretained) {
+				continue;
+			}
+			vvbtreeunlink (pstree);
+			vb_rtd->inodes--;
+			vb_rtd->tnodebytes -= sizeof (struct VBTREE);
+			vvbtreeslotsfree (pstree);
+		}
+		icount = psvbptr->streeslab.iperslab;
+	}
+	vvbslabfree (&psvbptr->streeslab);
+	psvbptr->pstreefree = NULL;
+	for (iloop = 0; iloop < MAXSUBS; iloop++) {
+		psvbptr->pstree[iloop] = NULL;
+		psvbptr->pskeycurr[iloop] = NULL;
+		psvbptr->pskeyfree[iloop] = NULL;
+		if (psvbptr->skeyslab[iloop].ilive) {
+			vb_rtd->ikeys -= psvbptr->skeyslab[iloop].ilive;
+			vb_rtd->tnodebytes -= psvbptr->skeyslab[iloop].ilive
+					      * (sizeof (struct VBKEY) + psvbptr->pskeydesc[iloop]->k_len);
+		}
+		vvbslabfree (&psvbptr->skeyslab[iloop]);
+	}
 }
 
 #ifdef	VBDEBUG
@@ -299,76 +752,40 @@ pvvbmalloc (const size_t tlength)
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
 	void		*pvpointer;
-	struct VBKEY	*pskey;
-	struct VBLOCK	*pslock;
-	struct VBTREE	*pstree;
+	struct DICTINFO	*psvbptr;
 	int		iloop, iloop2;
 
 	pvpointer = malloc (tlength);
 	if (!pvpointer) {
-		/* Firstly, try by freeing up the truely free data */
+		/* Firstly, try by freeing up the chunks that are truely free */
 		for (iloop = 0; iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
-			if (vb_rtd->psvbfile[iloop]) {
-				for (iloop2 = 0; iloop2 < vb_rtd->psvbfile[iloop]->inkeys; iloop2++) {
-					pskey = vb_rtd->psvbfile[iloop]->pskeyfree[iloop2];
-					while (pskey) {
-						vb_rtd->psvbfile[iloop]->pskeyfree[iloop2] =
-						    pskey->psnext;
-						vvbfree (pskey,
-							 sizeof (struct VBKEY) +
-							 vb_rtd->psvbfile[iloop]->pskeydesc[iloop2]->
-							 k_len);
-						pskey = vb_rtd->psvbfile[iloop]->pskeyfree[iloop2];
+			psvbptr = vb_rtd->psvbfile[iloop];
+			if (psvbptr) {
+				for (iloop2 = 0; iloop2 < psvbptr->inkeys; iloop2++) {
+					if (!psvbptr->skeyslab[iloop2].ilive) {
+						vvbkeyunmalloc (iloop, iloop2);
 					}
 				}
 			}
 		}
-		pslock = vb_rtd->pslockfree;
-		while (pslock) {
-			vb_rtd->pslockfree = vb_rtd->pslockfree->psnext;
-			vvbfree (pslock, sizeof (struct VBLOCK));
-			pslock = vb_rtd->pslockfree;
-		}
-		pstree = vb_rtd->pstreefree;
-		while (pstree) {
-			vb_rtd->pstreefree = vb_rtd->pstreefree->psnext;
-			vvbfree (pstree, sizeof (struct VBTREE));
-			pstree = vb_rtd->pstreefree;
-		}
-	}
-	if (!pvpointer) {
+		vvblockunmalloc ();
 		pvpointer = malloc (tlength);
 	}
 	if (!pvpointer) {
 		/* Nope, that wasn't enough, try harder! */
 		for (iloop = 0; vb_rtd->icurrhandle != -1 && iloop <= vb_rtd->ivbmaxusedhandle; iloop++) {
-			if (vb_rtd->psvbfile[iloop] && iloop != vb_rtd->icurrhandle) {
-				for (iloop2 = 0; iloop2 < vb_rtd->psvbfile[iloop]->inkeys; iloop2++) {
-					vvbtreeallfree (iloop, iloop2,
-							vb_rtd->psvbfile[iloop]->pstree[iloop2]);
-					vb_rtd->psvbfile[iloop]->pstree[iloop2] = NULL;
-					vb_rtd->psvbfile[iloop]->pskeycurr[iloop2] = NULL;
-					pskey = vb_rtd->psvbfile[iloop]->pskeyfree[iloop2];
-					while (pskey) {
-						vb_rtd->psvbfile[iloop]->pskeyfree[iloop2] =
-						    pskey->psnext;
-						vvbfree (pskey,
-							 sizeof (struct VBKEY) +
-							 vb_rtd->psvbfile[iloop]->pskeydesc[iloop2]->
-							 k_len);
-						pskey = vb_rtd->psvbfile[iloop]->pskeyfree[iloop2];
-					}
+			psvbptr = vb_rtd->psvbfile[iloop];
+			if (psvbptr && iloop != vb_rtd->icurrhandle) {
+				for (iloop2 = 0; iloop2 < psvbptr->inkeys; iloop2++) {
+					vvbtreeallfree (iloop, iloop2, psvbptr->pstree[iloop2]);
+					psvbptr->pstree[iloop2] = NULL;
+					psvbptr->pskeycurr[iloop2] = NULL;
+					vvbkeyunmalloc (iloop, iloop2);
 				}
+				psvbptr->pstreefree = NULL;
+				vvbslabfree (&psvbptr->streeslab);
 			}
 		}
-		pstree = vb_rtd->pstreefree;
-		while (pstree) {
-			vb_rtd->pstreefree = vb_rtd->pstreefree->psnext;
-			vvbfree (pstree, sizeof (struct VBTREE));
-			pstree = vb_rtd->pstreefree;
-		}
-	}
-	if (!pvpointer) {
 		pvpointer = malloc (tlength);
 	}
 	if (!pvpointer) {
@@ -405,23 +822,7 @@ vvbmallocreport (void)
 void
 vvbunmalloc ()
 {
-	vb_rtd_t *vb_rtd =VB_GET_RTD;
-	struct VBLOCK *pslockcurr;
-	struct VBTREE *pstreecurr;
-
 	iscleanup ();
-	pslockcurr = vb_rtd->pslockfree;
-	while (pslockcurr) {
-		vb_rtd->pslockfree = vb_rtd->pslockfree->psnext;
-		vvbfree (pslockcurr, sizeof (struct VBLOCK));
-		pslockcurr = vb_rtd->pslockfree;
-	}
-	pstreecurr = vb_rtd->pstreefree;
-	while (pstreecurr) {
-		vb_rtd->pstreefree = vb_rtd->pstreefree->psnext;
-		vvbfree (pstreecurr, sizeof (struct VBTREE));
-		pstreecurr = vb_rtd->pstreefree;
-	}
 	vvbmallocreport ();
 }
 #endif	/* VBDEBUG */
@@ -25,6 +25,51 @@
 
 #define		TCC	(' ')	/* Trailing Compression Character */
 
+/*
+ * Note that the in-memory pstree now matches the node image just written
+ */
+static void
+vvbtreestamp (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
+	      VB_CHAR *pcnode)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+
+	if (pstree->tnodenumber != tnodenumber) {
+		return;
+	}
+#if	ISAMMODE == 1
+	pstree->ttransnumber = inl_ldquad (pcnode + INTSIZE);
+#endif	/* ISAMMODE == 1 */
+	pstree->iepoch = vb_rtd->psvbfile[ihandle]->iepoch;
+}
+
+/*
+ * Recalculate the iistof / iiseof flags of the cached children of pstree
+ * after it was reloaded or lost a key, following the first / last spines
+ * downwards for as long as the flags change
+ */
+void
+vvbtreeedges (struct VBTREE *pstree)
+{
+	struct VBKEY	*pskey;
+	struct VBTREE	*pschild;
+	VB_UCHAR	iistof, iiseof;
+
+	for (pskey = pstree->pskeyfirst; pskey; pskey = pskey->psnext) {
+		pschild = pskey->pschild;
+		if (!pschild) {
+			continue;
+		}
+		iistof = pstree->iistof && pskey == pstree->pskeyfirst;
+		iiseof = pstree->iiseof && pskey->psnext && pskey->psnext->iisdummy;
+		if (pschild->iistof != iistof || pschild->iiseof != iiseof) {
+			pschild->iistof = iistof;
+			pschild->iiseof = iiseof;
+			vvbtreeedges (pschild);
+		}
+	}
+}
+
 static int
 iquicknodesave (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
 		struct keydesc *pskeydesc, const int imode, const int iposn)
@@ -36,7 +81,7 @@ iquicknodesave (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
 	VB_CHAR	        cvbnodetmp[MAX_NODE_LENGTH];
 
 	/* Sanity checks */
-	if (!pstree || !pstree->pskeylist[iposn]) {
+	if (!pstree || iposn < 0 || (unsigned int)iposn >= pstree->ikeysinnode) {
 		return -1;
 	}
 	if (imode == 1 && !pstree->pskeylist[iposn]->iisnew) {
@@ -58,6 +103,11 @@ iquicknodesave (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
 		return -1;
 	}
 	inl_stint (ilength + (imode * (ikeylength + idupslength + QUADSIZE)), cvbnodetmp);
+#if	ISAMMODE == 1
+	/* Restamp it, other processes use the stamp to see that it changed */
+	inl_stquad (inl_ldquad (vb_rtd->psvbfile[ihandle]->sdictnode.ctransnumber) + 1,
+		    cvbnodetmp + INTSIZE);
+#endif	/* ISAMMODE == 1 */
 	/* Calculate position for insertion / deletion of key */
 #if	ISAMMODE == 1
 	iposition = INTSIZE + QUADSIZE + (iposn * (ikeylength + idupslength + QUADSIZE));
@@ -67,12 +117,14 @@ iquicknodesave (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
 	if (imode == 1) {
 		memmove (cvbnodetmp + iposition + ikeylength + idupslength + QUADSIZE,
 			 cvbnodetmp + iposition, (size_t)(ilength - iposition));
-		memcpy (cvbnodetmp + iposition, pstree->pskeylist[iposn]->ckey, (size_t)ikeylength);
+		/* The slot copy is normalized, the node wants the key as is */
+		memcpy (cvbnodetmp + iposition, pstree->pskeylist[iposn]->ckey,
+			(size_t)ikeylength);
 		if (pskeydesc->k_flags & ISDUPS) {
-			inl_stquad (pstree->pskeylist[iposn]->tdupnumber,
+			inl_stquad (pstree->ptdupnumber[iposn],
 				    cvbnodetmp + iposition + ikeylength);
 		}
-		inl_stquad (pstree->pskeylist[iposn]->trownode,
+		inl_stquad (pstree->ptrownode[iposn],
 			    cvbnodetmp + iposition + ikeylength + idupslength);
 	} else {
 		if (ilength - (iposition + ikeylength + idupslength + QUADSIZE) > 0) {
@@ -80,13 +132,14 @@ iquicknodesave (const int ihandle, struct VBTREE *pstree, off_t tnodenumber,
 				 cvbnodetmp + iposition + ikeylength + idupslength + QUADSIZE,
 				 (size_t)(ilength - (iposition + ikeylength + idupslength + QUADSIZE)));
 		}
-		memset (cvbnodetmp + ilength - (ikeylength + QUADSIZE), 0,
+		memset (cvbnodetmp + ilength - (ikeylength + idupslength + QUADSIZE), 0,
 			(size_t)(ikeylength + idupslength + QUADSIZE));
 	}
 	iresult = ivbblockwrite (ihandle, 1, tnodenumber, cvbnodetmp);
 	if (iresult) {
 		return iresult;
 	}
+	vvbtreestamp (ihandle, pstree, tnodenumber, cvbnodetmp);
 	return 0;
 }
 
@@ -147,6 +200,17 @@ inewroot (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 			pskey->pschild->psparent = psnewtree;
 		}
 	}
+	/* All three nodes have a new set of keys */
+	iresult = ivbtreeslots (ihandle, ikeynumber, psnewtree);
+	if (!iresult) {
+		iresult = ivbtreeslots (ihandle, ikeynumber, pstree);
+	}
+	if (!iresult) {
+		iresult = ivbtreeslots (ihandle, ikeynumber, psroottree);
+	}
+	if (iresult) {
+		return iresult;
+	}
 	iresult = ivbnodesave (ihandle, ikeynumber, psnewtree, psnewtree->tnodenumber, 0, 0);
 	if (iresult) {
 		return iresult;
@@ -259,6 +323,14 @@ inodesplit (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 		 * pstree is the original node and contains the HIGH half
 		 */
 		psnewtree->tnodenumber = tnewnode1;
+		/* Both halves have a new set of keys */
+		iresult = ivbtreeslots (ihandle, ikeynumber, psnewtree);
+		if (!iresult) {
+			iresult = ivbtreeslots (ihandle, ikeynumber, pstree);
+		}
+		if (iresult) {
+			return iresult;
+		}
 		iresult = ivbnodesave (ihandle, ikeynumber, psnewtree, psnewtree->tnodenumber, 0, 0);
 		if (iresult) {
 			return iresult;
@@ -295,45 +367,71 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 	struct DICTINFO	*psvbptr;
 	struct VBKEY	*pskey, *pskeynext;
 	struct keydesc	*pskeydesc;
-	VB_CHAR		*pcnodeptr;
+	VB_CHAR		*pcnode, *pcnodeptr;
 #if	ISAMMODE == 1
 	off_t		ttransnumber;
 #endif	/* ISAMMODE == 1 */
 	int		icountlc = 0;	/* Leading compression */
 	int		icounttc = 0;	/* Trailing compression */
 	int		idups = 0, inodelen, iresult;
+	int		ichild, ichildren, iisreload, iloop;
 	VB_UCHAR	cprevkey[VB_MAX_KEYLEN];
 	VB_UCHAR	chighkey[VB_MAX_KEYLEN];
+	VB_CHAR		cquad[QUADSIZE];
+	struct VBTREE	*pschildren[VB_NODE_MAXKEYS];
+	off_t		tchildnode[VB_NODE_MAXKEYS];
 	VB_CHAR     cvbnodetmp[MAX_NODE_LENGTH];
 
 	psvbptr = vb_rtd->psvbfile[ihandle];
 	pskeydesc = psvbptr->pskeydesc[ikeynumber];
 	vvbkeyvalueset (0, pskeydesc, cprevkey);
 	vvbkeyvalueset (1, pskeydesc, chighkey);
-	iresult = ivbblockread (ihandle, 1, tnodenumber, cvbnodetmp);
-	if (iresult) {
-		return iresult;
+	/* With ISMMAP, decode the keys straight out of the mapping */
+	pcnode = pcvbmapped (psvbptr->iindexhandle,
+			     (off_t)((tnodenumber - 1) * psvbptr->inodesize),
+			     (size_t)psvbptr->inodesize);
+	if (!pcnode) {
+		iresult = ivbblockread (ihandle, 1, tnodenumber, cvbnodetmp);
+		if (iresult) {
+			return iresult;
+		}
+		pcnode = cvbnodetmp;
 	}
 	if (iprevlvl != -1) {
-		if (*(cvbnodetmp + psvbptr->inodesize - 2) != iprevlvl - 1) {
+		if (*(pcnode + psvbptr->inodesize - 2) != iprevlvl - 1) {
 			return EBADFILE;
 		}
 	}
+	iisreload = pstree->tnodenumber == tnodenumber;
 	pstree->tnodenumber = tnodenumber;
-	pstree->ilevel = *(cvbnodetmp + psvbptr->inodesize - 2);
-	inodelen = inl_ldint (cvbnodetmp);
+	pstree->ilevel = *(pcnode + psvbptr->inodesize - 2);
+	inodelen = inl_ldint (pcnode);
 #if	ISAMMODE == 1
-	pcnodeptr = cvbnodetmp + INTSIZE + QUADSIZE;
-	ttransnumber = inl_ldquad (cvbnodetmp + INTSIZE);
-	if (ttransnumber == pstree->ttransnumber) {
+	pcnodeptr = pcnode + INTSIZE + QUADSIZE;
+	ttransnumber = inl_ldquad (pcnode + INTSIZE);
+	if (iisreload && ttransnumber == pstree->ttransnumber) {
+		pstree->iepoch = psvbptr->iepoch;
 		return 0;
 	}
+	pstree->ttransnumber = ttransnumber;
 #else	/* ISAMMODE == 1 */
-	pcnodeptr = cvbnodetmp + INTSIZE;
+	pcnodeptr = pcnode + INTSIZE;
 #endif	/* ISAMMODE == 1 */
+	/*
+	 * When a cached node is reloaded, hang on to the subtrees below it.
+	 * They are matched up again by node number once the new keys are in,
+	 * and get checked against their own stamps when next descended into.
+	 */
+	ichildren = 0;
 	for (pskey = pstree->pskeyfirst; pskey; pskey = pskeynext) {
 		if (pskey->pschild) {
-			vvbtreeallfree (ihandle, ikeynumber, pskey->pschild);
+			if (iisreload && pstree->ilevel && !pskey->iisdummy) {
+				pschildren[ichildren] = pskey->pschild;
+				tchildnode[ichildren] = pskey->trownode;
+				ichildren++;
+			} else {
+				vvbtreeallfree (ihandle, ikeynumber, pskey->pschild);
+			}
 		}
 		pskey->pschild = NULL;
 		pskeynext = pskey->psnext;
@@ -341,7 +439,7 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 	}
 	pstree->pskeyfirst = pstree->pskeycurr = pstree->pskeylast = NULL;
 	pstree->ikeysinnode = 0;
-	while (pcnodeptr - cvbnodetmp < inodelen) {
+	while (pcnodeptr - pcnode < inodelen) {
 		pskey = psvbkeyallocate (ihandle, ikeynumber);
 		if (!pskey) {
 			return errno;
@@ -382,9 +480,13 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 			} else {
 				idups = 0;
 			}
-			*pcnodeptr &= ~0x80;
+			/* The node may be read only, strip the flag in a copy */
+			memcpy (cquad, pcnodeptr, QUADSIZE);
+			cquad[0] &= ~0x80;
+			pskey->trownode = inl_ldquad (cquad);
+		} else {
+			pskey->trownode = inl_ldquad (pcnodeptr);
 		}
-		pskey->trownode = inl_ldquad (pcnodeptr);
 		pcnodeptr += QUADSIZE;
 		pskey->psparent = pstree;
 		if (pstree->pskeyfirst) {
@@ -392,8 +494,6 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 		} else {
 			pstree->pskeyfirst = pstree->pskeycurr = pskey;
 		}
-		pstree->pskeylist[pstree->ikeysinnode] = pskey;
-		pstree->ikeysinnode++;
 		pskey->psprev = pstree->pskeylast;
 		pstree->pskeylast = pskey;
 		memcpy (pskey->ckey, cprevkey, (size_t)pskeydesc->k_len);
@@ -402,6 +502,28 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 		pstree->pskeylast->iishigh = 1;
 		memcpy (pstree->pskeylast->ckey, chighkey, (size_t)pskeydesc->k_len);
 	}
+	if (ichildren) {
+		/* The keys rarely move far, so resume searching after the last match */
+		ichild = 0;
+		for (pskey = pstree->pskeyfirst; pskey; pskey = pskey->psnext) {
+			for (iloop = 0; iloop < ichildren; iloop++, ichild++) {
+				if (ichild >= ichildren) {
+					ichild = 0;
+				}
+				if (pschildren[ichild] && tchildnode[ichild] == pskey->trownode) {
+					pskey->pschild = pschildren[ichild];
+					pskey->pschild->psparent = pstree;
+					pschildren[ichild] = NULL;
+					break;
+				}
+			}
+		}
+		for (ichild = 0; ichild < ichildren; ichild++) {
+			if (pschildren[ichild]) {
+				vvbtreeallfree (ihandle, ikeynumber, pschildren[ichild]);
+			}
+		}
+	}
 	pskey = psvbkeyallocate (ihandle, ikeynumber);
 	if (!pskey) {
 		return errno;
@@ -415,8 +537,14 @@ ivbnodeload (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 	}
 	pskey->psprev = pstree->pskeylast;
 	pstree->pskeylast = pskey;
-	pstree->pskeylist[pstree->ikeysinnode] = pskey;
-	pstree->ikeysinnode++;
+	iresult = ivbtreeslots (ihandle, ikeynumber, pstree);
+	if (iresult) {
+		return iresult;
+	}
+	if (ichildren) {
+		vvbtreeedges (pstree);
+	}
+	pstree->iepoch = psvbptr->iepoch;
 	return 0;
 }
 
@@ -426,13 +554,11 @@ ivbnodesave (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 {
 	vb_rtd_t *vb_rtd =VB_GET_RTD;
 	struct DICTINFO	*psvbptr;
-	VB_UCHAR		*pckeyendptr, *pcnodeptr, *pcnodehalfway;
-	VB_UCHAR		*pcnodeend, *pcprevkey = NULL;
+	VB_UCHAR		*pcnodehalfway, *pcnodeend;
 	struct VBKEY	*pskey, *pskeyhalfway = NULL;
 	struct keydesc	*pskeydesc;
-	int		icountlc = 0,	/* Leading compression */
-			icounttc = 0,	/* Trailing compression */
-			ilasttc = 0, ikeylen, imaxtc, iresult;
+	struct VBNODEPACK	spack;
+	int		ikeylen, iresult;
 	VB_CHAR	        cvbnodetmp[MAX_NODE_LENGTH];
 
 	psvbptr = vb_rtd->psvbfile[ihandle];
@@ -447,8 +573,9 @@ ivbnodesave (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 	 * so we *MAY* still need to continue.
 	 */
 	if (pstree->ilevel) {
-		if (pstree->pskeylast->psprev) {
+		if (pstree->pskeylast->psprev && !pstree->pskeylast->psprev->iishigh) {
 			pstree->pskeylast->psprev->iishigh = 1;
+			vvbtreeslotupdate (ihandle, ikeynumber, pstree, pstree->pskeylast->psprev);
 		}
 	}
 	if (imode && !(pskeydesc->k_flags & (DCOMPRESS | TCOMPRESS | LCOMPRESS))) {
@@ -458,87 +585,17 @@ ivbnodesave (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 	}
 	pcnodehalfway = (ucharptr)cvbnodetmp + (psvbptr->inodesize / 2);
 	pcnodeend = (ucharptr)cvbnodetmp + psvbptr->inodesize - 2;
-	memset (cvbnodetmp, 0, MAX_NODE_LENGTH);
-#if	ISAMMODE == 1
-	inl_stquad (inl_ldquad (psvbptr->sdictnode.ctransnumber) + 1,
-		    cvbnodetmp + INTSIZE);
-	pcnodeptr = (ucharptr)cvbnodetmp + INTSIZE + QUADSIZE;
-#else	/* ISAMMODE == 1 */
-	pcnodeptr = (ucharptr)cvbnodetmp + INTSIZE;
-#endif	/* ISAMMODE == 1 */
-	*pcnodeend = pstree->ilevel;
-	pstree->ikeysinnode = 0;
+	vvbnodepackstart (ihandle, &spack, cvbnodetmp, pstree->ilevel);
 	for (pskey = pstree->pskeyfirst; pskey && !pskey->iisdummy;
 	     pskey = pskey->psnext) {
-		pstree->pskeylist[pstree->ikeysinnode] = pskey;
-		pstree->ikeysinnode++;
 		if (!pskeyhalfway) {
-			if (pcnodeptr >= pcnodehalfway) {
+			if (spack.pcnodeptr >= pcnodehalfway) {
 				pskeyhalfway = pskey->psprev;
 			}
 		}
-		ikeylen = pskeydesc->k_len;
-		if (pskeydesc->k_flags & TCOMPRESS) {
-			ilasttc = icounttc;
-			icounttc = 0;
-			pckeyendptr = pskey->ckey + ikeylen - 1;
-			while (*pckeyendptr-- == TCC && pckeyendptr != pskey->ckey) {
-				icounttc++;
-			}
-#if	ISAMMODE == 1
-			ikeylen += INTSIZE - icounttc;
-#else	/* ISAMMODE == 1 */
-			ikeylen += 1 - icounttc;
-#endif	/* ISAMMODE == 1 */
-		}
-		if (pskeydesc->k_flags & LCOMPRESS) {
-			icountlc = 0;
-			if (pskey != pstree->pskeyfirst) {
-				imaxtc = pskeydesc->k_len - (icounttc >
-							     ilasttc ? icounttc : ilasttc);
-				for (; pskey->ckey[icountlc] == pcprevkey[icountlc]
-				     && icountlc < imaxtc; icountlc++) ;
-			}
-#if	ISAMMODE == 1
-			ikeylen += INTSIZE - icountlc;
-#else	/* ISAMMODE == 1 */
-			ikeylen += 1 - icountlc;
-#endif	/* ISAMMODE == 1 */
-			if (pskey->iishigh && (pskeydesc->k_flags & LCOMPRESS)) {
-				icountlc = pskeydesc->k_len;
-				icounttc = 0;
-#if	ISAMMODE == 1
-				if (pskeydesc->k_flags & TCOMPRESS) {
-					ikeylen = INTSIZE * 2;
-				} else {
-					ikeylen = INTSIZE;
-				}
-#else	/* ISAMMODE == 1 */
-				if (pskeydesc->k_flags & TCOMPRESS) {
-					ikeylen = 2;
-				} else {
-					ikeylen = 1;
-				}
-#endif	/* ISAMMODE == 1 */
-				if (pskeydesc->k_flags & DCOMPRESS) {
-					ikeylen = 0;
-				}
-			}
-		}
-		if (pskeydesc->k_flags & ISDUPS) {
-			ikeylen += QUADSIZE;
-			/* If the key is a duplicate and it's not first in node */
-			if ((pskey->iishigh)
-			    || (pskey != pstree->pskeyfirst
-				&& !memcmp (pskey->ckey, pcprevkey, (size_t)pskeydesc->k_len))) {
-				if (pskeydesc->k_flags & DCOMPRESS) {
-					ikeylen = QUADSIZE;
-				}
-			}
-		}
-		ikeylen += QUADSIZE;
+		ikeylen = ivbnodepacklength (pskeydesc, &spack, pskey->ckey, pskey->iishigh);
 		/* Split? */
-		if (pcnodeptr + ikeylen >= pcnodeend - 1) {
+		if (spack.pcnodeptr + ikeylen >= pcnodeend - 1) {
 			if (pstree->pskeylast->psprev->iisnew) {
 				pskeyhalfway = pstree->pskeylast->psprev->psprev;
 			}
@@ -546,71 +603,191 @@ ivbnodesave (const int ihandle, const int ikeynumber, struct VBTREE *pstree,
 			    && pstree->pskeylast->psprev->psprev->iisnew) {
 				pskeyhalfway = pstree->pskeylast->psprev->psprev->psprev;
 			}
+			/*
+			 * The mirror image for keys arriving in descending order:
+			 * a new first key of the first node in the index is split
+			 * off on its own (along with the key that has to become
+			 * its high key in a non-leaf node), the old keys stay full
+			 */
+			if (pstree->iistof && pstree->pskeyfirst->iisnew) {
+				pskeyhalfway = pstree->pskeyfirst;
+				if (pstree->ilevel) {
+					pskeyhalfway = pskeyhalfway->psnext;
+				}
+			}
 			iresult = inodesplit (ihandle, ikeynumber, pstree, pskeyhalfway);
 			return iresult;
 		}
-		if (((ikeylen == (QUADSIZE * 2))
-		     && ((pskeydesc->k_flags & (DCOMPRESS | ISDUPS)) == (DCOMPRESS | ISDUPS)))
-		    || ((pskeydesc->k_flags & DCOMPRESS) && !(pskeydesc->k_flags & ISDUPS)
-			&& ikeylen == QUADSIZE)) {
-			*(pcnodeptr - QUADSIZE) |= 0x80;
-		} else {
-			if (pskeydesc->k_flags & LCOMPRESS) {
+		vvbnodepackkey (pskeydesc, &spack, pskey->ckey, pskey->tdupnumber,
+				pskey->trownode);
+	}
+	inl_stint ((int)(spack.pcnodeptr - spack.pcnode), cvbnodetmp);
+	iresult = ivbblockwrite (ihandle, 1, tnodenumber, cvbnodetmp);
+	if (iresult) {
+		return iresult;
+	}
+	vvbtreestamp (ihandle, pstree, tnodenumber, cvbnodetmp);
+	return 0;
+}
+
+/*
+ * Clear pcnode (MAX_NODE_LENGTH bytes) to an empty node image of the given
+ * level and get pspack ready to lay out its keys, lowest first.  Each key
+ * is sized with ivbnodepacklength () and then written by vvbnodepackkey ().
+ * The caller stores the length, pcnodeptr - pcnode, once they're all in.
+ */
+void
+vvbnodepackstart (const int ihandle, struct VBNODEPACK *pspack, VB_CHAR *pcnode,
+		  int ilevel)
+{
+	vb_rtd_t *vb_rtd =VB_GET_RTD;
+	struct DICTINFO	*psvbptr;
+
+	psvbptr = vb_rtd->psvbfile[ihandle];
+	memset (pcnode, 0, MAX_NODE_LENGTH);
+	pspack->pcnode = (ucharptr)pcnode;
 #if	ISAMMODE == 1
-				inl_stint (icountlc, pcnodeptr);
-				pcnodeptr += INTSIZE;
+	inl_stquad (inl_ldquad (psvbptr->sdictnode.ctransnumber) + 1,
+		    pcnode + INTSIZE);
+	pspack->pcnodeptr = (ucharptr)pcnode + INTSIZE + QUADSIZE;
 #else	/* ISAMMODE == 1 */
-				*pcnodeptr++ = icountlc;
+	pspack->pcnodeptr = (ucharptr)pcnode + INTSIZE;
 #endif	/* ISAMMODE == 1 */
-			}
-			if (pskeydesc->k_flags & TCOMPRESS) {
+	*(pcnode + psvbptr->inodesize - 2) = ilevel;
+	pspack->iisfirst = 1;
+	pspack->icountlc = 0;
+	pspack->icounttc = 0;
+	pspack->iprevtc = 0;
+	pspack->ikeylen = 0;
+}
+
+/*
+ * The number of bytes pckey takes up if it's written next.  Sizing the same
+ * key again gives the same answer, nothing moves on until vvbnodepackkey ().
+ */
+int
+ivbnodepacklength (struct keydesc *pskeydesc, struct VBNODEPACK *pspack,
+		   VB_UCHAR *pckey, int iishigh)
+{
+	VB_UCHAR	*pckeyendptr;
+	int		ikeylen, imaxtc;
+
+	/* A high key alone in its node has no predecessor to be compressed on */
+	if (pspack->iisfirst) {
+		iishigh = 0;
+	}
+	ikeylen = pskeydesc->k_len;
+	if (pskeydesc->k_flags & TCOMPRESS) {
+		pspack->icounttc = 0;
+		pckeyendptr = pckey + ikeylen - 1;
+		while (*pckeyendptr-- == TCC && pckeyendptr != pckey) {
+			pspack->icounttc++;
+		}
 #if	ISAMMODE == 1
-				inl_stint (icounttc, pcnodeptr);
-				pcnodeptr += INTSIZE;
+		ikeylen += INTSIZE - pspack->icounttc;
+#else	/* ISAMMODE == 1 */
+		ikeylen += 1 - pspack->icounttc;
+#endif	/* ISAMMODE == 1 */
+	}
+	if (pskeydesc->k_flags & LCOMPRESS) {
+		pspack->icountlc = 0;
+		if (!pspack->iisfirst) {
+			imaxtc = pskeydesc->k_len - (pspack->icounttc >
+						     pspack->iprevtc ? pspack->icounttc : pspack->iprevtc);
+			for (; pckey[pspack->icountlc] == pspack->cprevkey[pspack->icountlc]
+			     && pspack->icountlc < imaxtc; pspack->icountlc++) ;
+		}
+#if	ISAMMODE == 1
+		ikeylen += INTSIZE - pspack->icountlc;
 #else	/* ISAMMODE == 1 */
-				*pcnodeptr++ = icounttc;
+		ikeylen += 1 - pspack->icountlc;
 #endif	/* ISAMMODE == 1 */
+		if (iishigh) {
+			pspack->icountlc = pskeydesc->k_len;
+			pspack->icounttc = 0;
+#if	ISAMMODE == 1
+			if (pskeydesc->k_flags & TCOMPRESS) {
+				ikeylen = INTSIZE * 2;
+			} else {
+				ikeylen = INTSIZE;
 			}
-			if (icountlc != pskeydesc->k_len) {
-				pcprevkey = pskey->ckey + icountlc;
-				imaxtc = pskeydesc->k_len - (icountlc + icounttc);
-				while (imaxtc--) {
-					*pcnodeptr++ = *pcprevkey++;
-				}
+#else	/* ISAMMODE == 1 */
+			if (pskeydesc->k_flags & TCOMPRESS) {
+				ikeylen = 2;
+			} else {
+				ikeylen = 1;
+			}
+#endif	/* ISAMMODE == 1 */
+			if (pskeydesc->k_flags & DCOMPRESS) {
+				ikeylen = 0;
 			}
-			pcprevkey = pskey->ckey;
 		}
-		if (pskeydesc->k_flags & ISDUPS) {
+	}
+	if (pskeydesc->k_flags & ISDUPS) {
+		ikeylen += QUADSIZE;
+		/* If the key is a duplicate and it's not first in node */
+		if ((iishigh)
+		    || (!pspack->iisfirst
+			&& !memcmp (pckey, pspack->cprevkey, (size_t)pskeydesc->k_len))) {
+			if (pskeydesc->k_flags & DCOMPRESS) {
+				ikeylen = QUADSIZE;
+			}
+		}
+	}
+	ikeylen += QUADSIZE;
+	pspack->ikeylen = ikeylen;
+	return ikeylen;
+}
+
+/*
+ * Write the key last sized by ivbnodepacklength () into the node image
+ */
+void
+vvbnodepackkey (struct keydesc *pskeydesc, struct VBNODEPACK *pspack,
+		VB_UCHAR *pckey, off_t tdupnumber, off_t trownode)
+{
+	VB_UCHAR	*pcnodeptr, *pcsrc;
+	int		icount;
+
+	pcnodeptr = pspack->pcnodeptr;
+	if (((pspack->ikeylen == (QUADSIZE * 2))
+	     && ((pskeydesc->k_flags & (DCOMPRESS | ISDUPS)) == (DCOMPRESS | ISDUPS)))
+	    || ((pskeydesc->k_flags & DCOMPRESS) && !(pskeydesc->k_flags & ISDUPS)
+		&& pspack->ikeylen == QUADSIZE)) {
+		*(pcnodeptr - QUADSIZE) |= 0x80;
+	} else {
+		if (pskeydesc->k_flags & LCOMPRESS) {
 #if	ISAMMODE == 1
-			*pcnodeptr++ = (pskey->tdupnumber >> 56) & 0xff;
-			*pcnodeptr++ = (pskey->tdupnumber >> 48) & 0xff;
-			*pcnodeptr++ = (pskey->tdupnumber >> 40) & 0xff;
-			*pcnodeptr++ = (pskey->tdupnumber >> 32) & 0xff;
+			inl_stint (pspack->icountlc, pcnodeptr);
+			pcnodeptr += INTSIZE;
+#else	/* ISAMMODE == 1 */
+			*pcnodeptr++ = pspack->icountlc;
 #endif	/* ISAMMODE == 1 */
-			*pcnodeptr++ = (pskey->tdupnumber >> 24) & 0xff;
-			*pcnodeptr++ = (pskey->tdupnumber >> 16) & 0xff;
-			*pcnodeptr++ = (pskey->tdupnumber >> 8) & 0xff;
-			*pcnodeptr++ = pskey->tdupnumber & 0xff;
 		}
+		if (pskeydesc->k_flags & TCOMPRESS) {
 #if	ISAMMODE == 1
-		*pcnodeptr++ = (pskey->trownode >> 56) & 0xff;
-		*pcnodeptr++ = (pskey->trownode >> 48) & 0xff;
-		*pcnodeptr++ = (pskey->trownode >> 40) & 0xff;
-		*pcnodeptr++ = (pskey->trownode >> 32) & 0xff;
+			inl_stint (pspack->icounttc, pcnodeptr);
+			pcnodeptr += INTSIZE;
+#else	/* ISAMMODE == 1 */
+			*pcnodeptr++ = pspack->icounttc;
 #endif	/* ISAMMODE == 1 */
-		*pcnodeptr++ = (pskey->trownode >> 24) & 0xff;
-		*pcnodeptr++ = (pskey->trownode >> 16) & 0xff;
-		*pcnodeptr++ = (pskey->trownode >> 8) & 0xff;
-		*pcnodeptr++ = pskey->trownode & 0xff;
-	}
-	if (pskey && pskey->iisdummy) {
-		pstree->pskeylist[pstree->ikeysinnode] = pskey;
-		pstree->ikeysinnode++;
+		}
+		if (pspack->icountlc != pskeydesc->k_len) {
+			pcsrc = pckey + pspack->icountlc;
+			icount = pskeydesc->k_len - (pspack->icountlc + pspack->icounttc);
+			while (icount--) {
+				*pcnodeptr++ = *pcsrc++;
+			}
+		}
+		memcpy (pspack->cprevkey, pckey, (size_t)pskeydesc->k_len);
+		pspack->iisfirst = 0;
 	}
-	inl_stint ((int)((ucharptr)pcnodeptr - (ucharptr)cvbnodetmp), cvbnodetmp);
-	iresult = ivbblockwrite (ihandle, 1, tnodenumber, cvbnodetmp);
-	if (iresult) {
-		return iresult;
+	if (pskeydesc->k_flags & ISDUPS) {
+		inl_stquad (tdupnumber, pcnodeptr);
+		pcnodeptr += QUADSIZE;
 	}
-	return 0;
+	inl_stquad (trownode, pcnodeptr);
+	pcnodeptr += QUADSIZE;
+	pspack->iprevtc = pspack->icounttc;
+	pspack->pcnodeptr = pcnodeptr;
 }
@@ -159,9 +159,7 @@ class ISAMcommonMixin:
 
   def isbegin(self):
     'Begin a transaction'
-    if self._fd is None:
-      raise IsamNotOpen
-    self._chkerror(self._lib.isbegin(self._fd), 'isbegin')
+    self._chkerror(self._lib.isbegin(), 'isbegin')
 
   def isbuild(self, tabpath, reclen, kdesc, varlen=None):
     'Build a new table in exclusive mode'
@@ -195,13 +193,11 @@ class ISAMcommonMixin:
     'Create a clustered index'
     if self._fd is None:
       raise IsamNotOpen
-    self._chkerror(self._lib.iscluster(self._fd, kdesc.raw()), 'iscluster')
+    self._chkerror(self._lib.iscluster(self._fd, kdesc), 'iscluster')
 
   def iscommit(self):
     'Commit the current transaction'
-    if self._fd is None:
-      raise IsamNotOpen
-    self._chkerror(self._lib.iscommit(self._fd), 'iscommit')
+    self._chkerror(self._lib.iscommit(), 'iscommit')
 
   def isdelcurr(self):
     'Delete the current record from the table'
@@ -6,8 +6,10 @@ and is designed to be a direct replacement for the ctypes based module.
 '''
 
 import os
+import struct
 from ._vbisam_cffi import ffi, lib
 from .common import ISAMcommonMixin, ISAMindexMixin, ISAMdictinfo, ISAMkeydesc
+from ...constants import ReadMode
 from ...error import IsamNotOpen
 from ...utils import ISAM_bytes, ISAM_str
 
@@ -22,6 +24,10 @@ class ISAMobjectMixin(ISAMcommonMixin):
   _lib.vb_get_rtd()
   _ffi = ffi
 
+  # Each isreadbatch entry starts with the row number as a vbisam_off_t,
+  # whose size follows the library build, and the length of the row
+  batch_header = struct.Struct('=' + {4: 'i', 8: 'q'}[ffi.sizeof(ffi.typeof(lib.isrecnum).result)] + 'i')
+
   """ NOT USED:
   @property
   def iserrno(self):
@@ -110,6 +116,34 @@ class ISAMobjectMixin(ISAMcommonMixin):
     self._chkerror(self._lib.iskeyinfo(self._fd, kinfo, keynum+1), 'iskeyinfo')
     return ISAMkeydesc(kinfo)
 
+  def create_batch(self, maxrows, recsize=None):
+    'Return a buffer able to hold MAXROWS entries for isreadbatch'
+    return ffi.buffer(ffi.new('char[]', maxrows * (self.batch_header.size + (recsize or self._recsize))))
+
+  def isreadbatch(self, batchbuff, maxrows, mode=ReadMode.ISNEXT):
+    'Read up to MAXROWS consecutive rows into BATCHBUFF returning the number read'
+    if self._fd is None:
+      raise IsamNotOpen
+    nrows = ffi.new('int *')
+    self._chkerror(self._lib.isreadbatch(self._fd, self._raw(batchbuff), maxrows, mode.value, nrows), 'isreadbatch')
+    return nrows[0]
+
+  def isreadkey(self, recbuff, mode=ReadMode.ISNEXT):
+    'Read the key columns of a record from the current index without reading the record'
+    if self._fd is None:
+      raise IsamNotOpen
+    self._chkerror(self._lib.isreadkey(self._fd, self._raw(recbuff), mode.value), 'isreadkey')
+
+  def isreadmany(self, keybuff, nkeys, rowbuff=None):
+    'Lookup NKEYS keys from KEYBUFF on the current index returning their record numbers and lengths'
+    if self._fd is None:
+      raise IsamNotOpen
+    recnums = ffi.new('long long[]', max(nkeys, 1))
+    reclens = ffi.new('int[]', max(nkeys, 1))
+    rows = ffi.NULL if rowbuff is None else self._raw(rowbuff)
+    self._chkerror(self._lib.isreadmany(self._fd, nkeys, self._raw(keybuff), rows, recnums, reclens), 'isreadmany')
+    return list(recnums[0:nkeys]), list(reclens[0:nkeys])
+
   def islangchk(self):
     'Switch on language checks'
     # TODO: self._chkerror(self._lib.islangchk(), 'islangchk')
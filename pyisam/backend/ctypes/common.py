@@ -197,8 +197,6 @@ class ISAMcommonMixin:
   @ISAMfunc(None)
   def isbegin(self):
     '''Begin a transaction'''
-    if self._fd is None:
-      raise IsamNotOpen
     self._isbegin()
 
   @ISAMfunc(c_char_p, c_int, POINTER(ISAMkeydesc), c_int)
@@ -240,8 +238,6 @@ class ISAMcommonMixin:
   @ISAMfunc(None)
   def iscommit(self):
     '''Commit the current transaction'''
-    if self._fd is None:
-      raise IsamNotOpen
     self._iscommit()
 
   @ISAMfunc(c_int)
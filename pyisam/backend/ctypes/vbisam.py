@@ -6,8 +6,11 @@ library without requiring an explicit extension to be compiled.
 '''
 
 import os
-from ctypes import c_char_p, c_int, c_int32, CDLL, _dlopen
+import struct
+from ctypes import byref, create_string_buffer, c_char, c_char_p, c_int, c_int32, c_longlong, c_void_p, CDLL, POINTER, _dlopen
 from .common import ISAMcommonMixin, ISAMfunc, ISAMindexMixin, ISAMdictinfo, ISAMkeydesc, create_record
+from ...constants import ReadMode
+from ...error import IsamNotOpen
 from ...utils import ISAM_str
 
 __all__ = 'ISAMobjectMixin', 'ISAMindexMixin', 'ISAMdictinfo', 'ISAMkeydesc', 'RecordBuffer'
@@ -35,6 +38,10 @@ class ISAMobjectMixin(ISAMcommonMixin):
   _lib = CDLL(_lib_nm, handle=_dlopen(_lib_so))
   _lib.vb_get_rtd()     # Explicitly initialise the underlying library
 
+  # Each isreadbatch entry starts with the row number as a vbisam_off_t,
+  # which the library is built with as a long long, and the length of the row
+  batch_header = struct.Struct('=' + c_longlong._type_ + c_int._type_)
+
   def __getattr__(self,name):
     '''Lookup the ISAM function and return the entry point into the library
        or define and return the numeric equivalent'''
@@ -91,3 +98,35 @@ class ISAMobjectMixin(ISAMcommonMixin):
   @property
   def iscopyright(self):
     return "(c) 2003-2023 Trevor van Bremen"
+
+  def create_batch(self, maxrows, recsize=None):
+    'Return a buffer able to hold MAXROWS entries for isreadbatch'
+    return create_string_buffer(maxrows * (self.batch_header.size + (recsize or self._recsize)))
+
+  @ISAMfunc(c_int, c_char_p, c_int, c_int, POINTER(c_int))
+  def isreadbatch(self, batchbuff, maxrows, mode=ReadMode.ISNEXT):
+    'Read up to MAXROWS consecutive rows into BATCHBUFF returning the number read'
+    if self._fd is None:
+      raise IsamNotOpen
+    nrows = c_int()
+    self._isreadbatch(self._fd, batchbuff, maxrows, mode.value, byref(nrows))
+    return nrows.value
+
+  @ISAMfunc(c_int, c_char_p, c_int)
+  def isreadkey(self, recbuff, mode=ReadMode.ISNEXT):
+    'Read the key columns of a record from the current index without reading the record'
+    if self._fd is None:
+      raise IsamNotOpen
+    self._isreadkey(self._fd, recbuff, mode.value)
+
+  @ISAMfunc(c_int, c_int, c_char_p, c_void_p, POINTER(c_longlong), POINTER(c_int))
+  def isreadmany(self, keybuff, nkeys, rowbuff=None):
+    'Lookup NKEYS keys from KEYBUFF on the current index returning their record numbers and lengths'
+    if self._fd is None:
+      raise IsamNotOpen
+    recnums = (c_longlong * max(nkeys, 1))()
+    reclens = (c_int * max(nkeys, 1))()
+    if rowbuff is not None and not hasattr(rowbuff, '_type_'):
+      rowbuff = (c_char * len(rowbuff)).from_buffer(rowbuff)
+    self._isreadmany(self._fd, nkeys, bytes(keybuff), rowbuff, recnums, reclens)
+    return list(recnums[0:nkeys]), list(reclens[0:nkeys])
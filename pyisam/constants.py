@@ -25,6 +25,7 @@ class OpenMode(IntFlag):
   ISNOLOG    = 0x008         # No logging for this file
   ISVARLEN   = 0x010         # Use variable length records
   ISSPECAUTH = 0x020
+  ISMMAP     = 0x040         # Map the files and read through the mapping
   ISFIXLEN   = 0x000         # Use fixed length records
   ISNOCKLOG  = 0x080
 
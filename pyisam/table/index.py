@@ -134,6 +134,22 @@ class TableIndex(_backend.ISAMindexMixin):
     if self._debug:
       print('FILL_AFT: K:', kwd, 'A:', args, 'R:', record)
 
+  def key_values(self, record):
+    '''Return the values of just the columns that make up the index from RECORD,
+       which are the only columns filled in by ISAMtable.readkey()'''
+    return tuple(record[col.name] for col in self._colinfo)
+
+  def key_bytes(self, record):
+    '''Return the key for this index as the underlying ISAM library would
+       build it from the columns in RECORD'''
+    key = []
+    for col in self._colinfo:
+      colinfo = record._flddict[col.name]
+      start = colinfo.offset + (col.offset or 0)
+      leng = colinfo.size if col.length is None else col.length
+      key.append(bytes(record._buffer[start:start+leng]))
+    return b''.join(key)
+
   @staticmethod
   def keydesc_flags_as_set(keydesc):
     'Return the flags on the keydesc as a set of flags'
@@ -3,13 +3,14 @@ This module provides a structured way of accessing tables using ISAM by providin
 permit the table layout to be defined and referenced later.
 '''
 
+import copy
 import itertools
 import os
 from .index import RecordOrderIndex, TableIndex, create_TableIndex
 from .record import create_record_class, ISAMrecordBase
 from ..backend import _backend
 from ..constants import LockMode, OpenMode, ReadMode
-from ..error import IsamIterError, IsamNotOpen, IsamError, IsamNoPrimaryIndex
+from ..error import IsamEndFile, IsamFunctionFailed, IsamIterError, IsamNotOpen, IsamError, IsamNoPrimaryIndex
 from ..isam import ISAMobject
 from ..tabdefns import TableDefnIndex
 
@@ -374,16 +375,17 @@ class ISAMtable:
       lock = self._lock
     path = os.path.join(self._path if tabpath is None else tabpath, self._name)
     self._isobj.isopen(path, mode, lock)
-    if self._row and self._row._buffer is None:
-      self._row._buffer = self._isobj.create_record()
+    row = self._default_record()
+    if row._buffer is None:
+      row._buffer = self._isobj.create_record()
     self._recsize = self._isobj._recsize  # Provided by the ISAM library
     # self._update_indexes() # NOTE: Defer this to when required
 
   def cluster(self, index):
     'Re-organize the ISAM table using the specified INDEX'
-    if not isinstance(index, TableIndex):
-      raise ValueError('Must provide an instance of ISAMindex for the index')
-    self._isobj.iscluster(index.as_keydesc(self))
+    index = self._LookupIndex(index)
+    self._isobj.iscluster(index.as_keydesc(self._isobj, self._default_record()))
+    self._curindex = None
 
   def close(self):
     'Close the underlying ISAM table'
@@ -412,7 +414,16 @@ class ISAMtable:
     #
     # If no arguments are passed, then the next record in the appropriate
     #   order of access, according to the last mode used on the table is used.
-    
+    return self._read(self._isobj.isread, args, kwd)
+
+  def readkey(self, *args, **kwd):
+    '''Read the next index entry in the same way as read() but only fill in the
+       columns of the record that make up the index, the record itself is never
+       read from the underlying table so the remaining columns are unchanged'''
+    return self._read(self._isobj.isreadkey, args, kwd)
+
+  def _read(self, isread, args, kwd):
+    'Perform the work of read() or readkey() using the ISREAD method given'
     # If no arguments have been given, assume the default of using the last
     # index, the last mode and default record buffer, simply invoke the
     # underlying isread function without excess processing. Updates the
@@ -426,7 +437,7 @@ class ISAMtable:
       elif mode is None:
         mode = ReadMode.ISNEXT
       recbuff = self._default_record()
-      self._isobj.isread(recbuff._buffer, mode)
+      isread(recbuff._buffer, mode)
       self._recnum = self._isobj.isrecnum
       self._lastread = mode
       return recbuff
@@ -479,7 +490,7 @@ class ISAMtable:
       kdesc = RecordOrderIndex()
       self._isobj.isrecnum = index
       self._isobj.isstart(kdesc.as_keydesc(self._isobj, recbuff), ReadMode.ISEQUAL, recbuff._buffer)
-      self._isobj.isread(recbuff._buffer, ReadMode.ISCURR)
+      isread(recbuff._buffer, ReadMode.ISCURR)
       self._recnum = self._isobj.isrecnum
       self._curindex = None
       self._lastread = None       # TODO Check if this will cause an exception
@@ -501,12 +512,12 @@ class ISAMtable:
 
     if index == self._curindex:
       # Reuse the current index and retrieve the next record
-      self._isobj.isread(recbuff._buffer, mode)
+      isread(recbuff._buffer, mode)
 
     else:
       # Issue a restart on the selected index using the specified mode
       self._isobj.isstart(index.as_keydesc(self._isobj, recbuff, optimize=True), mode, recbuff._buffer)
-      self._isobj.isread(recbuff._buffer, ReadMode.ISCURR)
+      isread(recbuff._buffer, ReadMode.ISCURR)
       
       # Make this the current index
       self._curindex = index
@@ -520,6 +531,109 @@ class ISAMtable:
     # Return the record which can then be used as required
     return recbuff
 
+  def readchunks(self, index=None, chunksize=256, reverse=False):
+    '''Iterate over the table in the order of INDEX yielding lists of up to
+       CHUNKSIZE (recnum, record) pairs, each list being filled by a single
+       isreadbatch call rather than one isread per record'''
+    if chunksize < 1:
+      raise ValueError('Must request at least one record per chunk')
+
+    mode = ReadMode.ISLAST if reverse else ReadMode.ISFIRST
+    try:
+      self._start_index(index, mode)
+    except IsamEndFile:
+      return
+
+    # Each entry in the batch is a header, laid out as the backend describes,
+    # holding the row number and the length of the record followed by the
+    # record itself, the records returned share the column information of a
+    # single template
+    batch = self._isobj.create_batch(chunksize)
+    header = self._isobj.batch_header
+    stride = len(batch) // chunksize
+    template = self._record(self._name)
+    while True:
+      try:
+        nrows = self._isobj.isreadbatch(batch, chunksize, mode)
+      except IsamEndFile:
+        return
+      chunk = []
+      for offset in range(0, nrows * stride, stride):
+        recnum, reclen = header.unpack_from(batch, offset)
+        start = offset + header.size
+        record = copy.copy(template)
+        record._buffer = bytearray(batch[start:start+reclen])
+        chunk.append((recnum, record))
+      mode = ReadMode.ISPREV if reverse else ReadMode.ISNEXT
+      if chunk:
+        self._recnum = chunk[-1][0]
+        self._lastread = mode
+        yield chunk
+      if nrows < chunksize:
+        # A short batch stops at the end of the index or on an error that
+        # only iserrno reports, such as a locked row
+        errno = self._isobj.iserrno
+        if errno != self._isobj._vld_errno[0] + 10:
+          raise IsamFunctionFailed('isreadbatch', errno, self._isobj.strerror(errno))
+        return
+
+  def readmany(self, keys, index=None):
+    '''Lookup each of KEYS on INDEX with a single isreadmany call, where each
+       key is either a value, a list of values or a dictionary of values for the
+       index columns, returning a list of (recnum, record) pairs in the same
+       order as KEYS with (0, None) for any key not present in the table'''
+    keys = list(keys)
+    if not keys:
+      return []
+    try:
+      index, recbuff = self._start_index(index, ReadMode.ISFIRST)
+    except IsamEndFile:
+      return [(0, None)] * len(keys)
+    keybuff = bytearray()
+    for key in keys:
+      if isinstance(key, dict):
+        index.fill_fields(recbuff, **key)
+      elif isinstance(key, (tuple, list)):
+        index.fill_fields(recbuff, *key)
+      else:
+        index.fill_fields(recbuff, key)
+      keybuff += index.key_bytes(recbuff)
+
+    # The records are returned back to back in the same order as the keys
+    recsize = self._isobj._recsize
+    rowbuff = bytearray(len(keys) * recsize)
+    recnums, reclens = self._isobj.isreadmany(keybuff, len(keys), rowbuff)
+    template = self._record(self._name)
+    result = []
+    for keynum, recnum in enumerate(recnums):
+      if recnum:
+        record = copy.copy(template)
+        record._buffer = rowbuff[keynum*recsize:keynum*recsize+reclens[keynum]]
+        result.append((recnum, record))
+      else:
+        result.append((0, None))
+    return result
+
+  def _start_index(self, index, mode):
+    '''Select INDEX in the same way as read() does and start it using MODE,
+       returning the index selected and the default record'''
+    # Ensure that the underlying file is open
+    if self._isobj._fd is None:
+      self.open()
+
+    if index is None:
+      index = self._curindex if self._curindex else self._LookupPrimaryIndex()
+    elif isinstance(index, str):
+      index = self._idxinfo[index].tabind
+    elif isinstance(index, TableIndexMapElem):
+      index = index.tabind
+    recbuff = self._default_record()
+    if recbuff._buffer is None:
+      recbuff._buffer = self._isobj.create_record()
+    self._isobj.isstart(index.as_keydesc(self._isobj, recbuff, optimize=True), mode, recbuff._buffer)
+    self._curindex = index
+    return index, recbuff
+
   def insert(self, recbuff=None, setcurr=False, *args, **kwd):
     'Insert a record'
     if recbuff is None:
@@ -0,0 +1,21 @@
+'''
+Test 36: Check if reading a table in chunks matches reading it record by record
+'''
+from pyisam.constants import OpenMode, ReadMode
+from pyisam.error import IsamEndFile
+from pyisam.table import ISAMtable
+from pyisam.tabdefns.stxtables import DECOMPdefn
+
+def test(opts):
+  DECOMP = ISAMtable(DECOMPdefn, tabpath=opts.tstdata, mode=OpenMode.ISINPUT)
+  single = []
+  try:
+    dec_rec = DECOMP.read(ReadMode.ISFIRST)
+    while True:
+      single.append((DECOMP._recnum, dec_rec.as_tuple()))
+      dec_rec = DECOMP.read()
+  except IsamEndFile:
+    pass
+  chunked = [(recnum, dec_rec.as_tuple()) for chunk in DECOMP.readchunks(chunksize=50)
+                                          for recnum, dec_rec in chunk]
+  print(len(single), len(chunked), single == chunked)
@@ -0,0 +1,21 @@
+'''
+Test 37: Check if reading only the key columns matches reading the records
+'''
+from pyisam.constants import OpenMode, ReadMode
+from pyisam.error import IsamEndFile
+from pyisam.table import ISAMtable
+from pyisam.tabdefns.stxtables import DECOMPdefn
+
+def test(opts):
+  DECOMP = ISAMtable(DECOMPdefn, tabpath=opts.tstdata, mode=OpenMode.ISINPUT)
+  index = DECOMP._LookupPrimaryIndex()
+  for readfn in (DECOMP.read, DECOMP.readkey):
+    keys = []
+    try:
+      dec_rec = readfn(ReadMode.ISFIRST)
+      while True:
+        keys.append((DECOMP._recnum, index.key_values(dec_rec)))
+        dec_rec = readfn()
+    except IsamEndFile:
+      pass
+    print(readfn.__name__, len(keys), keys[:3])
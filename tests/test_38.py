@@ -0,0 +1,21 @@
+'''
+Test 38: Check if looking up many keys at once matches looking them up singly
+'''
+from pyisam.constants import OpenMode, ReadMode
+from pyisam.error import IsamNoRecord
+from pyisam.table import ISAMtable
+from pyisam.tabdefns.stxtables import DEFILEdefn
+
+def test(opts):
+  DEFILE = ISAMtable(DEFILEdefn, tabpath=opts.tstdata, mode=OpenMode.ISINPUT)
+  keys = [('defile', 10), ('dekeys', 20), ('nosuch', 0), ('adcent', 20), ('defile', 10)]
+  single = []
+  for key in keys:
+    try:
+      def_rec = DEFILE.read('key', ReadMode.ISEQUAL, *key)
+      single.append((DEFILE._recnum, def_rec.as_tuple()))
+    except IsamNoRecord:
+      single.append((0, None))
+  many = [(recnum, def_rec.as_tuple() if def_rec else None)
+          for recnum, def_rec in DEFILE.readmany(keys, 'key')]
+  print(single == many, many)
@@ -0,0 +1,56 @@
+'''
+Test 39: Check if a table opened for transactions can be clustered
+'''
+import os
+import shutil
+from pyisam.constants import LockMode, OpenMode, ReadMode
+from pyisam.error import IsamEndFile
+from pyisam.table import ISAMtable
+from pyisam.tabdefns.stxtables import DEKEYSdefn
+
+attr = ('write',)
+
+def test(opts):
+  # Cluster a copy of the table so that the test data stays as it is
+  tabpath = os.path.join(opts.tstdata, 'work')
+  os.makedirs(tabpath, exist_ok=True)
+  for ext in ('.dat', '.idx'):
+    shutil.copy(os.path.join(opts.tstdata, 'dekeys' + ext), tabpath)
+  logname = os.path.join(tabpath, 'dekeys.log')
+  open(logname, 'w').close()
+
+  # A table opened with ISTRANS has to be opened within a transaction
+  DEKEYS = ISAMtable(DEKEYSdefn, tabpath=tabpath)
+  isobj = DEKEYS._isobj
+  isobj.islogopen(logname)
+  isobj.isbegin()
+  DEKEYS.open(mode=OpenMode.ISINOUT | OpenMode.ISTRANS, lock=LockMode.ISEXCLLOCK)
+  isobj.iscommit()
+
+  # iscluster runs in a transaction of its own, after which reading the
+  # table by the index reads the rows in row number order
+  isobj.isbegin()
+  before = recnums_by_key(DEKEYS)
+  isobj.iscommit()
+  DEKEYS.cluster('key')
+  isobj.isbegin()
+  after = recnums_by_key(DEKEYS)
+  DEKEYS.close()
+  isobj.iscommit()
+  isobj.islogclose()
+  shutil.rmtree(tabpath)
+  print(len(before), in_order(before), len(after), in_order(after))
+
+def recnums_by_key(tabinst):
+  recnums = []
+  try:
+    tabinst.read('key', ReadMode.ISFIRST)
+    while True:
+      recnums.append(tabinst._recnum)
+      tabinst.read()
+  except IsamEndFile:
+    pass
+  return recnums
+
+def in_order(recnums):
+  return recnums == list(range(1, len(recnums) + 1))
@@ -387,6 +387,22 @@ struct dictinfo {{
     short        di_idxsize;
     {self.lngsz} di_nrecords;
 }};
+struct nodecacheinfo {{
+    {self.lngsz} nc_budget;
+    {self.lngsz} nc_bytes;
+    {self.lngsz} nc_peak;
+    {self.lngsz} nc_evictions;
+    int          nc_nodes;
+    int          nc_keys;
+}};
+struct indexfillinfo {{
+    {self.lngsz} fi_nodes;
+    {self.lngsz} fi_leaves;
+    {self.lngsz} fi_bytes;
+    {self.lngsz} fi_capacity;
+    int          fi_levels;
+    int          fi_fill;
+}};
 extern void         *vb_get_rtd(void);     /* Used to initialise library correctly */
 extern int           is_nerr(void);
 extern int           iserrno(void);
@@ -400,6 +416,7 @@ extern int           isaddindex(int, struct keydesc *);
 extern int           isaudit(int, signed char *, int);
 extern int           isbegin(void);
 extern int           isbuild(signed char *, int, struct keydesc *, int);
+extern int           ischeckpoint({self.lngsz} *);
 extern int           iscleanup(void);
 extern int           isclose(int);
 extern int           iscluster(int, struct keydesc *);
@@ -411,8 +428,10 @@ extern int           isdelrec(int, {self.lngsz});
 extern int           isdictinfo(int, struct dictinfo *);
 extern int           iserase(signed char *);
 extern int           isflush(int);
+extern int           isindexfill(int, int, struct indexfillinfo *);
 extern int           isindexinfo(int, void *, int);
 extern int           iskeyinfo(int, struct keydesc *, int);
+extern int           isnodecacheinfo(struct nodecacheinfo *);
 /*extern void          islangchk(void);   -- Not implemented */
 /*extern char         *islanginfo(char *);   -- Not implemented */
 extern int           islock(int);
@@ -423,6 +442,9 @@ extern int           islogopen(signed char *);
 /*extern void          isnolangchk(void);   -- Not implemented */
 extern int           isopen(signed char *, int);
 extern int           isread(int, signed char *, int);
+extern int           isreadbatch(int, signed char *, int, int, int *);
+extern int           isreadkey(int, signed char *, int);
+extern int           isreadmany(int, int, signed char *, signed char *, {self.lngsz} *, int *);
 extern int           isrecover(void);
 extern int           isrelease(int);
 extern int           isrename(signed char *, signed char *);
@@ -430,6 +452,13 @@ extern int           isrewcurr(int, signed char *);
 extern int           isrewrec(int, {self.lngsz}, signed char *);
 extern int           isrewrite(int, signed char *);
 extern int           isrollback(void);
+extern int           issetbuffers(int);
+extern int           issetcheckpoint(int);
+extern int           issetfillfactor(int);
+extern int           issetlogbuffer(int);
+extern int           issetlogsync(int);
+extern int           issetnodecache(int);
+extern int           issetsortmemory(int);
 extern int           issetunique(int, {self.lngsz});
 extern int           isstart(int, struct keydesc *, int, signed char *, int);
 extern int           isuniqueid(int, {self.lngsz} *);